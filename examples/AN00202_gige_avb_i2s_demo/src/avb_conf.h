@@ -76,6 +76,9 @@ enum aem_control_indices {
 #define AVB_1722_1_FAST_CONNECT_ENABLED 0
 /** Enable 1722.1 Controller functionality on the entity. */
 #define AVB_1722_1_CONTROLLER_ENABLED 0
+/** Use the stream, stream port, audio cluster and audio map descriptors
+  * compiled from src/aem_entity_model.in rather than generating them on the fly */
+#define AEM_GENERATE_DESCRIPTORS_ON_FLY 0
 
 /******** Flash parameters *****************************************************************/
 
@@ -2,6 +2,10 @@ import sys
 import re
 import string
 import os
+try:
+    import ConfigParser as configparser
+except ImportError:
+    import configparser
 
 string_regex = re.compile(r'"[^"]*"')
 
@@ -44,6 +48,207 @@ def do_replace(read_file, write_file, replace_defines):
             write_file.write(line)
 
 
+# Entity model compiler
+#
+# aem_entity_model.in declares the streams of the entity. From it the stream,
+# stream port, audio cluster and audio map descriptors are generated as
+# constant tables in aem_entity_model.h, so that they are neither built on the
+# device (AEM_GENERATE_DESCRIPTORS_ON_FLY) nor written out by hand.
+
+class ModelError(Exception):
+    pass
+
+# 61883-6 sampling frequency codes
+sfc_codes = {32000: 0, 44100: 1, 48000: 2, 88200: 3, 96000: 4, 176400: 5, 192000: 6}
+
+# Descriptors are limited to 508 bytes, so an audio map holds 62 mappings
+max_mappings_per_map = 62
+
+define_regex = re.compile(r'^\s*#define\s+(\w+)\s+(.+?)\s*$')
+comment_regex = re.compile(r'//.*|/\*.*?\*/')
+int_suffix_regex = re.compile(r'\b(0x[0-9a-fA-F]+|[0-9]+)[uUlL]+\b')
+
+
+def evaluate(expr, defines):
+    expr = int_suffix_regex.sub(r'\1', expr).replace('/', '//')
+    try:
+        value = eval(expr, {'__builtins__': None}, defines)
+    except Exception:
+        raise ModelError("cannot evaluate '" + expr + "'")
+    if not isinstance(value, int):
+        raise ModelError("'" + expr + "' is not an integer")
+    return value
+
+
+def read_integer_defines(path):
+    defines = {}
+    if not os.path.exists(path):
+        return defines
+    pending = []
+    for line in open(path, 'r'):
+        m = define_regex.match(comment_regex.sub('', line))
+        if m:
+            pending.append((m.group(1), m.group(2)))
+    # Defines may refer to each other, so resolve until nothing changes
+    progress = True
+    while pending and progress:
+        progress = False
+        for name, expr in list(pending):
+            try:
+                defines[name] = evaluate(expr, defines)
+                pending.remove((name, expr))
+                progress = True
+            except ModelError:
+                pass
+    return defines
+
+
+def u16(value):
+    return 'U16(' + str(value) + ')'
+
+
+def u32(value):
+    return 'U32(' + str(value) + ')'
+
+
+def object_name(name):
+    if len(name) > 64:
+        raise ModelError("name '" + name + "' is longer than 64 characters")
+    return convert_string_to_char_array(name)
+
+
+def stream_format(sample_rate, channels):
+    return ', '.join(['0x00', '0xa0', str(sfc_codes[sample_rate]), str(channels), '0x40', '0', str(channels), '0'])
+
+
+class StreamDirection:
+    def __init__(self, config, section, defines, stream_type, port_type, count_define, max_channels_define, signal_type):
+        self.section = section
+        self.stream_type = stream_type
+        self.port_type = port_type
+        self.count = 0
+        self.channels = 0
+        if not config.has_section(section):
+            return
+
+        def get(option, default=None):
+            if config.has_option(section, option):
+                return config.get(section, option).strip()
+            if default is None:
+                raise ModelError("[" + section + "] has no '" + option + "'")
+            return default
+
+        self.count = evaluate(get('count'), defines)
+        self.channels = evaluate(get('channels'), defines)
+        self.name = get('name')
+        self.flags = get('flags', 'AEM_STREAM_FLAGS_CLASS_A')
+        self.signal_type = get('cluster_signal_type', signal_type)
+        self.sample_rates = [evaluate(r, defines) for r in get('sample_rates').split(',')]
+        cluster_names = [n.strip() for n in get('cluster_name').split(',')]
+
+        # Cross-check against the endpoint configuration
+        if count_define in defines and defines[count_define] != self.count:
+            raise ModelError("[" + section + "] count is " + str(self.count) + " but " + count_define + " is " + str(defines[count_define]))
+        if self.count < 0 or self.count > 0xffff:
+            raise ModelError("[" + section + "] count " + str(self.count) + " is out of range")
+        if self.count and (self.channels < 1 or self.channels > max_mappings_per_map):
+            raise ModelError("[" + section + "] channels must be between 1 and " + str(max_mappings_per_map))
+        if max_channels_define in defines and self.channels > defines[max_channels_define]:
+            raise ModelError("[" + section + "] channels exceeds " + max_channels_define)
+        for r in self.sample_rates:
+            if r not in sfc_codes:
+                raise ModelError("[" + section + "] unsupported sample rate " + str(r))
+
+        # A single name is numbered per channel, otherwise every cluster is named
+        if len(cluster_names) == 1:
+            self.cluster_names = [cluster_names[0] + ' ' + str(i+1) for i in range(self.count * self.channels)]
+        elif len(cluster_names) == self.count * self.channels:
+            self.cluster_names = cluster_names
+        else:
+            raise ModelError("[" + section + "] has " + str(len(cluster_names)) + " cluster names for " + str(self.count * self.channels) + " clusters")
+
+
+def write_descriptor(f, name, fields):
+    f.write('const unsigned char ' + name + '[] =\n{\n  ' + ',\n  '.join(fields) + '\n};\n\n')
+
+
+def write_descriptor_list_macro(f, macro, desc_type, names):
+    f.write('#define ' + macro)
+    if names:
+        f.write(' ' + desc_type + ', ' + str(len(names)) + ', ')
+        f.write(', '.join(['sizeof(' + n + '), (unsigned)' + n for n in names]) + ',')
+    f.write('\n')
+
+
+def compile_entity_model(model_path, avb_conf_path, write_file):
+    defines = read_integer_defines(avb_conf_path)
+    config = configparser.ConfigParser()
+    config.read(model_path)
+
+    directions = [StreamDirection(config, 'stream_input', defines, 'AEM_STREAM_INPUT_TYPE', 'AEM_STREAM_PORT_INPUT_TYPE',
+                                  'AVB_NUM_SINKS', 'AVB_MAX_CHANNELS_PER_LISTENER_STREAM', 'AEM_INVALID_TYPE'),
+                  StreamDirection(config, 'stream_output', defines, 'AEM_STREAM_OUTPUT_TYPE', 'AEM_STREAM_PORT_OUTPUT_TYPE',
+                                  'AVB_NUM_SOURCES', 'AVB_MAX_CHANNELS_PER_TALKER_STREAM', 'AEM_AUDIO_UNIT_TYPE')]
+
+    write_file.write("/************************************************************************/\n")
+    write_file.write("/* File generated from " + model_path + ". DO NOT MODIFY THIS FILE. */ \n")
+    write_file.write("/************************************************************************/\n")
+    write_file.write("#ifndef __aem_entity_model_h__\n#define __aem_entity_model_h__\n\n")
+
+    # Input clusters and maps come first, then output ones, so that each
+    # stream port refers to a contiguous range
+    clusters = []
+    maps = []
+    lists = {}
+    for d in directions:
+        streams = []
+        ports = []
+        for i in range(d.count):
+            name = 'desc_' + d.section + '_' + str(i)
+            formats = [stream_format(r, d.channels) for r in d.sample_rates]
+            fields = [u16(d.stream_type), u16(i), object_name(d.name + ' ' + str(i)), u16('AEM_NO_STRING'),
+                      u16(0), u16(d.flags), formats[0], u16(132), u16(len(formats))]
+            fields += ['0, 0, 0, 0, 0, 0, 0, 0', u16(0)] * 4
+            fields += [u16(0), u32(0)] + formats
+            write_descriptor(write_file, name, fields)
+            streams.append(name)
+
+            base_cluster = len(clusters)
+            for c in range(d.channels):
+                cluster = 'desc_audio_cluster_' + str(len(clusters))
+                write_descriptor(write_file, cluster, [u16('AEM_AUDIO_CLUSTER_TYPE'), u16(len(clusters)),
+                                                       object_name(d.cluster_names[(i * d.channels) + c]),
+                                                       u16('AEM_NO_STRING'), u16(d.signal_type), u16(0), u16(0),
+                                                       u32(0), u32(0), u16(1), 'AEM_AUDIO_CLUSTER_FORMAT_MBLA'])
+                clusters.append(cluster)
+
+            audio_map = 'desc_audio_map_' + str(len(maps))
+            fields = [u16('AEM_AUDIO_MAP_TYPE'), u16(len(maps)), u16(8), u16(d.channels)]
+            for c in range(d.channels):
+                fields.append(', '.join([u16(i), u16(c), u16(c), u16(0)]))
+            write_descriptor(write_file, audio_map, fields)
+
+            port = 'desc_stream_port_' + d.section.split('_')[1] + '_' + str(i)
+            write_descriptor(write_file, port, [u16(d.port_type), u16(i), u16(0), u16(0), u16(0), u16(0),
+                                                u16(d.channels), u16(base_cluster), u16(1), u16(len(maps))])
+            maps.append(audio_map)
+            ports.append(port)
+        lists[d.stream_type] = streams
+        lists[d.port_type] = ports
+
+    if len(clusters) > 0xffff or len(maps) > 0xffff:
+        raise ModelError("too many audio clusters or maps")
+
+    write_file.write("/* Entries of aem_descriptor_list */\n")
+    write_descriptor_list_macro(write_file, 'AEM_STREAM_INPUT_DESCRIPTORS', 'AEM_STREAM_INPUT_TYPE', lists['AEM_STREAM_INPUT_TYPE'])
+    write_descriptor_list_macro(write_file, 'AEM_STREAM_OUTPUT_DESCRIPTORS', 'AEM_STREAM_OUTPUT_TYPE', lists['AEM_STREAM_OUTPUT_TYPE'])
+    write_descriptor_list_macro(write_file, 'AEM_STREAM_PORT_INPUT_DESCRIPTORS', 'AEM_STREAM_PORT_INPUT_TYPE', lists['AEM_STREAM_PORT_INPUT_TYPE'])
+    write_descriptor_list_macro(write_file, 'AEM_STREAM_PORT_OUTPUT_DESCRIPTORS', 'AEM_STREAM_PORT_OUTPUT_TYPE', lists['AEM_STREAM_PORT_OUTPUT_TYPE'])
+    write_descriptor_list_macro(write_file, 'AEM_AUDIO_CLUSTER_DESCRIPTORS', 'AEM_AUDIO_CLUSTER_TYPE', clusters)
+    write_descriptor_list_macro(write_file, 'AEM_AUDIO_MAP_DESCRIPTORS', 'AEM_AUDIO_MAP_TYPE', maps)
+    write_file.write("\n#endif\n")
+
+
 def main():
     srcpath = sys.argv[1]
     dstpath = sys.argv[2]
@@ -57,6 +262,17 @@ def main():
 
     do_replace(read_file, write_file, 1)
 
+    model_path = os.path.join(srcpath, 'aem_entity_model.in')
+    if os.path.exists(model_path):
+        write_file = open(os.path.join(dstpath, 'aem_entity_model.h'), 'w')
+        try:
+            compile_entity_model(model_path, os.path.join(srcpath, 'avb_conf.h'), write_file)
+        except ModelError:
+            write_file.close()
+            os.remove(os.path.join(dstpath, 'aem_entity_model.h'))
+            print "Error in aem_entity_model.in: " + str(sys.exc_info()[1])
+            sys.exit(1)
+
     print "AEM descriptor header file generation complete"
 
 main()
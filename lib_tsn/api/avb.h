@@ -20,6 +20,14 @@ enum avb_stream_format_t
 };
 
 
+/** The SR class of a stream, which sets its traffic priority and the
+ *  class measurement interval that its bandwidth is reserved over */
+enum avb_sr_class_t
+{
+  AVB_SR_CLASS_A, /*!< Class A: 125us class measurement interval */
+  AVB_SR_CLASS_B, /*!< Class B: 250us class measurement interval */
+};
+
 /** The state of an AVB source (Talker). */
 enum avb_source_state_t
 {
@@ -37,6 +45,21 @@ enum avb_sink_state_t
   AVB_SINK_STATE_ENABLED,   /*!< The sink is enabled and set to streaming by AEM */
 };
 
+/** The fields of an AVB source or sink that can be read and written on
+ *  their own, without copying the whole source or sink across the interface */
+enum avb_stream_field_t
+{
+  AVB_STREAM_FIELD_STATE,         /*!< The state of the stream */
+  AVB_STREAM_FIELD_FORMAT,        /*!< The format of the stream */
+  AVB_STREAM_FIELD_RATE,          /*!< The sample rate of the stream in Hz */
+  AVB_STREAM_FIELD_NUM_CHANNELS,  /*!< The channel count of the stream */
+  AVB_STREAM_FIELD_SYNC,          /*!< The media clock of the stream */
+  AVB_STREAM_FIELD_SR_CLASS,      /*!< The SR class of a source */
+  AVB_STREAM_FIELD_PACKET_RATE,   /*!< The 1722 packet rate of a source */
+  AVB_STREAM_FIELD_PRESENTATION,  /*!< The presentation time offset of a source */
+  AVB_STREAM_FIELD_VLAN,          /*!< The VLAN ID of the stream */
+};
+
 /** The state of a media clock */
 enum device_media_clock_state_t
 {
@@ -92,6 +115,8 @@ typedef struct avb_stream_info_t
     int rate;
     char sync;
     short flags;
+    char sr_class;
+    int packet_rate;
 } avb_stream_info_t;
 
 typedef struct avb_source_info_t
@@ -117,6 +142,47 @@ struct avb_debug_counters {
   unsigned received_1722;
 };
 
+/** The counters of an AVB sink, reported by GET_COUNTERS on its STREAM_INPUT */
+typedef struct avb_sink_counters_t {
+  unsigned media_locked;          ///< Number of times the media output FIFO locked to the stream
+  unsigned media_unlocked;        ///< Number of times the media output FIFO lost lock
+  unsigned stream_reset;          ///< Number of times the stream was (re)started
+  unsigned seq_num_mismatch;      ///< Number of 1722 packets received out of sequence
+  unsigned media_reset;           ///< Number of toggles of the 1722 media clock restart bit
+  unsigned timestamp_uncertain;   ///< Number of 1722 packets with the tu bit set
+  unsigned timestamp_valid;       ///< Number of 1722 packets with the tv bit set
+  unsigned timestamp_not_valid;   ///< Number of 1722 packets with the tv bit clear
+  unsigned unsupported_format;    ///< Number of times the stream's sample rate was not recognised
+  unsigned frames_rx;             ///< Number of 1722 packets received
+  unsigned fifo_overflow;         ///< Number of packets that overflowed the media output FIFO
+  unsigned fifo_underflow;        ///< Number of samples the media output FIFO could not supply
+} avb_sink_counters_t;
+
+/** The counters of an AVB source, reported by GET_COUNTERS on its STREAM_OUTPUT */
+typedef struct avb_source_counters_t {
+  unsigned stream_start;          ///< Number of times the stream started transmitting
+  unsigned stream_stop;           ///< Number of times the stream stopped transmitting
+  unsigned frames_tx;             ///< Number of 1722 packets transmitted
+} avb_source_counters_t;
+
+/** The events serviced by the media clock server */
+enum media_clock_server_event_t {
+  MEDIA_CLOCK_EVENT_CLOCK_EDGE,       ///< Queuing the next edge of a media clock output
+  MEDIA_CLOCK_EVENT_PTP_PACKET,       ///< Processing a received PTP packet
+  MEDIA_CLOCK_EVENT_PTP_PERIODIC,     ///< PTP timeouts and announce, sync and pdelay generation
+  MEDIA_CLOCK_EVENT_CLOCK_RECOVERY,   ///< Recovering the rate of one media clock
+  MEDIA_CLOCK_EVENT_BUFFER,           ///< A media output FIFO buffer management transaction
+  MEDIA_CLOCK_EVENT_CONTROL,          ///< Reconfiguring a media clock
+  MEDIA_CLOCK_NUM_EVENTS
+};
+
+/** Worst case timings of the media clock server, in reference timer ticks */
+typedef struct media_clock_server_stats_t {
+  unsigned max_service_time[MEDIA_CLOCK_NUM_EVENTS]; ///< Longest time spent servicing each type of event
+  unsigned max_edge_latency;      ///< Longest delay before a media clock output event was serviced
+  unsigned max_deferred_latency;  ///< Longest time queued PTP periodic or clock recovery work waited to run
+} media_clock_server_stats_t;
+
 
 #ifdef __XC__
 /** The core AVB interface API for interacting with the endpoint */
@@ -130,11 +196,51 @@ interface avb_interface {
   /** Intended for internal use within client interface get and set extensions only */
   void _set_sink_info(unsigned sink_num, avb_sink_info_t info);
   /** Intended for internal use within client interface get and set extensions only */
+  avb_stream_info_t _get_source_stream(unsigned source_num);
+  /** Intended for internal use within client interface get and set extensions only */
+  void _get_sources_field(enum avb_stream_field_t field, unsigned first_source, int values[n], unsigned n);
+  /** Intended for internal use within client interface get and set extensions only */
+  int _set_source_fields(unsigned source_num, enum avb_stream_field_t fields[n], int values[n], unsigned n);
+  /** Intended for internal use within client interface get and set extensions only */
+  void _get_source_map(unsigned source_num, int map[n], unsigned n);
+  /** Intended for internal use within client interface get and set extensions only */
+  int _set_source_map(unsigned source_num, int map[n], unsigned n);
+  /** Intended for internal use within client interface get and set extensions only */
+  avb_srp_info_t _get_source_reservation(unsigned source_num);
+  /** Intended for internal use within client interface get and set extensions only */
+  int _set_source_dest(unsigned source_num, unsigned char addr[6]);
+  /** Intended for internal use within client interface get and set extensions only */
+  avb_stream_info_t _get_sink_stream(unsigned sink_num);
+  /** Intended for internal use within client interface get and set extensions only */
+  void _get_sinks_field(enum avb_stream_field_t field, unsigned first_sink, int values[n], unsigned n);
+  /** Intended for internal use within client interface get and set extensions only */
+  int _set_sink_fields(unsigned sink_num, enum avb_stream_field_t fields[n], int values[n], unsigned n);
+  /** Intended for internal use within client interface get and set extensions only */
+  void _get_sink_map(unsigned sink_num, int map[n], unsigned n);
+  /** Intended for internal use within client interface get and set extensions only */
+  int _set_sink_map(unsigned sink_num, int map[n], unsigned n);
+  /** Intended for internal use within client interface get and set extensions only */
+  avb_srp_info_t _get_sink_reservation(unsigned sink_num);
+  /** Intended for internal use within client interface get and set extensions only */
+  int _set_sink_addr(unsigned sink_num, unsigned char addr[6]);
+  /** Intended for internal use within client interface get and set extensions only */
+  int _set_sink_id(unsigned sink_num, unsigned int stream_id[2]);
+  /** Intended for internal use within client interface extension only */
+  int _begin_stream_transaction(void);
+  /** Intended for internal use within client interface extension only */
+  int _commit_stream_transaction(void);
+  /** Intended for internal use within client interface get and set extensions only */
   media_clock_info_t _get_media_clock_info(unsigned clock_num);
   /** Intended for internal use within client interface get and set extensions only */
   void _set_media_clock_info(unsigned clock_num, media_clock_info_t info);
   /** Intended for internal use within client interface extension only */
   struct avb_debug_counters _get_debug_counters(void);
+  /** Intended for internal use within client interface extension only */
+  avb_sink_counters_t _get_sink_counters(unsigned sink_num);
+  /** Intended for internal use within client interface extension only */
+  avb_source_counters_t _get_source_counters(unsigned source_num);
+  /** Intended for internal use within client interface extension only */
+  media_clock_server_stats_t _get_media_clock_server_stats(int clear);
 };
 
 interface media_clock_if {
@@ -142,6 +248,7 @@ interface media_clock_if {
   media_clock_info_t get_clock_info(unsigned clock_num);
   void set_clock_info(unsigned clock_num, media_clock_info_t info);
   void set_buf_fifo(unsigned i, int fifo);
+  media_clock_server_stats_t get_server_stats(int clear);
 };
 
 
@@ -158,10 +265,10 @@ extends client interface avb_interface : {
   {
     if (source_num >= AVB_NUM_SOURCES)
       return 0;
-    avb_source_info_t source;
-    source = i._get_source_info(source_num);
-    format = source.stream.format;
-    rate = source.stream.rate;
+    avb_stream_info_t stream;
+    stream = i._get_source_stream(source_num);
+    format = stream.format;
+    rate = stream.rate;
     return 1;
   }
 
@@ -184,14 +291,9 @@ extends client interface avb_interface : {
   {
     if (source_num >= AVB_NUM_SOURCES)
       return 0;
-    avb_source_info_t source;
-    source = i._get_source_info(source_num);
-    if (source.stream.state != AVB_SOURCE_STATE_DISABLED)
-      return 0;
-    source.stream.format = format;
-    source.stream.rate = rate;
-    i._set_source_info(source_num, source);
-    return 1;
+    enum avb_stream_field_t fields[2] = {AVB_STREAM_FIELD_FORMAT, AVB_STREAM_FIELD_RATE};
+    int values[2] = {format, rate};
+    return i._set_source_fields(source_num, fields, values, 2);
   }
 
   /** Get the channel count of an AVB source.
@@ -204,9 +306,9 @@ extends client interface avb_interface : {
   {
     if (source_num >= AVB_NUM_SOURCES)
       return 0;
-    avb_source_info_t source;
-    source = i._get_source_info(source_num);
-    channels = source.stream.num_channels;
+    int value[1];
+    i._get_sources_field(AVB_STREAM_FIELD_NUM_CHANNELS, source_num, value, 1);
+    channels = value[0];
     return 1;
   }
 
@@ -226,13 +328,9 @@ extends client interface avb_interface : {
   {
     if (source_num >= AVB_NUM_SOURCES)
       return 0;
-    avb_source_info_t source;
-    source = i._get_source_info(source_num);
-    if (source.stream.state != AVB_SOURCE_STATE_DISABLED)
-      return 0;
-    source.stream.num_channels = channels;
-    i._set_source_info(source_num, source);
-    return 1;
+    enum avb_stream_field_t fields[1] = {AVB_STREAM_FIELD_NUM_CHANNELS};
+    int values[1] = {channels};
+    return i._set_source_fields(source_num, fields, values, 1);
   }
 
   /** Get the media clock of an AVB source.
@@ -245,9 +343,9 @@ extends client interface avb_interface : {
   {
     if (source_num >= AVB_NUM_SOURCES)
       return 0;
-    avb_source_info_t source;
-    source = i._get_source_info(source_num);
-    sync = source.stream.sync;
+    int value[1];
+    i._get_sources_field(AVB_STREAM_FIELD_SYNC, source_num, value, 1);
+    sync = value[0];
     return 1;
   }
 
@@ -264,13 +362,9 @@ extends client interface avb_interface : {
   {
     if (source_num >= AVB_NUM_SOURCES)
       return 0;
-    avb_source_info_t source;
-    source = i._get_source_info(source_num);
-    if (source.stream.state != AVB_SOURCE_STATE_DISABLED)
-      return 0;
-    source.stream.sync = sync;
-    i._set_source_info(source_num, source);
-    return 1;
+    enum avb_stream_field_t fields[1] = {AVB_STREAM_FIELD_SYNC};
+    int values[1] = {sync};
+    return i._set_source_fields(source_num, fields, values, 1);
   }
 
   /** Get the presentation time offset of an AVB source.
@@ -283,9 +377,9 @@ extends client interface avb_interface : {
   {
     if (source_num >= AVB_NUM_SOURCES)
       return 0;
-    avb_source_info_t source;
-    source = i._get_source_info(source_num);
-    presentation = source.presentation;
+    int value[1];
+    i._get_sources_field(AVB_STREAM_FIELD_PRESENTATION, source_num, value, 1);
+    presentation = value[0];
     return 1;
   }
 
@@ -309,15 +403,99 @@ extends client interface avb_interface : {
   {
     if (source_num >= AVB_NUM_SOURCES)
       return 0;
-    avb_source_info_t source;
-    source = i._get_source_info(source_num);
-    if (source.stream.state != AVB_SOURCE_STATE_DISABLED)
+    enum avb_stream_field_t fields[1] = {AVB_STREAM_FIELD_PRESENTATION};
+    int values[1] = {presentation};
+    return i._set_source_fields(source_num, fields, values, 1);
+  }
+
+
+  /** Get the SR class of an AVB source.
+   *  \param i          interface to AVB manager
+   *  \param source_num the local source number
+   *  \param sr_class   the SR class of the stream
+   */
+  static inline int get_source_sr_class(client interface avb_interface i, unsigned source_num,
+                          enum avb_sr_class_t &sr_class)
+  {
+    if (source_num >= AVB_NUM_SOURCES)
+      return 0;
+    int value[1];
+    i._get_sources_field(AVB_STREAM_FIELD_SR_CLASS, source_num, value, 1);
+    sr_class = value[0];
+    return 1;
+  }
+
+  /** Set the SR class of an AVB source.
+   *
+   *  Class B streams are reserved over a 250us class measurement interval
+   *  rather than the 125us of Class A, so by default they send half as many
+   *  packets, each carrying twice the samples. Class B streams need
+   *  ``AVB_MIN_1722_PACKET_RATE`` to be 4000 or lower. The default is Class A.
+   *
+   *  This setting will not take effect until the next time the source
+   *  state moves from disabled to potential.
+   *
+   *  \param i          interface to AVB manager
+   *  \param source_num the local source number
+   *  \param sr_class   the SR class of the stream
+   */
+  static inline int set_source_sr_class(client interface avb_interface i, unsigned source_num,
+                          enum avb_sr_class_t sr_class)
+  {
+    if (source_num >= AVB_NUM_SOURCES)
+      return 0;
+    if (sr_class != AVB_SR_CLASS_A && sr_class != AVB_SR_CLASS_B)
       return 0;
-    source.presentation = presentation;
-    i._set_source_info(source_num, source);
+    enum avb_stream_field_t fields[1] = {AVB_STREAM_FIELD_SR_CLASS};
+    int values[1] = {sr_class};
+    return i._set_source_fields(source_num, fields, values, 1);
+  }
+
+  /** Get the 1722 packet rate of an AVB source.
+   *  \param i            interface to AVB manager
+   *  \param source_num   the local source number
+   *  \param packet_rate  the packet rate in packets per second, or 0 for one
+   *                      packet per class measurement interval
+   */
+  static inline int get_source_packet_rate(client interface avb_interface i, unsigned source_num,
+                             int &packet_rate)
+  {
+    if (source_num >= AVB_NUM_SOURCES)
+      return 0;
+    int value[1];
+    i._get_sources_field(AVB_STREAM_FIELD_PACKET_RATE, source_num, value, 1);
+    packet_rate = value[0];
     return 1;
   }
 
+  /** Set the 1722 packet rate of an AVB source.
+   *
+   *  Lower packet rates send larger, less frequent packets, reducing the
+   *  per-packet overhead on Talker and Listener at the cost of latency. A
+   *  rate of 0 (the default) sends one packet per class measurement interval
+   *  of the source's SR class (8000 for Class A, 4000 for Class B). Other
+   *  rates must divide 8000 and must not be lower than
+   *  ``AVB_MIN_1722_PACKET_RATE``.
+   *
+   *  This setting will not take effect until the next time the source
+   *  state moves from disabled to potential.
+   *
+   *  \param i            interface to AVB manager
+   *  \param source_num   the local source number
+   *  \param packet_rate  the packet rate in packets per second
+   */
+  static inline int set_source_packet_rate(client interface avb_interface i, unsigned source_num,
+                             int packet_rate)
+  {
+    if (source_num >= AVB_NUM_SOURCES)
+      return 0;
+    if (packet_rate != 0 &&
+        (packet_rate < AVB_MIN_1722_PACKET_RATE || packet_rate > 8000 || (8000 % packet_rate) != 0))
+      return 0;
+    enum avb_stream_field_t fields[1] = {AVB_STREAM_FIELD_PACKET_RATE};
+    int values[1] = {packet_rate};
+    return i._set_source_fields(source_num, fields, values, 1);
+  }
 
   /** Get the destination vlan of an AVB source.
    *  \param i          interface to AVB manager
@@ -329,9 +507,9 @@ extends client interface avb_interface : {
   {
     if (source_num >= AVB_NUM_SOURCES)
       return 0;
-    avb_source_info_t source;
-    source = i._get_source_info(source_num);
-    vlan = source.reservation.vlan_id;
+    int value[1];
+    i._get_sources_field(AVB_STREAM_FIELD_VLAN, source_num, value, 1);
+    vlan = value[0];
     return 1;
   }
 
@@ -352,11 +530,9 @@ extends client interface avb_interface : {
   {
     if (source_num >= AVB_NUM_SOURCES)
       return 0;
-    avb_source_info_t source;
-    source = i._get_source_info(source_num);
-    source.reservation.vlan_id = vlan;
-    i._set_source_info(source_num, source);
-    return 1;
+    enum avb_stream_field_t fields[1] = {AVB_STREAM_FIELD_VLAN};
+    int values[1] = {vlan};
+    return i._set_source_fields(source_num, fields, values, 1);
   }
 
   /** Get the current state of an AVB source.
@@ -369,9 +545,9 @@ extends client interface avb_interface : {
   {
     if (source_num >= AVB_NUM_SOURCES)
       return 0;
-    avb_source_info_t source;
-    source = i._get_source_info(source_num);
-    state = source.stream.state;
+    int value[1];
+    i._get_sources_field(AVB_STREAM_FIELD_STATE, source_num, value, 1);
+    state = value[0];
     return 1;
   }
 
@@ -391,11 +567,9 @@ extends client interface avb_interface : {
   {
     if (source_num >= AVB_NUM_SOURCES)
       return 0;
-    avb_source_info_t source;
-    source = i._get_source_info(source_num);
-    source.stream.state = state;
-    i._set_source_info(source_num, source);
-    return 1;
+    enum avb_stream_field_t fields[1] = {AVB_STREAM_FIELD_STATE};
+    int values[1] = {state};
+    return i._set_source_fields(source_num, fields, values, 1);
   }
 
   /** Get the channel map of an avb source.
@@ -411,10 +585,10 @@ extends client interface avb_interface : {
   {
     if (source_num >= AVB_NUM_SOURCES)
       return 0;
-    avb_source_info_t source;
-    source = i._get_source_info(source_num);
-    len = source.stream.num_channels;
-    memcpy(map, source.map, len<<2);
+    int value[1];
+    i._get_sources_field(AVB_STREAM_FIELD_NUM_CHANNELS, source_num, value, 1);
+    len = value[0];
+    i._get_source_map(source_num, map, len);
     return 1;
   }
 
@@ -439,15 +613,9 @@ extends client interface avb_interface : {
   {
     if (source_num >= AVB_NUM_SOURCES)
       return 0;
-    avb_source_info_t source;
-    source = i._get_source_info(source_num);
-    if (source.stream.state != AVB_SOURCE_STATE_DISABLED)
-      return 0;
     if (len > AVB_MAX_CHANNELS_PER_TALKER_STREAM)
       return 0;
-    memcpy(source.map, map, len<<2);
-    i._set_source_info(source_num, source);
-    return 1;
+    return i._set_source_map(source_num, map, len);
   }
 
   /** Get the destination address of an avb source.
@@ -461,10 +629,10 @@ extends client interface avb_interface : {
   {
     if (source_num >= AVB_NUM_SOURCES)
       return 0;
-    avb_source_info_t source;
-    source = i._get_source_info(source_num);
+    avb_srp_info_t reservation;
+    reservation = i._get_source_reservation(source_num);
     len = 6;
-    memcpy(addr, source.reservation.dest_mac_addr, 6);
+    memcpy(addr, reservation.dest_mac_addr, 6);
     return 1;
   }
 
@@ -485,15 +653,9 @@ extends client interface avb_interface : {
   {
     if (source_num >= AVB_NUM_SOURCES)
       return 0;
-    avb_source_info_t source;
-    source = i._get_source_info(source_num);
-    if (source.stream.state != AVB_SOURCE_STATE_DISABLED)
-      return 0;
     if (len != 6)
       return 0;
-    memcpy(source.reservation.dest_mac_addr, addr, 6);
-    i._set_source_info(source_num, source);
-    return 1;
+    return i._set_source_dest(source_num, addr);
   }
 
   static inline int get_source_id(client interface avb_interface i, unsigned source_num,
@@ -501,9 +663,9 @@ extends client interface avb_interface : {
   {
     if (source_num >= AVB_NUM_SOURCES)
       return 0;
-    avb_source_info_t source;
-    source = i._get_source_info(source_num);
-    memcpy(id, source.reservation.stream_id, 8);
+    avb_srp_info_t reservation;
+    reservation = i._get_source_reservation(source_num);
+    memcpy(id, reservation.stream_id, 8);
     return 1;
   }
 
@@ -517,9 +679,9 @@ extends client interface avb_interface : {
   {
     if (sink_num >= AVB_NUM_SINKS)
       return 0;
-    avb_sink_info_t sink;
-    sink = i._get_sink_info(sink_num);
-    memcpy(stream_id, sink.reservation.stream_id, 8);
+    avb_srp_info_t reservation;
+    reservation = i._get_sink_reservation(sink_num);
+    memcpy(stream_id, reservation.stream_id, 8);
     return 1;
   }
 
@@ -540,13 +702,7 @@ extends client interface avb_interface : {
   {
     if (sink_num >= AVB_NUM_SINKS)
       return 0;
-    avb_sink_info_t sink;
-    sink = i._get_sink_info(sink_num);
-    if (sink.stream.state != AVB_SINK_STATE_DISABLED)
-      return 0;
-    memcpy(sink.reservation.stream_id, stream_id, 8);
-    i._set_sink_info(sink_num, sink);
-    return 1;
+    return i._set_sink_id(sink_num, stream_id);
   }
 
 
@@ -561,10 +717,10 @@ extends client interface avb_interface : {
   {
     if (sink_num >= AVB_NUM_SINKS)
       return 0;
-    avb_sink_info_t sink;
-    sink = i._get_sink_info(sink_num);
-    format = sink.stream.format;
-    rate = sink.stream.rate;
+    avb_stream_info_t stream;
+    stream = i._get_sink_stream(sink_num);
+    format = stream.format;
+    rate = stream.rate;
     return 1;
   }
 
@@ -587,14 +743,9 @@ extends client interface avb_interface : {
   {
     if (sink_num >= AVB_NUM_SINKS)
       return 0;
-    avb_sink_info_t sink;
-    sink = i._get_sink_info(sink_num);
-    if (sink.stream.state != AVB_SINK_STATE_DISABLED)
-      return 0;
-    sink.stream.format = format;
-    sink.stream.rate = rate;
-    i._set_sink_info(sink_num, sink);
-    return 1;
+    enum avb_stream_field_t fields[2] = {AVB_STREAM_FIELD_FORMAT, AVB_STREAM_FIELD_RATE};
+    int values[2] = {format, rate};
+    return i._set_sink_fields(sink_num, fields, values, 2);
   }
 
   /** Get the channel count of an AVB sink.
@@ -607,9 +758,9 @@ extends client interface avb_interface : {
   {
     if (sink_num >= AVB_NUM_SINKS)
       return 0;
-    avb_sink_info_t sink;
-    sink = i._get_sink_info(sink_num);
-    channels = sink.stream.num_channels;
+    int value[1];
+    i._get_sinks_field(AVB_STREAM_FIELD_NUM_CHANNELS, sink_num, value, 1);
+    channels = value[0];
     return 1;
   }
 
@@ -629,13 +780,9 @@ extends client interface avb_interface : {
   {
     if (sink_num >= AVB_NUM_SINKS)
       return 0;
-    avb_sink_info_t sink;
-    sink = i._get_sink_info(sink_num);
-    if (sink.stream.state != AVB_SINK_STATE_DISABLED)
-      return 0;
-    sink.stream.num_channels = channels;
-    i._set_sink_info(sink_num, sink);
-    return 1;
+    enum avb_stream_field_t fields[1] = {AVB_STREAM_FIELD_NUM_CHANNELS};
+    int values[1] = {channels};
+    return i._set_sink_fields(sink_num, fields, values, 1);
   }
 
   /** Get the media clock of an AVB sink.
@@ -648,9 +795,9 @@ extends client interface avb_interface : {
   {
     if (sink_num >= AVB_NUM_SINKS)
       return 0;
-    avb_sink_info_t sink;
-    sink = i._get_sink_info(sink_num);
-    sync = sink.stream.sync;
+    int value[1];
+    i._get_sinks_field(AVB_STREAM_FIELD_SYNC, sink_num, value, 1);
+    sync = value[0];
     return 1;
   }
 
@@ -667,13 +814,9 @@ extends client interface avb_interface : {
   {
     if (sink_num >= AVB_NUM_SINKS)
       return 0;
-    avb_sink_info_t sink;
-    sink = i._get_sink_info(sink_num);
-    if (sink.stream.state != AVB_SINK_STATE_DISABLED)
-      return 0;
-    sink.stream.sync = sync;
-    i._set_sink_info(sink_num, sink);
-    return 1;
+    enum avb_stream_field_t fields[1] = {AVB_STREAM_FIELD_SYNC};
+    int values[1] = {sync};
+    return i._set_sink_fields(sink_num, fields, values, 1);
   }
 
   /** Get the virtual lan id of an AVB sink.
@@ -686,9 +829,9 @@ extends client interface avb_interface : {
   {
     if (sink_num >= AVB_NUM_SINKS)
       return 0;
-    avb_sink_info_t sink;
-    sink = i._get_sink_info(sink_num);
-    vlan = sink.reservation.vlan_id;
+    int value[1];
+    i._get_sinks_field(AVB_STREAM_FIELD_VLAN, sink_num, value, 1);
+    vlan = value[0];
     return 1;
   }
 
@@ -709,13 +852,9 @@ extends client interface avb_interface : {
   {
     if (sink_num >= AVB_NUM_SINKS)
       return 0;
-    avb_sink_info_t sink;
-    sink = i._get_sink_info(sink_num);
-    if (sink.stream.state != AVB_SINK_STATE_DISABLED)
-      return 0;
-    sink.reservation.vlan_id = vlan;
-    i._set_sink_info(sink_num, sink);
-    return 1;
+    enum avb_stream_field_t fields[1] = {AVB_STREAM_FIELD_VLAN};
+    int values[1] = {vlan};
+    return i._set_sink_fields(sink_num, fields, values, 1);
   }
 
   /** Get the incoming destination mac address of an avb sink.
@@ -729,10 +868,10 @@ extends client interface avb_interface : {
   {
     if (sink_num >= AVB_NUM_SINKS)
       return 0;
-    avb_sink_info_t sink;
-    sink = i._get_sink_info(sink_num);
+    avb_srp_info_t reservation;
+    reservation = i._get_sink_reservation(sink_num);
     len = 6;
-    memcpy(addr, sink.reservation.dest_mac_addr, 6);
+    memcpy(addr, reservation.dest_mac_addr, 6);
     return 1;
   }
 
@@ -756,15 +895,9 @@ extends client interface avb_interface : {
   {
     if (sink_num >= AVB_NUM_SINKS)
       return 0;
-    avb_sink_info_t sink;
-    sink = i._get_sink_info(sink_num);
-    if (sink.stream.state != AVB_SINK_STATE_DISABLED)
-      return 0;
     if (len != 6)
       return 0;
-    memcpy(sink.reservation.dest_mac_addr, addr, 6);
-    i._set_sink_info(sink_num, sink);
-    return 1;
+    return i._set_sink_addr(sink_num, addr);
   }
 
   /** Get the state of an AVB sink.
@@ -777,9 +910,9 @@ extends client interface avb_interface : {
   {
     if (sink_num >= AVB_NUM_SINKS)
       return 0;
-    avb_sink_info_t sink;
-    sink = i._get_sink_info(sink_num);
-    state = sink.stream.state;
+    int value[1];
+    i._get_sinks_field(AVB_STREAM_FIELD_STATE, sink_num, value, 1);
+    state = value[0];
     return 1;
   }
 
@@ -799,11 +932,9 @@ extends client interface avb_interface : {
   {
     if (sink_num >= AVB_NUM_SINKS)
       return 0;
-    avb_sink_info_t sink;
-    sink = i._get_sink_info(sink_num);
-    sink.stream.state = state;
-    i._set_sink_info(sink_num, sink);
-    return 1;
+    enum avb_stream_field_t fields[1] = {AVB_STREAM_FIELD_STATE};
+    int values[1] = {state};
+    return i._set_sink_fields(sink_num, fields, values, 1);
   }
 
   /** Get the map of an AVB sink.
@@ -819,10 +950,10 @@ extends client interface avb_interface : {
   {
     if (sink_num >= AVB_NUM_SINKS)
       return 0;
-    avb_sink_info_t sink;
-    sink = i._get_sink_info(sink_num);
-    len = sink.stream.num_channels;
-    memcpy(map, sink.map, len<<2);
+    int value[1];
+    i._get_sinks_field(AVB_STREAM_FIELD_NUM_CHANNELS, sink_num, value, 1);
+    len = value[0];
+    i._get_sink_map(sink_num, map, len);
     return 1;
   }
 
@@ -844,13 +975,9 @@ extends client interface avb_interface : {
   {
     if (sink_num >= AVB_NUM_SINKS)
       return 0;
-    avb_sink_info_t sink;
-    sink = i._get_sink_info(sink_num);
     if (len > AVB_MAX_CHANNELS_PER_LISTENER_STREAM)
       return 0;
-    memcpy(sink.map, map, len<<2);
-    i._set_sink_info(sink_num, sink);
-    return 1;
+    return i._set_sink_map(sink_num, map, len);
   }
 
 
@@ -1010,6 +1137,78 @@ extends client interface avb_interface : {
     return 1;
   }
 
+  /** Read one field of a range of AVB sources in a single call.
+   *
+   *  \param i            interface to AVB manager
+   *  \param field        the field to read
+   *  \param first_source the local number of the first source
+   *  \param values       the value of the field for each source
+   *  \param n            the number of sources to read
+   */
+  static inline int get_sources_field(client interface avb_interface i,
+                                      enum avb_stream_field_t field,
+                                      unsigned first_source,
+                                      int values[n], unsigned n)
+  {
+    if (first_source + n > AVB_NUM_SOURCES)
+      return 0;
+    i._get_sources_field(field, first_source, values, n);
+    return 1;
+  }
+
+  /** Read one field of a range of AVB sinks in a single call.
+   *
+   *  \param i            interface to AVB manager
+   *  \param field        the field to read
+   *  \param first_sink   the local number of the first sink
+   *  \param values       the value of the field for each sink
+   *  \param n            the number of sinks to read
+   */
+  static inline int get_sinks_field(client interface avb_interface i,
+                                    enum avb_stream_field_t field,
+                                    unsigned first_sink,
+                                    int values[n], unsigned n)
+  {
+    if (first_sink + n > AVB_NUM_SINKS)
+      return 0;
+    i._get_sinks_field(field, first_sink, values, n);
+    return 1;
+  }
+
+  /** Start staging changes to AVB sources and sinks.
+   *
+   *  Until commit_stream_transaction() is called, the set functions for
+   *  sources and sinks, from any client, only record the new values.
+   *  Reads return the staged values. Only one transaction can be open at a
+   *  time, and it should be committed promptly as source state changes
+   *  from SRP are held back with the rest.
+   *
+   *  \param i            interface to AVB manager
+   *  \return             1 if the transaction was started, 0 if another
+   *                      client has one open
+   */
+  static inline int begin_stream_transaction(client interface avb_interface i)
+  {
+    return i._begin_stream_transaction();
+  }
+
+  /** Apply all changes staged since begin_stream_transaction().
+   *
+   *  Each source and sink is compared with its configuration when the
+   *  transaction began and only the net change is applied. Streams being
+   *  disabled or reconfigured are all stopped before any stream is
+   *  started, so channels and addresses can move from one stream to
+   *  another. A stream that is reconfigured keeps its stream MAC filter
+   *  and SRP declaration if they have not changed.
+   *
+   *  \param i            interface to AVB manager
+   *  \return             1 on success, 0 if this client has no open transaction
+   */
+  static inline int commit_stream_transaction(client interface avb_interface i)
+  {
+    return i._commit_stream_transaction();
+  }
+
   /** Read back debug counters
     *
     * \param i          interface to AVB manager
@@ -1020,6 +1219,54 @@ extends client interface avb_interface : {
   {
     return i._get_debug_counters();
   }
+
+  /** Read back the counters of an AVB sink.
+   *
+   *  The counters are kept by the listener that owns the sink and are
+   *  only collected when read.
+   *
+   *  \param i          interface to AVB manager
+   *  \param sink_num   the local sink number
+   *  \param counters   the counters of the sink
+   */
+  static inline int get_sink_counters(client interface avb_interface i, unsigned sink_num,
+                                      avb_sink_counters_t &counters)
+  {
+    if (sink_num >= AVB_NUM_SINKS)
+      return 0;
+    counters = i._get_sink_counters(sink_num);
+    return 1;
+  }
+
+  /** Read back the counters of an AVB source.
+   *
+   *  The counters are kept by the talker that owns the source and are
+   *  only collected when read.
+   *
+   *  \param i          interface to AVB manager
+   *  \param source_num the local source number
+   *  \param counters   the counters of the source
+   */
+  static inline int get_source_counters(client interface avb_interface i, unsigned source_num,
+                                        avb_source_counters_t &counters)
+  {
+    if (source_num >= AVB_NUM_SOURCES)
+      return 0;
+    counters = i._get_source_counters(source_num);
+    return 1;
+  }
+
+  /** Read back the worst case timings of the media clock server.
+   *
+   *  \param i          interface to AVB manager
+   *  \param clear      non-zero to restart the measurements once read
+   *  \return the timings, all zero if there is no media clock server
+   */
+  static inline media_clock_server_stats_t get_media_clock_server_stats(client interface avb_interface i,
+                                                                        int clear)
+  {
+    return i._get_media_clock_server_stats(clear);
+  }
 }
 
 /** An interface used to register and deregister stream reservations via MSRP */
@@ -1193,6 +1440,12 @@ void avb_1722_listener(streaming chanend c_eth_rx_hp,
  *  \param num_ptp          The number of PTP clients attached
  *  \param server_type      The type of the PTP server (``PTP_GRANDMASTER_CAPABLE``
                             or ``PTP_SLAVE_ONLY``)
+ *
+ *  Media clock output edges are serviced ahead of every other event. PTP
+ *  periodic processing and media clock recovery are queued and run one item
+ *  at a time once no other event is ready, so a clock edge waits behind at
+ *  most one of them. The worst case service time of each type of event is
+ *  reported by get_media_clock_server_stats().
  */
 void gptp_media_clock_server(server interface media_clock_if media_clock_ctl,
                             chanend ?ptp_svr,
@@ -1214,5 +1467,7 @@ int avb_get_source_vlan(CLIENT_INTERFACE(avb_interface, avb), unsigned source_nu
 int avb_set_source_vlan(CLIENT_INTERFACE(avb_interface, avb), unsigned source_num, int vlan);
 int avb_get_sink_vlan(CLIENT_INTERFACE(avb_interface, avb), unsigned sink_num, REFERENCE_PARAM(int, vlan));
 int avb_set_sink_vlan(CLIENT_INTERFACE(avb_interface, avb), unsigned sink_num, int vlan);
+int avb_begin_stream_transaction(CLIENT_INTERFACE(avb_interface, avb));
+int avb_commit_stream_transaction(CLIENT_INTERFACE(avb_interface, avb));
 
 #endif // _avb_h_
@@ -214,12 +214,45 @@ typedef struct {
 #define AECP_GET_COUNTERS_CLOCK_DOMAIN_LOCKED_OFFSET    (0)
 #define AECP_GET_COUNTERS_CLOCK_DOMAIN_UNLOCKED_OFFSET  (4)
 
+/* Counter n of a descriptor is flagged by bit n of counters_valid and
+ * stored at offset 4*n of counters_block */
+#define AECP_GET_COUNTERS_VALID(n)                              (1 << (n))
+#define AECP_GET_COUNTERS_OFFSET(n)                             (4 * (n))
+
+#define AECP_GET_COUNTERS_AVB_INTERFACE_LINK_UP                 (0)
+#define AECP_GET_COUNTERS_AVB_INTERFACE_LINK_DOWN               (1)
+#define AECP_GET_COUNTERS_AVB_INTERFACE_GPTP_GM_CHANGED         (5)
+#define AECP_GET_COUNTERS_AVB_INTERFACE_GPTP_RECEIPT_TIMEOUT    (24) // Entity specific
+#define AECP_GET_COUNTERS_AVB_INTERFACE_GPTP_PDELAY_LOST        (25) // Entity specific
+
+#define AECP_GET_COUNTERS_STREAM_INPUT_MEDIA_LOCKED             (0)
+#define AECP_GET_COUNTERS_STREAM_INPUT_MEDIA_UNLOCKED           (1)
+#define AECP_GET_COUNTERS_STREAM_INPUT_STREAM_RESET             (2)
+#define AECP_GET_COUNTERS_STREAM_INPUT_SEQ_NUM_MISMATCH         (3)
+#define AECP_GET_COUNTERS_STREAM_INPUT_MEDIA_RESET              (4)
+#define AECP_GET_COUNTERS_STREAM_INPUT_TIMESTAMP_UNCERTAIN      (5)
+#define AECP_GET_COUNTERS_STREAM_INPUT_TIMESTAMP_VALID          (6)
+#define AECP_GET_COUNTERS_STREAM_INPUT_TIMESTAMP_NOT_VALID      (7)
+#define AECP_GET_COUNTERS_STREAM_INPUT_UNSUPPORTED_FORMAT       (8)
+#define AECP_GET_COUNTERS_STREAM_INPUT_FRAMES_RX                (11)
+#define AECP_GET_COUNTERS_STREAM_INPUT_FIFO_OVERFLOW            (24) // Entity specific
+#define AECP_GET_COUNTERS_STREAM_INPUT_FIFO_UNDERFLOW           (25) // Entity specific
+
+#define AECP_GET_COUNTERS_STREAM_OUTPUT_STREAM_START            (0)
+#define AECP_GET_COUNTERS_STREAM_OUTPUT_STREAM_STOP             (1)
+#define AECP_GET_COUNTERS_STREAM_OUTPUT_FRAMES_TX               (4)
+
 /* 7.4.35.1 START_STREAMING */
 typedef struct {
     unsigned char descriptor_type[2];
     unsigned char descriptor_id[2];
 } avb_1722_1_aem_startstop_streaming_t;
 
+/* 7.4.37.1 REGISTER_UNSOLICITED_NOTIFICATION and 7.4.38.1 DEREGISTER_UNSOLICITED_NOTIFICATION */
+typedef struct {
+    unsigned char flags[4];
+} avb_1722_1_aem_register_unsolicited_notification_t;
+
 /* 7.4.39.1 IDENTIFY_NOTIFICATION */
 typedef struct {
     unsigned char descriptor_type[2];
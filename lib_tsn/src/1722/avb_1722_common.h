@@ -126,6 +126,7 @@ typedef struct
 #define AVBTP_SUBTYPE(x)               (x->subtype & 0x7F)
 #define AVBTP_SV(x)                    (x->version_flags >> 7)
 #define AVBTP_VERSION(x)               ((x->version_flags >> 4) & 0x7)
+#define AVBTP_MR(x)                    ((x->version_flags >> 3) & 0x1)
 #define AVBTP_GV(x)                    ((x->version_flags >> 1) & 0x1)
 #define AVBTP_TV(x)                    (x->version_flags & 0x1)
 #define AVBTP_SEQUENCE_NUMBER(x)       (x->sequence_number)
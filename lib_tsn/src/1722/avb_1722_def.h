@@ -8,6 +8,7 @@
 #define _AVB1722_DEF_H_ 1
 
 #include "avb_1722_common.h"
+#include "default_avb_conf.h"
 
 
 // common definations
@@ -118,15 +119,19 @@ enum {
   AVB1722_SET_PORT,
   AVB1722_ADJUST_LISTENER_CHANNEL_MAP,
   AVB1722_ADJUST_LISTENER_VOLUME,
-  AVB1722_GET_COUNTERS
+  AVB1722_GET_COUNTERS,
+  AVB1722_GET_STREAM_COUNTERS
 };
 
-// The rate of 1722 packets (8kHz)
+// The default rate of 1722 packets: one per Class A measurement interval (8kHz)
 #define AVB1722_PACKET_RATE (8000)
 
-// The number of samples per stream in each 1722 packet
-#define AVB1722_LISTENER_MAX_NUM_SAMPLES_PER_CHANNEL ((AVB_MAX_AUDIO_SAMPLE_RATE / AVB1722_PACKET_RATE)+1)
-#define AVB1722_TALKER_MAX_NUM_SAMPLES_PER_CHANNEL (AVB_MAX_AUDIO_SAMPLE_RATE / AVB1722_PACKET_RATE)
+// The rate of 1722 packets for one per Class B measurement interval (4kHz)
+#define AVB1722_CLASS_B_PACKET_RATE (4000)
+
+// The maximum number of samples per stream in each 1722 packet, at the lowest packet rate
+#define AVB1722_LISTENER_MAX_NUM_SAMPLES_PER_CHANNEL ((AVB_MAX_AUDIO_SAMPLE_RATE / AVB_MIN_1722_PACKET_RATE)+1)
+#define AVB1722_TALKER_MAX_NUM_SAMPLES_PER_CHANNEL ((AVB_MAX_AUDIO_SAMPLE_RATE + (AVB_MIN_1722_PACKET_RATE-1)) / AVB_MIN_1722_PACKET_RATE)
 
 // We add a 2% fudge factor to handle clock difference in the stream transmission shaping
 #define AVB1722_PACKET_PERIOD_TIMER_TICKS (((100000000 / AVB1722_PACKET_RATE)*98)/100)
@@ -28,16 +28,35 @@
 #endif
 
 
+/** Counters kept by the listener for each of its streams */
+struct listener_stream_counters {
+  unsigned stream_reset;
+  unsigned seq_num_mismatch;
+  unsigned media_reset;
+  unsigned timestamp_uncertain;
+  unsigned timestamp_valid;
+  unsigned timestamp_not_valid;
+  unsigned unsupported_format;
+  unsigned frames_rx;
+};
+
+/** Value of chan_lock while the configured stream format is presumed and
+ *  waiting to be confirmed by the first received packets */
+#define AVB_1722_LISTENER_FORMAT_PRESUMED (-1)
+
 typedef struct avb_1722_stream_info_t {
   short active;                    //!< 1-bit flag to say if the stream is active
   short state;                     //!< Generic state info
   int chan_lock;                   //!< Counter for locking onto a data stream
   int rate;                        //!< The estimated rate of the audio traffic
+  int packet_rate;                 //!< The 1722 packet rate of the configured stream
   int prev_num_samples;            //!< Number of samples in last received 1722 packet
   int num_channels_in_payload;     //!< The number of channels in the 1722 payloads
   int num_channels;
   int dbc;                         //!< The DBC of the last seen packet
   int last_sequence;               //!< The sequence number from the last 1722 packet
+  int media_restart;               //!< The media clock restart bit from the last 1722 packet
+  struct listener_stream_counters counters;
   audio_output_fifo_t map[AVB_MAX_CHANNELS_PER_LISTENER_STREAM];
 } avb_1722_stream_info_t;
 
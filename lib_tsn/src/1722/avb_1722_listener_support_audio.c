@@ -4,6 +4,7 @@
 #include "gptp.h"
 #include "avb_1722_def.h"
 #include "audio_output_fifo.h"
+#include "media_clock_client.h"
 #include <string.h>
 #include <xs1.h>
 #include <xscope.h>
@@ -57,6 +58,30 @@ int avb_1722_listener_process_packet(chanend buf_ctl,
     return (0);
   }
 
+  stream_info->counters.frames_rx++;
+
+  if (stream_info->last_sequence >= 0 &&
+      (unsigned char)(AVBTP_SEQUENCE_NUMBER(pAVBHdr) - stream_info->last_sequence) != 1)
+  {
+    stream_info->counters.seq_num_mismatch++;
+  }
+  stream_info->last_sequence = AVBTP_SEQUENCE_NUMBER(pAVBHdr);
+
+  if (stream_info->media_restart >= 0 &&
+      stream_info->media_restart != AVBTP_MR(pAVBHdr))
+  {
+    stream_info->counters.media_reset++;
+  }
+  stream_info->media_restart = AVBTP_MR(pAVBHdr);
+
+  if (AVBTP_TU(pAVBHdr))
+    stream_info->counters.timestamp_uncertain++;
+
+  if (AVBTP_TV(pAVBHdr))
+    stream_info->counters.timestamp_valid++;
+  else
+    stream_info->counters.timestamp_not_valid++;
+
 #if AVB_1722_RECORD_ERRORS
   unsigned char seq_num = AVBTP_SEQUENCE_NUMBER(pAVBHdr);
   if ((unsigned char)((unsigned char)seq_num - (unsigned char)prev_seq_num) != 1) {
@@ -79,6 +104,32 @@ int avb_1722_listener_process_packet(chanend buf_ctl,
   int prev_num_samples = stream_info->prev_num_samples;
   stream_info->prev_num_samples = num_samples_in_payload;
 
+  if (stream_info->chan_lock == AVB_1722_LISTENER_FORMAT_PRESUMED)
+  {
+    int rate_diff;
+
+    if (!prev_num_samples || dbc_diff == 0) {
+      return 0;
+    }
+
+    // The samples per channel in a packet put the sample rate within the
+    // packet rate of the stream
+    rate_diff = dbc_diff * stream_info->packet_rate - stream_info->rate;
+
+    if (prev_num_samples == dbc_diff * stream_info->num_channels_in_payload &&
+        rate_diff < stream_info->packet_rate && rate_diff > -stream_info->packet_rate)
+    {
+      stream_info->chan_lock = 16;
+    }
+    else
+    {
+      stream_info->num_channels_in_payload = 0;
+      stream_info->chan_lock = 0;
+    }
+
+    return 0;
+  }
+
   if (stream_info->chan_lock < 16)
   {
     int num_channels;
@@ -103,7 +154,9 @@ int avb_1722_listener_process_packet(chanend buf_ctl,
 
     if (stream_info->chan_lock == 16)
     {
-      stream_info->rate = (stream_info->rate / stream_info->num_channels_in_payload / 16);
+      // Scaled to the samples per channel in an 8kHz packet
+      stream_info->rate = (int)(((long long)stream_info->rate * stream_info->packet_rate) /
+                                (stream_info->num_channels_in_payload * 16 * AVB1722_PACKET_RATE));
 
       switch (stream_info->rate)
       {
@@ -115,7 +168,10 @@ int avb_1722_listener_process_packet(chanend buf_ctl,
       case 11: stream_info->rate = 88200; break;
       case 12: stream_info->rate = 96000; break;
       case 24: stream_info->rate = 192000; break;
-      default: stream_info->rate = 0; break;
+      default:
+        stream_info->rate = 0;
+        stream_info->counters.unsupported_format++;
+        break;
       }
     }
 
@@ -154,11 +210,28 @@ int avb_1722_listener_process_packet(chanend buf_ctl,
     }
   }
 
-  for (i=0; i<num_channels; i++)
+  // Report the timing of all the stream's FIFOs to the media clock server at once
   {
-    if (map[i] >= 0)
+    int report[AVB_MAX_CHANNELS_PER_LISTENER_STREAM];
+    int num_report = 0;
+    int outstanding = *notified_buf_ctl;
+
+    for (i=0; i<num_channels; i++)
     {
-      audio_output_fifo_maintain(h, map[i], buf_ctl, notified_buf_ctl);
+      if (map[i] >= 0)
+      {
+        int id = audio_output_fifo_maintain(h, map[i], buf_ctl, notified_buf_ctl);
+        if (id != -1)
+          report[num_report++] = id;
+      }
+    }
+
+    // Only one transaction may be in flight on the channel. If a FIFO further
+    // along announced a new stream then these reports are dropped and made
+    // again after the next notification period.
+    if (num_report && *notified_buf_ctl == outstanding) {
+      notify_buf_ctl_of_info(buf_ctl, report, num_report);
+      *notified_buf_ctl += num_report;
     }
   }
 
@@ -24,6 +24,13 @@
 #define AVB_MAX_STREAMS_PER_TALKER_UNIT (AVB_NUM_SOURCES)
 #endif
 
+//! Counters kept by the talker for each of its streams
+struct talker_stream_counters {
+  unsigned stream_start;
+  unsigned stream_stop;
+  unsigned frames_tx;
+};
+
 //! Data structure to identify Ethernet/AVB stream configuration.
 typedef struct avb1722_Talker_StreamConfig_t
 {
@@ -72,6 +79,8 @@ typedef struct avb1722_Talker_StreamConfig_t
   int txport;
   //! a transmitted packet sequence counter
   char sequence_number;
+  //! counters of the stream, read through AVB1722_GET_STREAM_COUNTERS
+  struct talker_stream_counters counters;
 } avb1722_Talker_StreamConfig_t;
 
 
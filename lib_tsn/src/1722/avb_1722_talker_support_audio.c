@@ -194,7 +194,9 @@ int avb1722_create_packet(unsigned char Buf0[],
     unsigned this_dbc = dbc + current_samples_in_packet;
     unsigned int ts_this_dbc = ((this_dbc & (stream_info->ts_interval-1)) == 0);
 
-    if (ts_this_dbc) {
+    // At low packet rates a packet can span more than one SYT_INTERVAL, the
+    // timestamp is that of the first sample that falls on one
+    if (ts_this_dbc && !timestamp_valid) {
         timestamp_valid = 1;
         presentation_time = frame->timestamp;
     }
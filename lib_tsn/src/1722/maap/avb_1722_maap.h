@@ -28,6 +28,28 @@ void avb_1722_maap_request_addresses(int num_addresses, char (&?start_address)[]
 void avb_1722_maap_request_addresses(int num_addresses, char start_address[]);
 #endif
 
+/** Request a range of multicast addresses for a group of Talker sources.
+ *
+ *  Like avb_1722_maap_request_addresses() but adds an independent range
+ *  alongside any already held, for the sources first_source to
+ *  first_source + num_addresses - 1. Each range is probed, announced and
+ *  defended on its own, so the ranges of several stream groups are probed
+ *  concurrently and a conflict on one of them leaves the others alone. Any
+ *  existing range holding one of these sources is relinquished.
+ *
+ *  \param first_source     the source that is given the first address
+ *  \param num_addresses    number of addresses to try and reserve;
+ *                          will be reserved in a contiguous range
+ *  \param start_address    an optional six byte array specifying the required
+ *                          start address of the range, as for
+ *                          avb_1722_maap_request_addresses()
+ **/
+#ifdef __XC__
+void avb_1722_maap_request_source_addresses(int first_source, int num_addresses, char (&?start_address)[]);
+#else
+void avb_1722_maap_request_source_addresses(int first_source, int num_addresses, char start_address[]);
+#endif
+
 void avb_1722_maap_init(unsigned char macaddr[6]);
 
 #ifdef __XC__
@@ -36,21 +58,30 @@ void avb_1722_maap_process_packet(unsigned char buf[nbytes], unsigned int nbytes
 void avb_1722_maap_process_packet(unsigned char buf[], unsigned int nbytes, unsigned char src_addr[6], CLIENT_INTERFACE(ethernet_tx_if, i_eth));
 #endif
 
-/** Relinquish the reserved MAAP address range
+/** Relinquish the reserved MAAP address ranges
  *
- *  This function abandons the claim to the reserved address range
+ *  This function abandons the claim to all reserved address ranges
  */
 void avb_1722_maap_relinquish_addresses();
 
 
-/** Re-request a claim on the existing address range
+/** Re-request a claim on the existing address ranges
  *
- *  If there is a current address reservation, this will reset the state
- *  machine into the PROBE state, in order to cause the protocol to
- *  re-probe and re-allocate the addresses.
+ *  For each current address reservation, this will pick a new random base
+ *  and reset the state machine into the PROBE state, in order to cause the
+ *  protocol to re-probe and re-allocate the addresses.
  */
 void avb_1722_maap_rerequest_addresses();
 
+/** Probe the existing address ranges again at their current addresses
+ *
+ *  Used when the link comes back up to check that the addresses held are
+ *  still free.
+ *
+ *  \returns the number of address ranges being probed
+ */
+int avb_1722_maap_reprobe_addresses();
+
 #ifdef __XC__
 /** Perform MAAP periodic functions
  *
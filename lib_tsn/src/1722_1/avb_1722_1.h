@@ -50,13 +50,15 @@ void avb_1722_1_periodic(client interface ethernet_tx_if i_eth, chanend c_ptp, c
  *  \param  c_tx        a transmit chanend to the Ethernet server
  *  \param  i_avb_api   client interface of type avb_interface into avb_manager()
  *  \param  i_1722_1_entity client interface of type avb_1722_1_control_callbacks
+ *  \param  c_ptp       a chanend to the PTP server
  */
 void avb_1722_1_process_packet(unsigned char buf[len],
                                 unsigned len,
                                 unsigned char src_addr[6],
                                 client interface ethernet_tx_if i_eth,
                                 CLIENT_INTERFACE(avb_interface, i_avb_api),
-                                CLIENT_INTERFACE(avb_1722_1_control_callbacks, i_1722_1_entity));
+                                CLIENT_INTERFACE(avb_1722_1_control_callbacks, i_1722_1_entity),
+                                chanend c_ptp);
 #endif
 
 #endif
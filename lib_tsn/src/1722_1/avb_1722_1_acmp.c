@@ -8,12 +8,15 @@
 #include "debug_print.h"
 #include "avb.h"
 #include "misc_timer.h"
+#include "avb_control_deadline.h"
 #ifdef AVB_1722_1_ENABLE_ASSERTIONS
 #include <assert.h>
 #endif
 #include "avb_1722_1_app_hooks.h"
 #include "avb_1722_def.h"
 #include "avb_1722_1.h"
+#include "avb_1722_1_aecp.h"
+#include "aem_descriptor_types.h"
 
 /* Inflight command defines */
 #define CONTROLLER  0
@@ -39,9 +42,19 @@ avb_1722_1_acmp_listener_stream_info acmp_listener_streams[AVB_1722_1_MAX_LISTEN
 avb_1722_1_acmp_talker_stream_info acmp_talker_streams[AVB_1722_1_MAX_TALKERS];
 
 // Inflight command lists
-avb_1722_1_acmp_inflight_command acmp_controller_inflight_commands[AVB_1722_1_MAX_INFLIGHT_COMMANDS];
+avb_1722_1_acmp_inflight_command acmp_controller_inflight_commands[AVB_1722_1_ACMP_CONTROLLER_MAX_INFLIGHT];
 avb_1722_1_acmp_inflight_command acmp_listener_inflight_commands[AVB_1722_1_MAX_INFLIGHT_COMMANDS];
 
+// Inflight controller commands chained by the listener sink they target, so
+// that commands to one sink stay in order while those to different sinks are
+// outstanding together
+static short acmp_controller_listener_head[AVB_1722_1_ACMP_CONTROLLER_MAX_INFLIGHT];
+static short acmp_controller_listener_next[AVB_1722_1_ACMP_CONTROLLER_MAX_INFLIGHT];
+
+// Controller commands waiting for an inflight slot
+static avb_1722_1_acmp_cmd_resp acmp_controller_queue[AVB_1722_1_ACMP_CONTROLLER_QUEUE_SIZE];
+static int acmp_controller_queue_len;
+
 static unsigned acmp_centisecond_counter[2];
 static avb_timer acmp_inflight_timer[2];
 
@@ -57,6 +70,9 @@ avb_1722_1_acmp_cmd_resp acmp_listener_rcvd_cmd_resp;
 short sequence_id[2];
 
 void acmp_zero_listener_stream_info(int unique_id);
+#if AVB_1722_1_FAST_CONNECT_ENABLED
+static void acmp_listener_load_fast_connect_info(void);
+#endif
 
 /**
  * Initialises ACMP state machines, data structures and timers.
@@ -66,7 +82,9 @@ void acmp_zero_listener_stream_info(int unique_id);
 void avb_1722_1_acmp_controller_init()
 {
     acmp_controller_state = ACMP_CONTROLLER_WAITING;
-    memset(acmp_controller_inflight_commands, 0, sizeof(avb_1722_1_acmp_inflight_command) * AVB_1722_1_MAX_INFLIGHT_COMMANDS);
+    memset(acmp_controller_inflight_commands, 0, sizeof(acmp_controller_inflight_commands));
+    for (int i = 0; i < AVB_1722_1_ACMP_CONTROLLER_MAX_INFLIGHT; i++) acmp_controller_listener_head[i] = -1;
+    acmp_controller_queue_len = 0;
 
     sequence_id[CONTROLLER] = 0;
 
@@ -98,6 +116,10 @@ void avb_1722_1_acmp_listener_init()
     init_avb_timer(&acmp_inflight_timer[LISTENER], 10);
     acmp_centisecond_counter[LISTENER] = 0;
     start_avb_timer(&acmp_inflight_timer[LISTENER], 1);
+
+#if AVB_1722_1_FAST_CONNECT_ENABLED
+    acmp_listener_load_fast_connect_info();
+#endif
 }
 
 /**
@@ -152,6 +174,11 @@ static avb_1722_1_acmp_inflight_command *acmp_get_inflight_list(int entity_type)
     return inflight;
 }
 
+static int acmp_get_inflight_list_size(int entity_type)
+{
+    return (entity_type == CONTROLLER) ? AVB_1722_1_ACMP_CONTROLLER_MAX_INFLIGHT : AVB_1722_1_MAX_INFLIGHT_COMMANDS;
+}
+
 /*
  * Returns the index into the inflight list for a specific received command's sequence id
  *
@@ -162,6 +189,13 @@ static int acmp_get_inflight_from_sequence_id(int entity_type, unsigned short id
     int i;
     avb_1722_1_acmp_inflight_command *inflight = acmp_get_inflight_list(entity_type);
 
+    if (entity_type == CONTROLLER)
+    {
+        // Controller commands are kept in the slot given by their sequence id
+        i = id % AVB_1722_1_ACMP_CONTROLLER_MAX_INFLIGHT;
+        return (inflight[i].in_use && (inflight[i].command.sequence_id == id)) ? i : -1;
+    }
+
     for (i = 0; i < AVB_1722_1_MAX_INFLIGHT_COMMANDS; ++i)
     {
         if (inflight[i].in_use && (inflight[i].command.sequence_id == id))
@@ -199,33 +233,160 @@ void acmp_set_inflight_retry(int entity_type, unsigned int message_type, int inf
     inflight[inflight_idx].retried = 1;
 }
 
+static int acmp_controller_listener_bucket(avb_1722_1_acmp_cmd_resp *command)
+{
+    unsigned h = (unsigned) command->listener_guid.l ^ (unsigned) (command->listener_guid.l >> 32);
+    h ^= command->listener_unique_id;
+    h *= 0x9e3779b1;
+    return (h ^ (h >> 16)) % AVB_1722_1_ACMP_CONTROLLER_MAX_INFLIGHT;
+}
+
+// Returns non-zero if the controller has a command outstanding to the same
+// listener sink as command
+static int acmp_controller_listener_busy(avb_1722_1_acmp_cmd_resp *command)
+{
+    int bucket = acmp_controller_listener_bucket(command);
+
+    for (int i = acmp_controller_listener_head[bucket]; i >= 0; i = acmp_controller_listener_next[i])
+    {
+        avb_1722_1_acmp_cmd_resp *other = &acmp_controller_inflight_commands[i].command;
+
+        if (other->listener_guid.l == command->listener_guid.l &&
+            other->listener_unique_id == command->listener_unique_id) return 1;
+    }
+    return 0;
+}
+
+void acmp_controller_release_inflight(int inflight_idx)
+{
+    int bucket = acmp_controller_listener_bucket(&acmp_controller_inflight_commands[inflight_idx].command);
+    short *link = &acmp_controller_listener_head[bucket];
+
+    while (*link >= 0)
+    {
+        if (*link == inflight_idx)
+        {
+            *link = acmp_controller_listener_next[inflight_idx];
+            break;
+        }
+        link = &acmp_controller_listener_next[*link];
+    }
+
+    acmp_controller_inflight_commands[inflight_idx].in_use = 0;
+    acmp_controller_inflight_commands[inflight_idx].responded = 0;
+}
+
+void acmp_controller_queue_command(int message_type, const_guid_ref_t talker_guid, const_guid_ref_t listener_guid, int talker_id, int listener_id)
+{
+    avb_1722_1_acmp_cmd_resp *command = 0;
+
+    // Commands to a listener sink are sent in the order they were queued. A
+    // later command only supersedes the last one queued for the sink, and only
+    // if it is of the same type, so a disconnect is never lost to a connect.
+    for (int i = acmp_controller_queue_len - 1; i >= 0; i--)
+    {
+        if (acmp_controller_queue[i].listener_guid.l == listener_guid->l &&
+            acmp_controller_queue[i].listener_unique_id == listener_id)
+        {
+            if (acmp_controller_queue[i].message_type == message_type)
+            {
+                command = &acmp_controller_queue[i];
+            }
+            break;
+        }
+    }
+
+    if (!command)
+    {
+        if (acmp_controller_queue_len == AVB_1722_1_ACMP_CONTROLLER_QUEUE_SIZE)
+        {
+            debug_printf("ACMP Controller: Command queue full\n");
+            return;
+        }
+        command = &acmp_controller_queue[acmp_controller_queue_len++];
+    }
+
+    memset(command, 0, sizeof(avb_1722_1_acmp_cmd_resp));
+    command->message_type = message_type;
+    command->controller_guid = my_guid;
+    command->talker_guid.l = talker_guid->l;
+    command->listener_guid.l = listener_guid->l;
+    command->talker_unique_id = talker_id;
+    command->listener_unique_id = listener_id;
+}
+
+int acmp_controller_dequeue_command(void)
+{
+    unsigned short next_id = (unsigned short) sequence_id[CONTROLLER];
+    int free_slot = 0;
+
+    // A command's slot is its sequence id modulo the number of slots, so skip
+    // the ids of slots still waiting on a response. A slow listener then only
+    // holds up its own slot.
+    for (int i = 0; i < AVB_1722_1_ACMP_CONTROLLER_MAX_INFLIGHT; i++)
+    {
+        if (!acmp_controller_inflight_commands[(unsigned short)(next_id + i) % AVB_1722_1_ACMP_CONTROLLER_MAX_INFLIGHT].in_use)
+        {
+            next_id += i;
+            free_slot = 1;
+            break;
+        }
+    }
+
+    if (!free_slot) return 0;
+
+    for (int i = 0; i < acmp_controller_queue_len; i++)
+    {
+        if (acmp_controller_listener_busy(&acmp_controller_queue[i])) continue;
+
+        sequence_id[CONTROLLER] = (short) next_id;
+        acmp_controller_cmd_resp = acmp_controller_queue[i];
+        acmp_controller_queue_len--;
+        memmove(&acmp_controller_queue[i], &acmp_controller_queue[i+1], (acmp_controller_queue_len - i) * sizeof(avb_1722_1_acmp_cmd_resp));
+        return 1;
+    }
+    return 0;
+}
+
 void acmp_add_inflight(int entity_type, unsigned int message_type, unsigned short original_sequence_id)
 {
     int i;
     avb_1722_1_acmp_inflight_command *inflight = acmp_get_inflight_list(entity_type);
 
-    for (i = 0; i < AVB_1722_1_MAX_INFLIGHT_COMMANDS; i++)
+    if (entity_type == CONTROLLER)
     {
-        if (inflight[i].in_use) continue;
+        // acmp_controller_dequeue_command() has checked that this slot is free
+        int bucket = acmp_controller_listener_bucket(&acmp_controller_cmd_resp);
 
-        inflight[i].in_use = 1;
-        inflight[i].retried = 0;
-
-        switch (entity_type)
+        i = acmp_controller_cmd_resp.sequence_id % AVB_1722_1_ACMP_CONTROLLER_MAX_INFLIGHT;
+        acmp_controller_listener_next[i] = acmp_controller_listener_head[bucket];
+        acmp_controller_listener_head[bucket] = i;
+    }
+    else
+    {
+        for (i = 0; i < AVB_1722_1_MAX_INFLIGHT_COMMANDS; i++)
         {
-            case CONTROLLER: inflight[i].command = acmp_controller_cmd_resp; break;
-            case LISTENER: inflight[i].command = acmp_listener_rcvd_cmd_resp; break;
+            if (!inflight[i].in_use) break;
         }
 
-        inflight[i].command.message_type = message_type;
-        inflight[i].original_sequence_id = original_sequence_id;
+        // TODO: Return error if inflight command list is full
+        if (i == AVB_1722_1_MAX_INFLIGHT_COMMANDS) return;
+    }
 
-        acmp_update_inflight_timeout(entity_type, &inflight[i], message_type);
+    inflight[i].in_use = 1;
+    inflight[i].retried = 0;
+    inflight[i].responded = 0;
 
-        return;
+    switch (entity_type)
+    {
+        case CONTROLLER: inflight[i].command = acmp_controller_cmd_resp; break;
+        case LISTENER: inflight[i].command = acmp_listener_rcvd_cmd_resp; break;
     }
 
-    // TODO: Return error if inflight command list is full
+    inflight[i].command.message_type = message_type;
+    inflight[i].original_sequence_id = original_sequence_id;
+
+    acmp_update_inflight_timeout(entity_type, &inflight[i], message_type);
 }
 
 avb_1722_1_acmp_inflight_command *acmp_remove_inflight(int entity_type)
@@ -265,9 +426,9 @@ int acmp_check_inflight_command_timeouts(int entity_type)
     int i;
     avb_1722_1_acmp_inflight_command *inflight = acmp_get_inflight_list(entity_type);
 
-    for (i = 0; i < AVB_1722_1_MAX_INFLIGHT_COMMANDS; i++)
+    for (i = 0; i < acmp_get_inflight_list_size(entity_type); i++)
     {
-        if (inflight[i].in_use)
+        if (inflight[i].in_use && !inflight[i].responded)
         {
             if (acmp_centisecond_counter[entity_type] >= inflight[i].timeout) return i;
         }
@@ -276,6 +437,38 @@ int acmp_check_inflight_command_timeouts(int entity_type)
     return -1;
 }
 
+static void acmp_inflight_deadline(int entity_type)
+{
+    avb_1722_1_acmp_inflight_command *inflight = acmp_get_inflight_list(entity_type);
+
+    // The inflight timer only needs to tick while a command is waiting on it
+    for (int i = 0; i < acmp_get_inflight_list_size(entity_type); i++)
+    {
+        if (inflight[i].responded)
+        {
+            avb_control_deadline_now(AVB_CONTROL_ACMP);
+        }
+        if (inflight[i].in_use)
+        {
+            avb_control_deadline_timer(AVB_CONTROL_ACMP, &acmp_inflight_timer[entity_type]);
+            return;
+        }
+    }
+}
+
+void avb_1722_1_acmp_report_deadline(void)
+{
+    avb_control_deadline_clear(AVB_CONTROL_ACMP);
+
+    if (acmp_controller_state == ACMP_CONTROLLER_WAITING) acmp_inflight_deadline(CONTROLLER);
+
+    if (acmp_listener_state == ACMP_LISTENER_WAITING) acmp_inflight_deadline(LISTENER);
+    else if (acmp_listener_state != ACMP_LISTENER_IDLE) avb_control_deadline_now(AVB_CONTROL_ACMP);
+
+    if (acmp_talker_state != ACMP_TALKER_WAITING &&
+        acmp_talker_state != ACMP_TALKER_IDLE) avb_control_deadline_now(AVB_CONTROL_ACMP);
+}
+
 void acmp_set_talker_response(void)
 {
     int talker = acmp_talker_rcvd_cmd_resp.talker_unique_id;
@@ -348,98 +541,141 @@ static void store_rcvd_cmd_resp(avb_1722_1_acmp_cmd_resp* store, avb_1722_1_acmp
 }
 
 #if AVB_1722_1_FAST_CONNECT_ENABLED
-void acmp_listener_store_fast_connect_info(int unique_id, guid_t *controller_guid, guid_t *talker_guid, unsigned short talker_unique_id)
-{
-    if (fl_readDataPage(0, (unsigned char *)avb_1722_1_buf) == 0)
-    {
-        avb_1722_1_acmp_fast_connect_persist_state *info = (avb_1722_1_acmp_fast_connect_persist_state*) &avb_1722_1_buf[0];
-        unsigned int bitfield_temp = info->info_present_bitfield;
-
-        if (bitfield_temp == 0xFFFFFFFF)
-        {
-            debug_printf("First word empty\n");
-            bitfield_temp = 0;
-        }
-        else
-        {
-            fl_eraseDataSector(0);
-        }
+#if (8 + AVB_1722_1_MAX_LISTENERS * 40) > FLASH_PAGE_SIZE
+#error "Fast connect records for AVB_1722_1_MAX_LISTENERS do not fit in a flash page"
+#endif
 
-        bitfield_temp |= 1 << unique_id;
-        info->info_present_bitfield = bitfield_temp;
-        memcpy(&info->talkers[unique_id].controller_guid, controller_guid, sizeof(guid_t));
-        memcpy(&info->talkers[unique_id].talker_guid, talker_guid, sizeof(guid_t));
-        info->talkers[unique_id].talker_unique_id = talker_unique_id;
+static avb_1722_1_acmp_fast_connect_persist_state fast_connect_state;
+static int fast_connect_prearm_pending = 0;
 
-        fl_writeDataPage(0, (unsigned char *)avb_1722_1_buf);
+static void acmp_listener_save_fast_connect_info(void)
+{
+    memset(avb_1722_1_buf, 0xFF, FLASH_PAGE_SIZE);
+    memcpy(avb_1722_1_buf, &fast_connect_state, sizeof(fast_connect_state));
 
-        debug_printf("\nWrote fast connect for %d\n", unique_id);
-    }
-    else {
-        debug_printf("Couldn't read from data partition page 0\n");
+    if (fl_eraseDataSector(0) != 0 ||
+        fl_writeDataPage(0, (unsigned char *)avb_1722_1_buf) != 0)
+    {
+        debug_printf("Couldn't write fast connect info to data partition page 0\n");
     }
 }
 
-void acmp_listener_erase_fast_connect_info(int unique_id)
+void acmp_listener_store_fast_connect_info(int unique_id, int format, int rate, int num_channels)
 {
-    if (fl_readDataPage(0, (unsigned char *)avb_1722_1_buf) == 0)
+    avb_1722_1_acmp_fast_connect_talker_info record;
+
+    memset(&record, 0, sizeof(record));
+    record.controller_guid = acmp_listener_rcvd_cmd_resp.controller_guid;
+    record.talker_guid = acmp_listener_rcvd_cmd_resp.talker_guid;
+    record.talker_unique_id = acmp_listener_rcvd_cmd_resp.talker_unique_id;
+    record.vlan_id = acmp_listener_rcvd_cmd_resp.vlan_id;
+    record.stream_id[0] = (unsigned)(acmp_listener_rcvd_cmd_resp.stream_id.l >> 32);
+    record.stream_id[1] = (unsigned)(acmp_listener_rcvd_cmd_resp.stream_id.l >> 0);
+    memcpy(record.dest_mac, acmp_listener_rcvd_cmd_resp.stream_dest_mac, 6);
+    record.format = format;
+    record.num_channels = num_channels;
+    record.rate = rate;
+
+    // A fast connect at every boot finds the same talker again, so only touch
+    // the flash when the connection has actually changed
+    if (((fast_connect_state.info_present_bitfield >> unique_id) & 1) &&
+        memcmp(&fast_connect_state.talkers[unique_id], &record, sizeof(record)) == 0)
     {
-        avb_1722_1_acmp_fast_connect_persist_state *info = (avb_1722_1_acmp_fast_connect_persist_state*) &avb_1722_1_buf[0];
-        unsigned int bitfield_temp = info->info_present_bitfield;
+        return;
+    }
 
-        if (bitfield_temp != 0xFFFFFFFF)
-        {
-            fl_eraseDataSector(0);
+    fast_connect_state.info_present_bitfield |= 1 << unique_id;
+    fast_connect_state.talkers[unique_id] = record;
+    acmp_listener_save_fast_connect_info();
 
-            bitfield_temp &= ~(1 << unique_id);
-            info->info_present_bitfield = bitfield_temp;
-            memset(&info->talkers[unique_id], 0xFF, sizeof(avb_1722_1_acmp_fast_connect_talker_info));
+    debug_printf("\nWrote fast connect for %d\n", unique_id);
+}
 
-            fl_writeDataPage(0, (unsigned char *)avb_1722_1_buf);
+void acmp_listener_erase_fast_connect_info(int unique_id)
+{
+    if ((fast_connect_state.info_present_bitfield >> unique_id) & 1)
+    {
+        fast_connect_state.info_present_bitfield &= ~(1 << unique_id);
+        memset(&fast_connect_state.talkers[unique_id], 0xFF, sizeof(avb_1722_1_acmp_fast_connect_talker_info));
+        acmp_listener_save_fast_connect_info();
 
-            debug_printf("Erased fast connect for %d\n", unique_id);
-        }
+        debug_printf("Erased fast connect for %d\n", unique_id);
     }
 }
 
-static int acmp_listener_read_fast_connect_info(unsigned char buffer[256])
+int acmp_listener_fast_connect_pending(int unique_id)
+{
+    return ((fast_connect_state.info_present_bitfield >> unique_id) & 1) &&
+           !acmp_listener_streams[unique_id].connected;
+}
+
+static void acmp_listener_load_fast_connect_info(void)
 {
-    if (fl_readDataPage(0, buffer) == 0)
+    avb_1722_1_acmp_fast_connect_persist_state *info = (avb_1722_1_acmp_fast_connect_persist_state*) &avb_1722_1_buf[0];
+
+    memset(&fast_connect_state, 0, sizeof(fast_connect_state));
+    fast_connect_state.magic = AVB_1722_1_ACMP_FAST_CONNECT_MAGIC;
+    fast_connect_prearm_pending = 0;
+
+    if (fl_readDataPage(0, (unsigned char *)avb_1722_1_buf) != 0)
     {
-        return 0;
+        debug_printf("Couldn't read from data partition page 0\n");
+        return;
     }
-    else {
-        return 1;
+
+    if (info->magic != AVB_1722_1_ACMP_FAST_CONNECT_MAGIC)
+    {
+        debug_printf("no data in flash\n");
+        return;
     }
+
+    memcpy(&fast_connect_state, info, sizeof(fast_connect_state));
+    fast_connect_state.info_present_bitfield &= (1 << AVB_1722_1_MAX_LISTENERS) - 1;
+    fast_connect_prearm_pending = 1;
 }
 
-void acmp_start_fast_connect(CLIENT_INTERFACE(ethernet_tx_if, i_eth))
+void acmp_listener_prearm_fast_connect(CLIENT_INTERFACE(avb_interface, avb))
 {
-    unsigned char flash_buf[256];
+    if (!fast_connect_prearm_pending)
+        return;
+
+    fast_connect_prearm_pending = 0;
+
+    // Bring all of the recorded sinks up in one pass of the AVB manager
+    int in_transaction = avb_begin_stream_transaction(avb);
 
-    if (acmp_listener_read_fast_connect_info(flash_buf) == 0)
+    for (int i=0; i < AVB_1722_1_MAX_LISTENERS; i++)
     {
-        avb_1722_1_acmp_fast_connect_persist_state *info = (avb_1722_1_acmp_fast_connect_persist_state*) &flash_buf[0];
+        if ((fast_connect_state.info_present_bitfield >> i) & 1)
+        {
+            avb_1722_1_acmp_fast_connect_talker_info *record = &fast_connect_state.talkers[i];
 
-        if (flash_buf[3] == 0xFF) {
-            debug_printf("no data in flash\n");
-            return;
+            acmp_listener_prearm_sink(avb, i, record->stream_id, record->dest_mac, record->vlan_id,
+                                      record->format, record->rate, record->num_channels);
         }
+    }
+
+    if (in_transaction)
+        avb_commit_stream_transaction(avb);
+}
 
-        for (int i=0; i < AVB_1722_1_MAX_LISTENERS; i++)
+void acmp_start_fast_connect(CLIENT_INTERFACE(ethernet_tx_if, i_eth))
+{
+    for (int i=0; i < AVB_1722_1_MAX_LISTENERS; i++)
+    {
+        if (acmp_listener_fast_connect_pending(i))
         {
-            if ((info->info_present_bitfield >> i) & 1)
-            {
-                memcpy(&acmp_listener_rcvd_cmd_resp.controller_guid, &info->talkers[i].controller_guid, sizeof(guid_t));
-                memcpy(&acmp_listener_rcvd_cmd_resp.talker_guid, &info->talkers[i].talker_guid, sizeof(guid_t));
-                memcpy(&acmp_listener_rcvd_cmd_resp.listener_guid, &my_guid, sizeof(guid_t));
-                acmp_listener_rcvd_cmd_resp.talker_unique_id = info->talkers[i].talker_unique_id;
-                acmp_listener_rcvd_cmd_resp.listener_unique_id = i;
-                acmp_listener_rcvd_cmd_resp.flags = AVB_1722_1_ACMP_FLAGS_FAST_CONNECT;
-
-                debug_printf("Issuing fast connect for %d\n", i);
-                acmp_send_command(LISTENER, ACMP_CMD_CONNECT_TX_COMMAND, &acmp_listener_rcvd_cmd_resp, FALSE, -1, i_eth);
-            }
+            avb_1722_1_acmp_fast_connect_talker_info *record = &fast_connect_state.talkers[i];
+
+            memcpy(&acmp_listener_rcvd_cmd_resp.controller_guid, &record->controller_guid, sizeof(guid_t));
+            memcpy(&acmp_listener_rcvd_cmd_resp.talker_guid, &record->talker_guid, sizeof(guid_t));
+            memcpy(&acmp_listener_rcvd_cmd_resp.listener_guid, &my_guid, sizeof(guid_t));
+            acmp_listener_rcvd_cmd_resp.talker_unique_id = record->talker_unique_id;
+            acmp_listener_rcvd_cmd_resp.listener_unique_id = i;
+            acmp_listener_rcvd_cmd_resp.flags = AVB_1722_1_ACMP_FLAGS_FAST_CONNECT;
+
+            debug_printf("Issuing fast connect for %d\n", i);
+            acmp_send_command(LISTENER, ACMP_CMD_CONNECT_TX_COMMAND, &acmp_listener_rcvd_cmd_resp, FALSE, -1, i_eth);
         }
     }
 }
@@ -461,6 +697,7 @@ unsigned acmp_listener_valid_listener_unique(void)
 void acmp_zero_listener_stream_info(int unique_id)
 {
     memset(&acmp_listener_streams[unique_id], 0, sizeof(avb_1722_1_acmp_listener_stream_info));
+    avb_1722_1_aem_notify(AECP_AEM_CMD_GET_STREAM_INFO, AEM_STREAM_INPUT_TYPE, unique_id);
 }
 
 void acmp_add_listener_stream_info(void)
@@ -472,6 +709,7 @@ void acmp_add_listener_stream_info(void)
     acmp_listener_streams[unique_id].stream_id = acmp_listener_rcvd_cmd_resp.stream_id;
     acmp_listener_streams[unique_id].talker_guid = acmp_listener_rcvd_cmd_resp.talker_guid;
     acmp_listener_streams[unique_id].talker_unique_id = acmp_listener_rcvd_cmd_resp.talker_unique_id;
+    avb_1722_1_aem_notify(AECP_AEM_CMD_GET_STREAM_INFO, AEM_STREAM_INPUT_TYPE, unique_id);
 }
 
 avb_1722_1_acmp_status_t acmp_listener_get_state(void)
@@ -565,6 +803,7 @@ void acmp_add_talker_stream_info(void)
             acmp_talker_streams[unique_id].connected_listeners[i].guid.l = acmp_talker_rcvd_cmd_resp.listener_guid.l;
             acmp_talker_streams[unique_id].connected_listeners[i].unique_id = acmp_talker_rcvd_cmd_resp.listener_unique_id;
             acmp_talker_streams[unique_id].connection_count++;
+            avb_1722_1_aem_notify(AECP_AEM_CMD_GET_STREAM_INFO, AEM_STREAM_OUTPUT_TYPE, unique_id);
             break;
         }
     }
@@ -583,6 +822,7 @@ void acmp_remove_talker_stream_info(void)
             acmp_talker_streams[unique_id].connected_listeners[i].guid.l = 0;
             acmp_talker_streams[unique_id].connected_listeners[i].unique_id = 0;
             acmp_talker_streams[unique_id].connection_count--;
+            avb_1722_1_aem_notify(AECP_AEM_CMD_GET_STREAM_INFO, AEM_STREAM_OUTPUT_TYPE, unique_id);
 
 #ifdef AVB_1722_1_ENABLE_ASSERTIONS
             assert(acmp_talker_streams[unique_id].connection_count >= 0);
@@ -609,6 +849,7 @@ unsigned acmp_talker_valid_talker_unique(void)
 static void process_avb_1722_1_acmp_controller_packet(unsigned char message_type, avb_1722_1_acmp_packet_t* pkt)
 {
     int inflight_index = 0;
+    avb_1722_1_acmp_inflight_command *inflight;
 
     if (acmp_controller_state != ACMP_CONTROLLER_WAITING) return;
     if (compare_guid(pkt->controller_guid, &my_guid) == 0) return;
@@ -616,33 +857,13 @@ static void process_avb_1722_1_acmp_controller_packet(unsigned char message_type
     inflight_index = acmp_get_inflight_from_sequence_id(CONTROLLER, ntoh_16(pkt->sequence_id));
     if (inflight_index < 0) return; // We don't have an inflight entry for this command
 
-    if (message_type != (acmp_controller_inflight_commands[inflight_index].command.message_type + 1)) return;
+    inflight = &acmp_controller_inflight_commands[inflight_index];
+    if (inflight->responded || message_type != (inflight->command.message_type + 1)) return;
 
-    store_rcvd_cmd_resp(&acmp_controller_cmd_resp, pkt);
-
-    switch (message_type)
-    {
-        case ACMP_CMD_CONNECT_RX_RESPONSE:
-            acmp_controller_state = ACMP_CONTROLLER_CONNECT_RX_RESPONSE;
-            break;
-        case ACMP_CMD_DISCONNECT_RX_RESPONSE:
-            acmp_controller_state = ACMP_CONTROLLER_DISCONNECT_RX_RESPONSE;
-            break;
-        case ACMP_CMD_GET_TX_STATE_RESPONSE:
-            acmp_controller_state = ACMP_CONTROLLER_GET_RX_STATE_RESPONSE;
-            break;
-        case ACMP_CMD_GET_RX_STATE_RESPONSE:
-            acmp_controller_state = ACMP_CONTROLLER_GET_RX_STATE_RESPONSE;
-            break;
-        case ACMP_CMD_GET_TX_CONNECTION_RESPONSE:
-            acmp_controller_state = ACMP_CONTROLLER_GET_TX_CONNECTION_RESPONSE;
-            break;
-        default:
-        {
-            acmp_controller_state = ACMP_CONTROLLER_WAITING;
-            break;
-        }
-    }
+    // Responses wait in their inflight slots for the periodic to act on them,
+    // so any number can arrive between two periodic calls
+    store_rcvd_cmd_resp(&inflight->command, pkt);
+    inflight->responded = 1;
 }
 
 static void process_avb_1722_1_acmp_talker_packet(unsigned char message_type, avb_1722_1_acmp_packet_t* pkt)
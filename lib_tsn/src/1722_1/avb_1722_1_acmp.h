@@ -11,13 +11,7 @@
 
 enum acmp_controller_state_t {
         ACMP_CONTROLLER_IDLE,
-        ACMP_CONTROLLER_WAITING,
-        ACMP_CONTROLLER_TIMEOUT,
-        ACMP_CONTROLLER_CONNECT_RX_RESPONSE,
-        ACMP_CONTROLLER_DISCONNECT_RX_RESPONSE,
-        ACMP_CONTROLLER_GET_TX_STATE_RESPONSE,
-        ACMP_CONTROLLER_GET_RX_STATE_RESPONSE,
-        ACMP_CONTROLLER_GET_TX_CONNECTION_RESPONSE
+        ACMP_CONTROLLER_WAITING
 };
 
 enum acmp_talker_state_t {
@@ -56,6 +50,10 @@ void avb_1722_1_acmp_listener_periodic(client interface ethernet_tx_if i_eth, cl
  *  The Controller shall send a CONNECT_RX_COMMAND to the Listener Entity. The Listener Entity shall then send a
  *  CONNECT_TX_COMMAND to the Talker Entity.
  *
+ *  Commands to different Listener sinks are outstanding in parallel. When all
+ *  AVB_1722_1_ACMP_CONTROLLER_MAX_INFLIGHT slots are in use, or a command to
+ *  the same sink is still outstanding, the command is queued and sent later.
+ *
  *  \param talker_guid      the GUID of the Talker being targeted by the command
  *  \param listener_guid    the GUID of the Listener being targeted by the command
  *  \param talker_id        the unique id of the Talker stream source to connect.
@@ -76,6 +74,10 @@ void avb_1722_1_controller_connect(const_guid_ref_t talker_guid,
  *  The Controller shall send a DISCONNECT_RX_COMMAND to the Listener Entity. The Listener Entity shall then send a
  *  DISCONNECT_TX_COMMAND to the Talker Entity.
  *
+ *  Commands to different Listener sinks are outstanding in parallel. When all
+ *  AVB_1722_1_ACMP_CONTROLLER_MAX_INFLIGHT slots are in use, or a command to
+ *  the same sink is still outstanding, the command is queued and sent later.
+ *
  *  \param talker_guid      the GUID of the Talker being targeted by the command
  *  \param listener_guid    the GUID of the Listener being targeted by the command
  *  \param talker_id        the unique id of the Talker stream source to disconnect.
@@ -144,6 +146,9 @@ void acmp_progress_inflight_timer(int entity_type);
 
 int acmp_check_inflight_command_timeouts(int entity_type);
 
+/** Report when the ACMP state machines next need a periodic call */
+void avb_1722_1_acmp_report_deadline(void);
+
 void acmp_set_talker_response(void);
 
 unsigned acmp_listener_valid_listener_unique(void);
@@ -178,14 +183,37 @@ void acmp_set_inflight_retry(int entity_type, unsigned int message_type, int inf
 
 void acmp_add_inflight(int entity_type, unsigned int message_type, unsigned short original_sequence_id);
 
+/** Queue a controller command to be sent when an inflight slot is free and no
+ *  other command to the same listener sink is outstanding */
+void acmp_controller_queue_command(int message_type, const_guid_ref_t talker_guid, const_guid_ref_t listener_guid, int talker_id, int listener_id);
+
+/** Move the first queued controller command that can be sent now into
+ *  acmp_controller_cmd_resp. Returns 0 if there is none. */
+int acmp_controller_dequeue_command(void);
+
+void acmp_controller_release_inflight(int inflight_idx);
+
 void acmp_controller_connect_disconnect(int message_type, const_guid_ref_t talker_guid, const_guid_ref_t listener_guid, int talker_id, int listener_id, CLIENT_INTERFACE(ethernet_tx_if, i_eth));
 
+/** Pre-arm the listener sink of each fast connect record loaded at init with
+ *  its remembered stream, so that the listener data path, the stream MAC filter
+ *  and the SRP listener declaration are set up before the link is up and the
+ *  talker has answered. Does nothing after the first call. */
+void acmp_listener_prearm_fast_connect(CLIENT_INTERFACE(avb_interface, avb));
+
 void acmp_start_fast_connect(CLIENT_INTERFACE(ethernet_tx_if, i_eth));
 
+/** Returns 1 if a listener sink has a fast connect record and is not yet connected */
+int acmp_listener_fast_connect_pending(int unique_id);
+
+void acmp_listener_prearm_sink(CLIENT_INTERFACE(avb_interface, avb), int sink_num,
+                               unsigned int stream_id[2], unsigned char dest_mac[6], int vlan_id,
+                               int format, int rate, int num_channels);
+
 #ifdef __XC__
 extern "C" {
 #endif
-    void acmp_listener_store_fast_connect_info(int unique_id, guid_t *controller_guid, guid_t *talker_guid, unsigned short talker_unique_id);
+    void acmp_listener_store_fast_connect_info(int unique_id, int format, int rate, int num_channels);
     void acmp_listener_erase_fast_connect_info(int unique_id);
 #ifdef __XC__
 }
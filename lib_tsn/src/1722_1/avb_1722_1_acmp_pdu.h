@@ -70,10 +70,18 @@ typedef struct {
 	guid_t controller_guid;
 	guid_t talker_guid;
 	unsigned short talker_unique_id;
-	unsigned short padding;
+	unsigned short vlan_id;
+	unsigned int stream_id[2];
+	unsigned char dest_mac[6];
+	unsigned char format;
+	unsigned char num_channels;
+	int rate;
 } avb_1722_1_acmp_fast_connect_talker_info;
 
+#define AVB_1722_1_ACMP_FAST_CONNECT_MAGIC	(0x46434e32) // "FCN2"
+
 typedef struct {
+	unsigned int magic;
 	unsigned int info_present_bitfield;
 	avb_1722_1_acmp_fast_connect_talker_info talkers[AVB_1722_1_MAX_LISTENERS];
 } avb_1722_1_acmp_fast_connect_persist_state;
@@ -97,6 +105,7 @@ typedef struct {
 	int in_use;
 	unsigned int timeout;
 	unsigned int retried;
+	int responded;
 	avb_1722_1_acmp_cmd_resp command;
 	unsigned short original_sequence_id;
 } avb_1722_1_acmp_inflight_command;
@@ -12,6 +12,12 @@ void avb_1722_1_adp_init();
 
 void process_avb_1722_1_adp_packet(REFERENCE_PARAM(avb_1722_1_adp_packet_t, pkt), CLIENT_INTERFACE(ethernet_tx_if, i_eth));
 void avb_1722_1_adp_advertising_periodic(CLIENT_INTERFACE(ethernet_tx_if, i_eth), chanend ptp);
+
+/** Remove the entities whose advertisements have timed out from the database.
+ *  Runs whether or not the controller role is built, as the AECP notification
+ *  registrations of controllers that leave are dropped from here.
+ */
+void avb_1722_1_adp_entity_timeout_periodic(void);
 #ifdef __XC__
 void avb_1722_1_adp_discovery_periodic(client interface ethernet_tx_if i_eth, client interface avb_interface avb);
 #endif
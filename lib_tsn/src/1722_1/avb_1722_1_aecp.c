@@ -5,6 +5,7 @@
 #include "avb_1722_1_aecp.h"
 #include "avb_1722_1_adp.h"
 #include "misc_timer.h"
+#include "avb_control_deadline.h"
 #include "avb_srp_pdu.h"
 #include <string.h>
 #include <print.h>
@@ -18,6 +19,7 @@
 #include "avb_util.h"
 #include "ethernet_wrappers.h"
 #include "aem_descriptor_types.h"
+#include "gptp_config.h"
 #if AVB_1722_1_AEM_ENABLED
 #include "aem_descriptors.h"
 #endif
@@ -27,12 +29,39 @@ extern unsigned int avb_1722_1_buf[AVB_1722_1_PACKET_SIZE_WORDS];
 extern guid_t my_guid;
 extern unsigned char my_mac_addr[6];
 
-static unsigned char aecp_flash_page_buf[FLASH_PAGE_SIZE];
-static unsigned int aecp_aa_bytes_copied;
-static unsigned int aecp_aa_flash_write_addr;
-static unsigned int aecp_aa_next_write_address;
 static int operation_id = 1234;
 
+#define AECP_UPGRADE_WINDOW_PAGES (AVB_1722_1_FIRMWARE_UPGRADE_ENABLED ? AVB_1722_1_FIRMWARE_UPGRADE_WINDOW_PAGES : 1)
+#define AECP_UPGRADE_PAGE_WORDS (FLASH_PAGE_SIZE / 4)
+
+// Address Access writes of the upgrade image are staged here until the pages
+// before them have been programmed. Page n lives in slot n % window and has a
+// bit per byte received, as writes may be of any length.
+static unsigned int aecp_upgrade_window[AECP_UPGRADE_WINDOW_PAGES][AECP_UPGRADE_PAGE_WORDS];
+static unsigned int aecp_upgrade_received[AECP_UPGRADE_WINDOW_PAGES][(FLASH_PAGE_SIZE + 31) / 32];
+static unsigned int aecp_upgrade_next_page;
+static unsigned int aecp_upgrade_image_size;
+static unsigned int aecp_upgrade_crc;
+static fl_BootImageInfo aecp_upgrade_image;
+static int aecp_upgrade_replace;
+
+static enum {
+  AECP_UPGRADE_IDLE,
+  AECP_UPGRADE_ERASING,
+  AECP_UPGRADE_WRITING,
+  AECP_UPGRADE_FAILED
+} aecp_upgrade_state = AECP_UPGRADE_IDLE;
+
+// The START_OPERATION command, kept to address the OPERATION_STATUS sent when
+// the erase completes
+static unsigned int aecp_upgrade_operation_cmd[(AVB_1722_1_AECP_PAYLOAD_OFFSET + 2 + sizeof(avb_1722_1_aem_start_operation_t) + 3) / 4];
+static unsigned char aecp_upgrade_operation_addr[6];
+// A STORE received during the erase, answered IN_PROGRESS and completed once
+// the erase has finished
+static unsigned int aecp_upgrade_store_cmd[(AVB_1722_1_AECP_PAYLOAD_OFFSET + 2 + sizeof(avb_1722_1_aem_start_operation_t) + 3) / 4];
+static unsigned char aecp_upgrade_store_addr[6];
+static int aecp_upgrade_store_pending;
+
 static avb_timer aecp_aem_lock_timer;
 
 static enum {
@@ -61,6 +90,36 @@ static unsigned short pending_controller_sequence;
 static unsigned char pending_persistent;
 static unsigned short aecp_controller_available_sequence = -1;
 
+#if AVB_1722_1_AECP_UNSOLICITED_MAX_CONTROLLERS
+typedef struct aecp_unsolicited_controller_t {
+  int valid;
+  guid_t guid;
+  unsigned char mac[6];
+  unsigned short sequence_id;
+} aecp_unsolicited_controller_t;
+
+// A state change waiting to be sent as an unsolicited GET response
+typedef struct aecp_unsolicited_notification_t {
+  unsigned short command_type;
+  unsigned short descriptor_type;
+  unsigned short descriptor_id;
+  signed char exclude;      // Controller that already has the change in its own response, or -1
+  unsigned char if_changed; // Only sent if the response differs from the last one sent
+} aecp_unsolicited_notification_t;
+
+static aecp_unsolicited_controller_t aecp_unsolicited_controllers[AVB_1722_1_AECP_UNSOLICITED_MAX_CONTROLLERS];
+static aecp_unsolicited_notification_t aecp_unsolicited_queue[AVB_1722_1_AECP_UNSOLICITED_QUEUE_SIZE];
+static int aecp_unsolicited_queue_len = 0;
+static avb_timer aecp_unsolicited_timer;
+static avb_timer aecp_unsolicited_counters_timer;
+// The counters polled for notifications are those that count events rather
+// than traffic: the clock domains', then the AVB interfaces'
+#define AECP_UNSOLICITED_COUNTERS_SLOTS (AVB_NUM_MEDIA_CLOCKS + PTP_NUM_PORTS)
+static unsigned int aecp_unsolicited_counters_sum[AECP_UNSOLICITED_COUNTERS_SLOTS];
+// Command that the notifications are rendered from, as if a controller had sent it
+static unsigned int aecp_unsolicited_cmd_buf[(sizeof(avb_1722_1_aecp_packet_t)+3)>>2];
+#endif
+
 
 static enum {
     AECP_AEM_IDLE,
@@ -69,6 +128,34 @@ static enum {
     AECP_AEM_LOCK_TIMEOUT
 } aecp_aem_state = AECP_AEM_IDLE;
 
+#if AVB_1722_1_AEM_ENABLED
+#define AEM_NUM_DESCRIPTOR_TYPES (AEM_CONTROL_BLOCK_TYPE + 1)
+
+// Where each descriptor type's size/pointer pairs start in aem_descriptor_list
+static struct {
+  unsigned short offset;
+  unsigned short count;
+} aem_descriptor_dir[AEM_NUM_DESCRIPTOR_TYPES];
+
+#if AVB_1722_1_AEM_DESCRIPTOR_CACHE_ENTRIES
+typedef struct aem_descriptor_cache_entry_t {
+  int valid;
+  unsigned short type;
+  unsigned short id;
+  unsigned int size;
+  unsigned int expiry_time;
+  unsigned int data[AVB_1722_1_AEM_DESCRIPTOR_CACHE_ENTRY_SIZE/4];
+} aem_descriptor_cache_entry_t;
+
+static aem_descriptor_cache_entry_t aem_descriptor_cache[AVB_1722_1_AEM_DESCRIPTOR_CACHE_ENTRIES];
+static unsigned aem_descriptor_cache_victim = 0;
+
+#ifndef timeafter
+#define timeafter(A, B) ((int)((B) - (A)) < 0)
+#endif
+#endif
+#endif
+
 // Called on startup to initialise certain static descriptor fields
 void avb_1722_1_aem_descriptors_init(unsigned int serial_num)
 {
@@ -114,11 +201,73 @@ void avb_1722_1_aem_descriptors_init(unsigned int serial_num)
 #endif
 }
 
+#if AVB_1722_1_AEM_ENABLED
+static void aem_descriptor_dir_init(void)
+{
+  const int list_len = sizeof(aem_descriptor_list)>>2;
+
+  memset(aem_descriptor_dir, 0, sizeof(aem_descriptor_dir));
+
+  for (int i=0; i < list_len; i += (aem_descriptor_list[i+1]*2)+2)
+  {
+    unsigned int type = aem_descriptor_list[i];
+
+    if (type < AEM_NUM_DESCRIPTOR_TYPES)
+    {
+      aem_descriptor_dir[type].offset = i+2;
+      aem_descriptor_dir[type].count = aem_descriptor_list[i+1];
+    }
+  }
+}
+
+static unsigned char *aem_descriptor_dir_find(unsigned int type, unsigned int id, int *desc_size_bytes)
+{
+  if (type >= AEM_NUM_DESCRIPTOR_TYPES) return NULL;
+
+  int offset = aem_descriptor_dir[type].offset;
+  int count = aem_descriptor_dir[type].count;
+
+  for (int n=0; n < count; n++)
+  {
+    // Descriptors are normally listed in index order, so start at the index
+    int j = (id + n) % count;
+    unsigned char *descriptor = (unsigned char *)aem_descriptor_list[offset+(j*2)+1];
+
+    if (( ((unsigned)descriptor[2] << 8) | ((unsigned)descriptor[3]) ) == id)
+    {
+      *desc_size_bytes = aem_descriptor_list[offset+(j*2)];
+      return descriptor;
+    }
+  }
+  return NULL;
+}
+#endif
+
+void avb_1722_1_aem_descriptors_changed(void)
+{
+#if AVB_1722_1_AEM_ENABLED && AVB_1722_1_AEM_DESCRIPTOR_CACHE_ENTRIES
+  for (int i=0; i < AVB_1722_1_AEM_DESCRIPTOR_CACHE_ENTRIES; i++)
+  {
+    aem_descriptor_cache[i].valid = 0;
+  }
+#endif
+}
+
 void avb_1722_1_aecp_aem_init(unsigned int serial_num)
 {
   avb_1722_1_aem_descriptors_init(serial_num);
+#if AVB_1722_1_AEM_ENABLED
+  aem_descriptor_dir_init();
+#endif
+  avb_1722_1_aem_descriptors_changed();
   init_avb_timer(&aecp_aem_lock_timer, 100);
   init_avb_timer(&aecp_aem_controller_available_timer, 5);
+#if AVB_1722_1_AECP_UNSOLICITED_MAX_CONTROLLERS
+  memset(aecp_unsolicited_controllers, 0, sizeof(aecp_unsolicited_controllers));
+  aecp_unsolicited_queue_len = 0;
+  init_avb_timer(&aecp_unsolicited_timer, 1);
+  init_avb_timer(&aecp_unsolicited_counters_timer, 1);
+#endif
 
   aecp_aem_state = AECP_AEM_WAITING;
 }
@@ -173,6 +322,91 @@ static void generate_object_name(char *object_name, int base, int n) {
   strcat(object_name, num_string);
 }
 
+#if AVB_1722_1_AEM_ENABLED && AVB_1722_1_AEM_DESCRIPTOR_CACHE_ENTRIES
+// Descriptors with fields that set_current_fields_in_descriptor() reads from
+// the AVB manager or the application
+static int aem_descriptor_has_current_fields(unsigned int type)
+{
+  switch (type)
+  {
+    case AEM_AUDIO_UNIT_TYPE:
+    case AEM_CLOCK_DOMAIN_TYPE:
+    case AEM_STREAM_INPUT_TYPE:
+    case AEM_STREAM_OUTPUT_TYPE:
+    case AEM_CONTROL_TYPE:
+    case AEM_SIGNAL_SELECTOR_TYPE:
+      return 1;
+    default:
+      return 0;
+  }
+}
+
+static void aem_descriptor_cache_store(unsigned int type, unsigned int id, unsigned char *descriptor, int desc_size_bytes)
+{
+  aem_descriptor_cache_entry_t *entry = &aem_descriptor_cache[aem_descriptor_cache_victim];
+
+  if (desc_size_bytes > AVB_1722_1_AEM_DESCRIPTOR_CACHE_ENTRY_SIZE) return;
+
+  entry->valid = 1;
+  entry->type = type;
+  entry->id = id;
+  entry->size = desc_size_bytes;
+  entry->expiry_time = get_local_time() + AVB_1722_1_AEM_DESCRIPTOR_CACHE_LIFETIME_CENTISECONDS * XS1_TIMER_KHZ * 10;
+  memcpy(entry->data, descriptor, desc_size_bytes);
+
+  aem_descriptor_cache_victim = (aem_descriptor_cache_victim + 1) % AVB_1722_1_AEM_DESCRIPTOR_CACHE_ENTRIES;
+}
+
+/* Descriptors with current fields are dropped from the periodic once their
+ * lifetime is up, so that an entry never stays long enough for the timer
+ * comparison to wrap round and make it look fresh again
+ */
+static void aem_descriptor_cache_expire(void)
+{
+  unsigned int now = get_local_time();
+
+  for (int i=0; i < AVB_1722_1_AEM_DESCRIPTOR_CACHE_ENTRIES; i++)
+  {
+    aem_descriptor_cache_entry_t *entry = &aem_descriptor_cache[i];
+
+    if (entry->valid && aem_descriptor_has_current_fields(entry->type) &&
+        timeafter(now, entry->expiry_time))
+    {
+      entry->valid = 0;
+    }
+  }
+}
+
+static int create_aem_read_descriptor_response_from_cache(unsigned int read_type,
+                                                          unsigned int read_id,
+                                                          unsigned char src_addr[6],
+                                                          avb_1722_1_aecp_packet_t *pkt)
+{
+  for (int i=0; i < AVB_1722_1_AEM_DESCRIPTOR_CACHE_ENTRIES; i++)
+  {
+    aem_descriptor_cache_entry_t *entry = &aem_descriptor_cache[i];
+
+    if (!entry->valid || entry->type != read_type || entry->id != read_id) continue;
+
+    if (aem_descriptor_has_current_fields(read_type) &&
+        timeafter(get_local_time(), entry->expiry_time))
+    {
+      entry->valid = 0;
+      return 0;
+    }
+
+    int packet_size = sizeof(ethernet_hdr_t)+sizeof(avb_1722_1_packet_header_t)+24+entry->size;
+
+    avb_1722_1_aecp_aem_msg_t *aem = (avb_1722_1_aecp_aem_msg_t*)avb_1722_1_create_aecp_response_header(src_addr, AECP_AEM_STATUS_SUCCESS, AECP_CMD_AEM_COMMAND, entry->size+16, pkt);
+
+    memcpy(aem, pkt->data.payload, 6);
+    memcpy(&(aem->command.read_descriptor_resp.descriptor), entry->data, entry->size);
+    return packet_size;
+  }
+  return 0;
+}
+#endif
+
 static int create_aem_read_descriptor_response(unsigned int read_type,
                                                unsigned int read_id,
                                                unsigned char src_addr[6],
@@ -181,7 +415,7 @@ static int create_aem_read_descriptor_response(unsigned int read_type,
                                                CLIENT_INTERFACE(avb_1722_1_control_callbacks, i_1722_1_entity))
 {
 #if AVB_1722_1_AEM_ENABLED
-  int desc_size_bytes = 0, i = 0;
+  int desc_size_bytes = 0;
   unsigned char *descriptor = NULL;
   int found_descriptor = 0;
 
@@ -310,30 +544,8 @@ static int create_aem_read_descriptor_response(unsigned int read_type,
   else
 #endif
   {
-    /* Search for the descriptor */
-    while (aem_descriptor_list[i] <= read_type)
-    {
-      int num_descriptors = aem_descriptor_list[i+1];
-
-      if (aem_descriptor_list[i] == read_type)
-      {
-        for (int j=0, k=2; j < num_descriptors; j++, k += 2)
-        {
-          desc_size_bytes = aem_descriptor_list[i+k];
-          descriptor = (unsigned char *)aem_descriptor_list[i+k+1];
-
-          if (( ((unsigned)descriptor[2] << 8) | ((unsigned)descriptor[3]) ) == read_id)
-          {
-            found_descriptor = 1;
-            break;
-          }
-        }
-
-      }
-
-      i += ((num_descriptors*2)+2);
-      if (i >= (sizeof(aem_descriptor_list)>>2)) break;
-    }
+    descriptor = aem_descriptor_dir_find(read_type, read_id, &desc_size_bytes);
+    found_descriptor = (descriptor != NULL);
   }
 
 
@@ -346,6 +558,9 @@ static int create_aem_read_descriptor_response(unsigned int read_type,
     memcpy(aem, pkt->data.payload, 6);
     if (found_descriptor < 2) memcpy(&(aem->command.read_descriptor_resp.descriptor), descriptor, desc_size_bytes+40);
     set_current_fields_in_descriptor(aem->command.read_descriptor_resp.descriptor, desc_size_bytes, read_type, read_id, i_avb_api, i_1722_1_entity);
+#if AVB_1722_1_AEM_DESCRIPTOR_CACHE_ENTRIES
+    aem_descriptor_cache_store(read_type, read_id, aem->command.read_descriptor_resp.descriptor, desc_size_bytes);
+#endif
     return packet_size;
   }
   else // Descriptor not found, send NO_SUCH_DESCRIPTOR reply
@@ -526,6 +741,282 @@ static unsigned short process_aem_cmd_acquire(avb_1722_1_aecp_packet_t *pkt, uns
   return GET_1722_1_DATALENGTH(&pkt->header) - AVB_1722_1_AECP_COMMAND_DATA_OFFSET;
 }
 
+static unsigned int aecp_upgrade_crc32(unsigned int crc, unsigned char *data, int len)
+{
+  for (int i=0; i < len; i++)
+  {
+    crc ^= data[i];
+    for (int j=0; j < 8; j++)
+      crc = (crc >> 1) ^ (0xedb88320 & -(crc & 1));
+  }
+  return crc;
+}
+
+static void aecp_upgrade_reset(void)
+{
+  memset(aecp_upgrade_window, 0xff, sizeof(aecp_upgrade_window));
+  memset(aecp_upgrade_received, 0, sizeof(aecp_upgrade_received));
+  aecp_upgrade_next_page = 0;
+  aecp_upgrade_image_size = 0;
+  aecp_upgrade_crc = 0xffffffff;
+  aecp_upgrade_state = AECP_UPGRADE_IDLE;
+  aecp_upgrade_store_pending = 0;
+}
+
+// Erases the next part of the image area. Returns non-zero while the erase
+// is still in progress.
+static int aecp_upgrade_erase_step(void)
+{
+  int result;
+
+  if (aecp_upgrade_replace) {
+    result = fl_startImageReplace(&aecp_upgrade_image, FLASH_MAX_UPGRADE_IMAGE_SIZE);
+  }
+  else {
+    result = fl_startImageAdd(&aecp_upgrade_image, FLASH_MAX_UPGRADE_IMAGE_SIZE, 0);
+  }
+
+  if (result < 0) {
+    debug_printf("Failed to start image upgrade\n");
+    aecp_upgrade_state = AECP_UPGRADE_FAILED;
+  }
+  else if (result == 0) {
+    begin_write_upgrade_image();
+    aecp_upgrade_state = AECP_UPGRADE_WRITING;
+  }
+  return result > 0;
+}
+
+// A page is complete once all its bytes have been received or, when the
+// transfer is finishing, all its bytes below the end of the image
+static int aecp_upgrade_page_complete(unsigned int page, int finishing)
+{
+  unsigned int *received = aecp_upgrade_received[page % AECP_UPGRADE_WINDOW_PAGES];
+  unsigned int page_addr = page * FLASH_PAGE_SIZE;
+  unsigned int num_bytes = FLASH_PAGE_SIZE;
+
+  if (page_addr >= aecp_upgrade_image_size) return 0;
+
+  if (finishing && aecp_upgrade_image_size - page_addr < FLASH_PAGE_SIZE) {
+    num_bytes = aecp_upgrade_image_size - page_addr;
+  }
+
+  for (int i=0; i < (num_bytes >> 5); i++)
+  {
+    if (received[i] != 0xffffffff) return 0;
+  }
+  if (num_bytes & 31) {
+    unsigned int mask = (1 << (num_bytes & 31)) - 1;
+    if ((received[num_bytes >> 5] & mask) != mask) return 0;
+  }
+  return 1;
+}
+
+// Programs the next page if it is complete. Returns non-zero if a page was
+// programmed.
+static int aecp_upgrade_program_page(int finishing)
+{
+  unsigned int slot = aecp_upgrade_next_page % AECP_UPGRADE_WINDOW_PAGES;
+  unsigned char *data = (unsigned char *)aecp_upgrade_window[slot];
+  unsigned short status;
+
+  if (aecp_upgrade_state != AECP_UPGRADE_WRITING ||
+      !aecp_upgrade_page_complete(aecp_upgrade_next_page, finishing)) {
+    return 0;
+  }
+
+  if (avb_write_upgrade_image_page(aecp_upgrade_next_page * FLASH_PAGE_SIZE, data, &status)) {
+    aecp_upgrade_state = AECP_UPGRADE_FAILED;
+    return 0;
+  }
+
+  aecp_upgrade_crc = aecp_upgrade_crc32(aecp_upgrade_crc, data, FLASH_PAGE_SIZE);
+  memset(data, 0xff, FLASH_PAGE_SIZE);
+  memset(aecp_upgrade_received[slot], 0, sizeof(aecp_upgrade_received[slot]));
+  aecp_upgrade_next_page++;
+  return 1;
+}
+
+// Stages the data of one Address Access write TLV
+static unsigned short aecp_upgrade_stage(unsigned int address, unsigned char *data, unsigned int length)
+{
+  unsigned int end = address + length;
+
+  if (aecp_upgrade_state != AECP_UPGRADE_ERASING && aecp_upgrade_state != AECP_UPGRADE_WRITING) {
+    return AECP_AA_STATUS_ADDRESS_INVALID;
+  }
+  if (end > FLASH_MAX_UPGRADE_IMAGE_SIZE) {
+    return AECP_AA_STATUS_ADDRESS_TOO_HIGH;
+  }
+
+  // A controller running ahead of the window waits for the erase to finish
+  // and the pages before it to be programmed. If the erase is still running or
+  // one of the pages is still missing it has to retry the write.
+  while (end > (aecp_upgrade_next_page + AECP_UPGRADE_WINDOW_PAGES) * FLASH_PAGE_SIZE)
+  {
+    if (!aecp_upgrade_program_page(0)) {
+      return AECP_AA_STATUS_ADDRESS_TOO_HIGH;
+    }
+  }
+
+  for (unsigned int pos = address; pos < end;)
+  {
+    unsigned int page = pos / FLASH_PAGE_SIZE;
+    unsigned int offset = pos % FLASH_PAGE_SIZE;
+    unsigned int slot = page % AECP_UPGRADE_WINDOW_PAGES;
+    unsigned int n = (end - pos < FLASH_PAGE_SIZE - offset) ? end - pos : FLASH_PAGE_SIZE - offset;
+
+    // Repeats of writes whose responses were lost may cover programmed pages
+    if (page >= aecp_upgrade_next_page) {
+      memcpy((unsigned char *)aecp_upgrade_window[slot] + offset, &data[pos - address], n);
+      for (unsigned int b = offset; b < offset + n; b++)
+      {
+        aecp_upgrade_received[slot][b >> 5] |= 1 << (b & 31);
+      }
+    }
+    pos += n;
+  }
+
+  if (end > aecp_upgrade_image_size) {
+    aecp_upgrade_image_size = end;
+  }
+  return AECP_AA_STATUS_SUCCESS;
+}
+
+// Programs the rest of the image and checks it, as read back from flash,
+// against the CRC of the data that was written. Must not be called during the
+// erase. Returns non-zero on failure.
+static int aecp_upgrade_finish(void)
+{
+  fl_BootImageInfo image;
+  unsigned char *page = (unsigned char *)aecp_upgrade_window[0];
+  unsigned int crc = 0xffffffff;
+
+  while (aecp_upgrade_program_page(1));
+
+  if (aecp_upgrade_state != AECP_UPGRADE_WRITING ||
+      aecp_upgrade_next_page * FLASH_PAGE_SIZE < aecp_upgrade_image_size) {
+    debug_printf("Upgrade image incomplete\n");
+    abort_write_upgrade_image();
+    aecp_upgrade_reset();
+    return 1;
+  }
+
+  abort_write_upgrade_image();
+
+  if (fl_writeImageEnd() != 0 ||
+      fl_getFactoryImage(&image) != 0 ||
+      fl_getNextBootImage(&image) != 0 ||
+      fl_startImageRead(&image) != 0) {
+    debug_printf("Upgrade image not found\n");
+    aecp_upgrade_reset();
+    return 1;
+  }
+
+  for (int i=0; i < aecp_upgrade_next_page; i++)
+  {
+    if (fl_readImagePage(page) != 0) break;
+    crc = aecp_upgrade_crc32(crc, page, FLASH_PAGE_SIZE);
+  }
+
+  if (crc != aecp_upgrade_crc) {
+    debug_printf("Upgrade image CRC mismatch\n");
+    aecp_upgrade_reset();
+    return 1;
+  }
+
+  aecp_upgrade_reset();
+  return 0;
+}
+
+static void aecp_upgrade_send_operation_status(unsigned char status, CLIENT_INTERFACE(ethernet_tx_if, i_eth))
+{
+  avb_1722_1_aecp_packet_t *pkt = (avb_1722_1_aecp_packet_t *)aecp_upgrade_operation_cmd;
+  avb_1722_1_aecp_aem_msg_t *aem_msg = &(pkt->data.aem);
+  avb_1722_1_aem_operation_status_t *resp = (avb_1722_1_aem_operation_status_t *)(aem_msg->command.payload);
+  int num_tx_bytes = sizeof(avb_1722_1_aem_operation_status_t) + AVB_1722_1_AECP_PAYLOAD_OFFSET;
+
+  if (num_tx_bytes < 64) num_tx_bytes = 64;
+
+  AEM_MSG_SET_U_FLAG(aem_msg, 1);
+  AEM_MSG_SET_COMMAND_TYPE(aem_msg, AECP_AEM_CMD_OPERATION_STATUS);
+  hton_16(resp->percent_complete, status == AECP_AEM_STATUS_SUCCESS ? 1000 : 0);
+
+  avb_1722_1_create_aecp_aem_response(aecp_upgrade_operation_addr, status, sizeof(avb_1722_1_aem_operation_status_t), pkt);
+  eth_send_packet(i_eth, (char *)avb_1722_1_buf, num_tx_bytes, ETHERNET_ALL_INTERFACES);
+}
+
+// Sends the response to a successful STORE or STORE_AND_REBOOT and the
+// OPERATION_STATUS that completes it
+static void aecp_upgrade_send_store_responses(avb_1722_1_aecp_packet_t *pkt, unsigned char src_addr[6], CLIENT_INTERFACE(ethernet_tx_if, i_eth))
+{
+  avb_1722_1_aecp_aem_msg_t *aem_msg = &(pkt->data.aem);
+  avb_1722_1_aem_operation_status_t *resp = (avb_1722_1_aem_operation_status_t *)(aem_msg->command.payload);
+  int num_tx_bytes = sizeof(avb_1722_1_aem_start_operation_t) + AVB_1722_1_AECP_PAYLOAD_OFFSET;
+
+  if (num_tx_bytes < 64) num_tx_bytes = 64;
+
+  avb_1722_1_create_aecp_aem_response(src_addr, AECP_AEM_STATUS_SUCCESS, GET_1722_1_DATALENGTH(&pkt->header), pkt);
+  eth_send_packet(i_eth, (char *)avb_1722_1_buf, num_tx_bytes, ETHERNET_ALL_INTERFACES);
+
+  AEM_MSG_SET_U_FLAG(aem_msg, 1);
+  AEM_MSG_SET_COMMAND_TYPE(aem_msg, AECP_AEM_CMD_OPERATION_STATUS);
+
+  hton_16(resp->percent_complete, 1000);
+  avb_1722_1_create_aecp_aem_response(src_addr, AECP_AEM_STATUS_SUCCESS, GET_1722_1_DATALENGTH(&pkt->header), pkt);
+  eth_send_packet(i_eth, (char *)avb_1722_1_buf, num_tx_bytes, ETHERNET_ALL_INTERFACES);
+}
+
+// Completes a STORE that was answered IN_PROGRESS because the erase was running
+static void aecp_upgrade_complete_store(CLIENT_INTERFACE(ethernet_tx_if, i_eth))
+{
+  avb_1722_1_aecp_packet_t *pkt = (avb_1722_1_aecp_packet_t *)aecp_upgrade_store_cmd;
+  avb_1722_1_aem_start_operation_t *cmd = (avb_1722_1_aem_start_operation_t *)(pkt->data.aem.command.payload);
+  unsigned char src_addr[6];
+
+  memcpy(src_addr, aecp_upgrade_store_addr, 6);
+  aecp_upgrade_store_pending = 0;
+
+  if (aecp_upgrade_finish()) {
+    int num_tx_bytes = sizeof(avb_1722_1_aem_start_operation_t) + AVB_1722_1_AECP_PAYLOAD_OFFSET;
+    if (num_tx_bytes < 64) num_tx_bytes = 64;
+    avb_1722_1_create_aecp_aem_response(src_addr, AECP_AEM_STATUS_ENTITY_MISBEHAVING, GET_1722_1_DATALENGTH(&pkt->header), pkt);
+    eth_send_packet(i_eth, (char *)avb_1722_1_buf, num_tx_bytes, ETHERNET_ALL_INTERFACES);
+    return;
+  }
+
+  aecp_upgrade_send_store_responses(pkt, src_addr, i_eth);
+
+  if (ntoh_16(cmd->operation_type) == AEM_MEMORY_OBJECT_OPERATION_STORE_AND_REBOOT) {
+    avb_1722_1_adp_depart_immediately(i_eth);
+    waitfor(10000); // Wait for the response packets to egress
+    device_reboot();
+  }
+}
+
+// The erase and the programming of staged pages run here, a step per call,
+// so that the transfer of the image overlaps them
+static void aecp_upgrade_periodic(CLIENT_INTERFACE(ethernet_tx_if, i_eth))
+{
+  if (aecp_upgrade_state == AECP_UPGRADE_ERASING) {
+    if (!aecp_upgrade_erase_step()) {
+      aecp_upgrade_send_operation_status(aecp_upgrade_state == AECP_UPGRADE_WRITING ?
+                                         AECP_AEM_STATUS_SUCCESS : AECP_AEM_STATUS_ENTITY_MISBEHAVING, i_eth);
+      if (aecp_upgrade_store_pending) {
+        aecp_upgrade_complete_store(i_eth);
+      }
+    }
+  }
+  else {
+    aecp_upgrade_program_page(0);
+  }
+
+  if (aecp_upgrade_state == AECP_UPGRADE_ERASING ||
+      (aecp_upgrade_state == AECP_UPGRADE_WRITING && aecp_upgrade_page_complete(aecp_upgrade_next_page, 0))) {
+    avb_control_deadline_now(AVB_CONTROL_AECP);
+  }
+}
+
 static int process_aem_cmd_start_abort_operation(avb_1722_1_aecp_packet_t *pkt,
                                                 unsigned char src_addr[6],
                                                 unsigned char *status,
@@ -542,76 +1033,54 @@ static int process_aem_cmd_start_abort_operation(avb_1722_1_aecp_packet_t *pkt,
       desc_type == AEM_MEMORY_OBJECT_TYPE &&
       desc_id == 0) // descriptor ID of the AEM_MEMORY_OBJECT_TYPE descriptor
   {
-    int num_tx_bytes = sizeof(avb_1722_1_aem_start_operation_t) + AVB_1722_1_AECP_PAYLOAD_OFFSET;
-    if (num_tx_bytes < 64) num_tx_bytes = 64;
     switch (operation_type)
     {
       case AEM_MEMORY_OBJECT_OPERATION_UPLOAD:
       case AEM_MEMORY_OBJECT_OPERATION_ERASE:
       {
-        fl_BootImageInfo image;
-        int flashstatus = fl_getFactoryImage(&image);
-
-        if (flashstatus != 0) {
+        if (fl_getFactoryImage(&aecp_upgrade_image) != 0) {
           debug_printf("No factory image!\n");
           *status = AECP_AEM_STATUS_ENTITY_MISBEHAVING;
-          return 0;
-        } else {
-          flashstatus = fl_getNextBootImage(&image);
-          if (flashstatus != 0) {
-            // No upgrade image exists in flash
-            debug_printf("No upgrade\n");
-          }
-
-          int result;
-          int t = get_local_time();
-          const unsigned in_progress_msg_interval_ms = 120 * XS1_TIMER_KHZ;
-          do
-          {
-            if (flashstatus != 0) {
-              result = fl_startImageAdd(&image, FLASH_MAX_UPGRADE_IMAGE_SIZE, 0);
-            }
-            else {
-              result = fl_startImageReplace(&image, FLASH_MAX_UPGRADE_IMAGE_SIZE);
-            }
-            if ((result > 0) && (get_local_time() - t >= in_progress_msg_interval_ms)) {
-              t = get_local_time();
-              avb_1722_1_create_aecp_aem_response(src_addr, AECP_AEM_STATUS_IN_PROGRESS, GET_1722_1_DATALENGTH(&pkt->header), pkt);
-              eth_send_packet(i_eth, (char *)avb_1722_1_buf, num_tx_bytes, ETHERNET_ALL_INTERFACES);
-            }
-          } while (result > 0);
+          break;
+        }
 
-          if (result < 0) {
-            debug_printf("Failed to start image upgrade\n");
-            *status = AECP_AEM_STATUS_ENTITY_MISBEHAVING;
-          }
-          else {
-            begin_write_upgrade_image();
-          }
+        aecp_upgrade_replace = (fl_getNextBootImage(&aecp_upgrade_image) == 0);
+        if (!aecp_upgrade_replace) {
+          // No upgrade image exists in flash
+          debug_printf("No upgrade\n");
         }
 
-        avb_1722_1_create_aecp_aem_response(src_addr, *status, GET_1722_1_DATALENGTH(&pkt->header), pkt);
-        eth_send_packet(i_eth, (char *)avb_1722_1_buf, num_tx_bytes, ETHERNET_ALL_INTERFACES);
+        // The erase continues in the background while the image is transferred
+        // and completes with an OPERATION_STATUS
+        abort_write_upgrade_image();
+        aecp_upgrade_reset();
+        aecp_upgrade_state = AECP_UPGRADE_ERASING;
 
-        return 0;
+        hton_16(cmd->operation_id, operation_id++);
+        memcpy(aecp_upgrade_operation_cmd, pkt, sizeof(aecp_upgrade_operation_cmd));
+        memcpy(aecp_upgrade_operation_addr, src_addr, 6);
         break;
       }
       case AEM_MEMORY_OBJECT_OPERATION_STORE:
       case AEM_MEMORY_OBJECT_OPERATION_STORE_AND_REBOOT:
       {
-        hton_16(cmd->operation_id, operation_id++);
-
-        avb_1722_1_create_aecp_aem_response(src_addr, AECP_AEM_STATUS_SUCCESS, GET_1722_1_DATALENGTH(&pkt->header), pkt);
-        eth_send_packet(i_eth, (char *)avb_1722_1_buf, num_tx_bytes, ETHERNET_ALL_INTERFACES);
+        if (aecp_upgrade_state == AECP_UPGRADE_ERASING) {
+          // Answered again from aecp_upgrade_periodic() once the erase is done
+          hton_16(cmd->operation_id, operation_id++);
+          memcpy(aecp_upgrade_store_cmd, pkt, sizeof(aecp_upgrade_store_cmd));
+          memcpy(aecp_upgrade_store_addr, src_addr, 6);
+          aecp_upgrade_store_pending = 1;
+          *status = AECP_AEM_STATUS_IN_PROGRESS;
+          break;
+        }
 
-        avb_1722_1_aecp_aem_msg_t *aem_msg = &(pkt->data.aem);
-        AEM_MSG_SET_U_FLAG(aem_msg, 1);
-        AEM_MSG_SET_COMMAND_TYPE(aem_msg, AECP_AEM_CMD_OPERATION_STATUS);
-        avb_1722_1_aem_operation_status_t *resp = (avb_1722_1_aem_operation_status_t *)(pkt->data.aem.command.payload);
+        if (aecp_upgrade_state != AECP_UPGRADE_IDLE && aecp_upgrade_finish()) {
+          *status = AECP_AEM_STATUS_ENTITY_MISBEHAVING;
+          break;
+        }
 
-        hton_16(resp->percent_complete, 1000);
-        avb_1722_1_create_aecp_aem_response(src_addr, AECP_AEM_STATUS_SUCCESS, GET_1722_1_DATALENGTH(&pkt->header), pkt);
-        eth_send_packet(i_eth, (char *)avb_1722_1_buf, num_tx_bytes, ETHERNET_ALL_INTERFACES);
+        hton_16(cmd->operation_id, operation_id++);
+        aecp_upgrade_send_store_responses(pkt, src_addr, i_eth);
 
         if (operation_type == AEM_MEMORY_OBJECT_OPERATION_STORE_AND_REBOOT) {
           *reboot = 1;
@@ -628,9 +1097,8 @@ static int process_aem_cmd_start_abort_operation(avb_1722_1_aecp_packet_t *pkt,
   }
   else if (command_type == AECP_AEM_CMD_ABORT_OPERATION)
   {
-    aecp_aa_bytes_copied = 0;
-    aecp_aa_flash_write_addr = 0;
-    aecp_aa_next_write_address = 0;
+    abort_write_upgrade_image();
+    aecp_upgrade_reset();
   }
   else
   {
@@ -639,13 +1107,357 @@ static int process_aem_cmd_start_abort_operation(avb_1722_1_aecp_packet_t *pkt,
   return GET_1722_1_DATALENGTH(&pkt->header) - AVB_1722_1_AECP_COMMAND_DATA_OFFSET;
 }
 
+#if AVB_1722_1_AECP_UNSOLICITED_MAX_CONTROLLERS
+static int aecp_unsolicited_find_controller(unsigned char controller_guid[8])
+{
+  for (int i=0; i < AVB_1722_1_AECP_UNSOLICITED_MAX_CONTROLLERS; i++)
+  {
+    if (aecp_unsolicited_controllers[i].valid && compare_guid(controller_guid, &aecp_unsolicited_controllers[i].guid))
+      return i;
+  }
+  return -1;
+}
+
+static int aecp_unsolicited_num_controllers(void)
+{
+  int n = 0;
+  for (int i=0; i < AVB_1722_1_AECP_UNSOLICITED_MAX_CONTROLLERS; i++)
+  {
+    n += aecp_unsolicited_controllers[i].valid;
+  }
+  return n;
+}
+
+static void aecp_unsolicited_queue_add(unsigned short command_type,
+                                       unsigned short descriptor_type,
+                                       unsigned short descriptor_id,
+                                       int exclude,
+                                       int if_changed)
+{
+  aecp_unsolicited_notification_t *notification;
+
+  if (!aecp_unsolicited_num_controllers()) return;
+
+  // Changes to the same state coalesce, as the notification is rendered from
+  // the current state when it is sent
+  for (int i=0; i < aecp_unsolicited_queue_len; i++)
+  {
+    notification = &aecp_unsolicited_queue[i];
+
+    if (notification->command_type == command_type &&
+        notification->descriptor_type == descriptor_type &&
+        notification->descriptor_id == descriptor_id)
+    {
+      if (notification->exclude != exclude) notification->exclude = -1;
+      notification->if_changed &= if_changed;
+      return;
+    }
+  }
+
+  if (aecp_unsolicited_queue_len == AVB_1722_1_AECP_UNSOLICITED_QUEUE_SIZE)
+  {
+    debug_printf("AECP: Unsolicited notification queue full\n");
+    return;
+  }
+
+  notification = &aecp_unsolicited_queue[aecp_unsolicited_queue_len++];
+  notification->command_type = command_type;
+  notification->descriptor_type = descriptor_type;
+  notification->descriptor_id = descriptor_id;
+  notification->exclude = exclude;
+  notification->if_changed = if_changed;
+}
+
+// The checksum slot of a descriptor whose counters are polled, or -1
+static int aecp_unsolicited_counters_slot(unsigned short descriptor_type, unsigned short descriptor_id)
+{
+  if (descriptor_type == AEM_CLOCK_DOMAIN_TYPE && descriptor_id < AVB_NUM_MEDIA_CLOCKS)
+    return descriptor_id;
+  if (descriptor_type == AEM_AVB_INTERFACE_TYPE && descriptor_id < PTP_NUM_PORTS)
+    return AVB_NUM_MEDIA_CLOCKS + descriptor_id;
+  return -1;
+}
+
+// The GET command whose response shows the state a successful command changed
+static int aecp_unsolicited_get_command(unsigned short command_type)
+{
+  switch (command_type)
+  {
+    case AECP_AEM_CMD_SET_STREAM_INFO:
+    case AECP_AEM_CMD_START_STREAMING:
+    case AECP_AEM_CMD_STOP_STREAMING:
+      return AECP_AEM_CMD_GET_STREAM_INFO;
+    case AECP_AEM_CMD_SET_STREAM_FORMAT:
+      return AECP_AEM_CMD_GET_STREAM_FORMAT;
+    case AECP_AEM_CMD_SET_SAMPLING_RATE:
+      return AECP_AEM_CMD_GET_SAMPLING_RATE;
+    case AECP_AEM_CMD_SET_CLOCK_SOURCE:
+      return AECP_AEM_CMD_GET_CLOCK_SOURCE;
+    case AECP_AEM_CMD_SET_CONTROL:
+      return AECP_AEM_CMD_GET_CONTROL;
+    case AECP_AEM_CMD_SET_SIGNAL_SELECTOR:
+      return AECP_AEM_CMD_GET_SIGNAL_SELECTOR;
+    default:
+      return -1;
+  }
+}
+
+/* Renders the response to a GET command for the notification into the
+ * command buffer. Returns the command data length, or 0 if there is nothing
+ * to send.
+ */
+static int aecp_unsolicited_render(aecp_unsolicited_notification_t *notification,
+                                   CLIENT_INTERFACE(avb_interface, i_avb_api),
+                                   CLIENT_INTERFACE(avb_1722_1_control_callbacks, i_1722_1_entity),
+                                   chanend c_ptp)
+{
+  avb_1722_1_aecp_packet_t *pkt = (avb_1722_1_aecp_packet_t *)aecp_unsolicited_cmd_buf;
+  avb_1722_1_packet_header_t *hdr = &(pkt->header);
+  avb_1722_1_aecp_aem_msg_t *aem_msg = &(pkt->data.aem);
+  unsigned char status = AECP_AEM_STATUS_SUCCESS;
+  int cd_len = 0;
+  // The command carries only the descriptor_type and descriptor_id
+  unsigned int data_len = AVB_1722_1_AECP_COMMAND_DATA_OFFSET + 4;
+
+  memset(aecp_unsolicited_cmd_buf, 0, sizeof(aecp_unsolicited_cmd_buf));
+  SET_1722_1_DATALENGTH(hdr, data_len);
+  AEM_MSG_SET_COMMAND_TYPE(aem_msg, notification->command_type);
+  AEM_MSG_SET_U_FLAG(aem_msg, 1);
+  hton_16(&aem_msg->command.payload[0], notification->descriptor_type);
+  hton_16(&aem_msg->command.payload[2], notification->descriptor_id);
+
+  switch (notification->command_type)
+  {
+    case AECP_AEM_CMD_GET_STREAM_INFO:
+      process_aem_cmd_getset_stream_info(pkt, &status, notification->command_type, i_avb_api);
+      cd_len = sizeof(avb_1722_1_aem_getset_stream_info_t);
+      break;
+    case AECP_AEM_CMD_GET_STREAM_FORMAT:
+      process_aem_cmd_getset_stream_format(pkt, &status, notification->command_type, i_avb_api);
+      cd_len = sizeof(avb_1722_1_aem_getset_stream_format_t);
+      break;
+    case AECP_AEM_CMD_GET_SAMPLING_RATE:
+      process_aem_cmd_getset_sampling_rate(pkt, &status, notification->command_type, i_avb_api);
+      cd_len = sizeof(avb_1722_1_aem_getset_sampling_rate_t);
+      break;
+    case AECP_AEM_CMD_GET_CLOCK_SOURCE:
+      process_aem_cmd_getset_clock_source(pkt, &status, notification->command_type, i_avb_api);
+      cd_len = sizeof(avb_1722_1_aem_getset_clock_source_t);
+      break;
+    case AECP_AEM_CMD_GET_CONTROL:
+      cd_len = process_aem_cmd_getset_control(pkt, &status, notification->command_type, i_1722_1_entity) + sizeof(avb_1722_1_aem_getset_control_t) + AVB_1722_1_AECP_COMMAND_DATA_OFFSET;
+      break;
+    case AECP_AEM_CMD_GET_SIGNAL_SELECTOR:
+      process_aem_cmd_getset_signal_selector(pkt, &status, notification->command_type, i_1722_1_entity);
+      cd_len = sizeof(avb_1722_1_aem_getset_signal_selector_t);
+      break;
+    case AECP_AEM_CMD_GET_COUNTERS:
+    {
+      avb_1722_1_aem_get_counters_t *counters = (avb_1722_1_aem_get_counters_t *)(aem_msg->command.payload);
+      int slot = aecp_unsolicited_counters_slot(notification->descriptor_type, notification->descriptor_id);
+      unsigned int sum = 0;
+
+      process_aem_cmd_get_counters(pkt, &status, i_avb_api, c_ptp);
+      cd_len = sizeof(avb_1722_1_aem_get_counters_t);
+
+      if (status != AECP_AEM_STATUS_SUCCESS || slot < 0) break;
+
+      // Counters are polled, so only their changes are pushed
+      for (int i=0; i < sizeof(counters->counters_block); i++)
+      {
+        sum = ((sum << 5) | (sum >> 27)) + counters->counters_block[i];
+      }
+      if (notification->if_changed && sum == aecp_unsolicited_counters_sum[slot])
+      {
+        return 0;
+      }
+      aecp_unsolicited_counters_sum[slot] = sum;
+      break;
+    }
+    default:
+      return 0;
+  }
+
+  return (status == AECP_AEM_STATUS_SUCCESS) ? cd_len : 0;
+}
+
+/* Sends the rendered response to each registered controller. Only the
+ * addressing differs between them, so the state is read once.
+ */
+static void aecp_unsolicited_send(int exclude, int cd_len, CLIENT_INTERFACE(ethernet_tx_if, i_eth))
+{
+  avb_1722_1_aecp_packet_t *pkt = (avb_1722_1_aecp_packet_t *)aecp_unsolicited_cmd_buf;
+  int num_tx_bytes = cd_len +
+                          2 + // U Flag + command type
+                          AVB_1722_1_AECP_PAYLOAD_OFFSET +
+                          sizeof(ethernet_hdr_t);
+
+  if (num_tx_bytes < 64) num_tx_bytes = 64;
+
+  set_64(pkt->target_guid, my_guid.c);
+
+  for (int i=0; i < AVB_1722_1_AECP_UNSOLICITED_MAX_CONTROLLERS; i++)
+  {
+    aecp_unsolicited_controller_t *controller = &aecp_unsolicited_controllers[i];
+
+    if (!controller->valid || i == exclude) continue;
+
+    set_64(pkt->controller_guid, controller->guid.c);
+    hton_16(pkt->sequence_id, controller->sequence_id++);
+    avb_1722_1_create_aecp_aem_response(controller->mac, AECP_AEM_STATUS_SUCCESS, cd_len, pkt);
+    eth_send_packet(i_eth, (char *)avb_1722_1_buf, num_tx_bytes, ETHERNET_ALL_INTERFACES);
+  }
+}
+
+static void aecp_unsolicited_command_succeeded(avb_1722_1_aecp_packet_t *pkt, unsigned short command_type)
+{
+  int get_command = aecp_unsolicited_get_command(command_type);
+
+  if (get_command < 0) return;
+
+  // All of these commands start with the descriptor_type and descriptor_id
+  aecp_unsolicited_queue_add(get_command,
+                             ntoh_16(&pkt->data.aem.command.payload[0]),
+                             ntoh_16(&pkt->data.aem.command.payload[2]),
+                             aecp_unsolicited_find_controller(pkt->controller_guid),
+                             0);
+}
+#endif
+
+static void process_aem_cmd_register_unsolicited(avb_1722_1_aecp_packet_t *pkt,
+                                                 unsigned char *status,
+                                                 unsigned short command_type,
+                                                 unsigned char src_addr[6])
+{
+#if AVB_1722_1_AECP_UNSOLICITED_MAX_CONTROLLERS
+  int i = aecp_unsolicited_find_controller(pkt->controller_guid);
+
+  if (command_type == AECP_AEM_CMD_DEREGISTER_UNSOLICITED_NOTIFICATION)
+  {
+    if (i >= 0) aecp_unsolicited_controllers[i].valid = 0;
+    return;
+  }
+
+  if (i < 0)
+  {
+    for (i=0; i < AVB_1722_1_AECP_UNSOLICITED_MAX_CONTROLLERS; i++)
+    {
+      if (!aecp_unsolicited_controllers[i].valid) break;
+    }
+    if (i == AVB_1722_1_AECP_UNSOLICITED_MAX_CONTROLLERS)
+    {
+      *status = AECP_AEM_STATUS_NO_RESOURCES;
+      return;
+    }
+
+    aecp_unsolicited_controllers[i].valid = 1;
+    aecp_unsolicited_controllers[i].sequence_id = 0;
+    for (int j=0; j < 8; j++)
+    {
+      aecp_unsolicited_controllers[i].guid.c[7-j] = pkt->controller_guid[j];
+    }
+
+    if (!aecp_unsolicited_counters_timer.active)
+    {
+      start_avb_timer(&aecp_unsolicited_counters_timer, AVB_1722_1_AECP_UNSOLICITED_COUNTERS_INTERVAL_CENTISECONDS);
+    }
+  }
+
+  // Registering again picks up a new source address for the controller
+  memcpy(aecp_unsolicited_controllers[i].mac, src_addr, 6);
+#else
+  *status = AECP_AEM_STATUS_NOT_IMPLEMENTED;
+#endif
+}
+
+void avb_1722_1_aem_notify(unsigned short command_type, unsigned short descriptor_type, unsigned short descriptor_id)
+{
+#if AVB_1722_1_AECP_UNSOLICITED_MAX_CONTROLLERS
+  aecp_unsolicited_queue_add(command_type, descriptor_type, descriptor_id, -1, 0);
+#endif
+}
+
+void avb_1722_1_aem_controller_departed(const_guid_ref_t guid)
+{
+#if AVB_1722_1_AECP_UNSOLICITED_MAX_CONTROLLERS
+  // A controller that goes away without deregistering would otherwise keep
+  // its slot and leave later controllers with NO_RESOURCES
+  for (int i=0; i < AVB_1722_1_AECP_UNSOLICITED_MAX_CONTROLLERS; i++)
+  {
+    if (aecp_unsolicited_controllers[i].valid && aecp_unsolicited_controllers[i].guid.l == guid->l)
+    {
+      aecp_unsolicited_controllers[i].valid = 0;
+    }
+  }
+#endif
+}
+
+void avb_1722_1_aecp_aem_notify_periodic(CLIENT_INTERFACE(ethernet_tx_if, i_eth),
+                                         CLIENT_INTERFACE(avb_interface, i_avb_api),
+                                         CLIENT_INTERFACE(avb_1722_1_control_callbacks, i_1722_1_entity),
+                                         chanend c_ptp)
+{
+#if AVB_1722_1_AECP_UNSOLICITED_MAX_CONTROLLERS
+  if (!aecp_unsolicited_num_controllers())
+  {
+    aecp_unsolicited_queue_len = 0;
+    stop_avb_timer(&aecp_unsolicited_counters_timer);
+    return;
+  }
+
+  if (avb_timer_expired(&aecp_unsolicited_counters_timer))
+  {
+    for (int i=0; i < AVB_NUM_MEDIA_CLOCKS; i++)
+    {
+      aecp_unsolicited_queue_add(AECP_AEM_CMD_GET_COUNTERS, AEM_CLOCK_DOMAIN_TYPE, i, -1, 1);
+    }
+    for (int i=0; i < PTP_NUM_PORTS; i++)
+    {
+      aecp_unsolicited_queue_add(AECP_AEM_CMD_GET_COUNTERS, AEM_AVB_INTERFACE_TYPE, i, -1, 1);
+    }
+    start_avb_timer(&aecp_unsolicited_counters_timer, AVB_1722_1_AECP_UNSOLICITED_COUNTERS_INTERVAL_CENTISECONDS);
+  }
+
+  // Rate limit: at most a burst of notifications per interval, the rest wait
+  // in the queue where further changes to the same state coalesce with them
+  avb_timer_expired(&aecp_unsolicited_timer);
+  if (aecp_unsolicited_queue_len && !aecp_unsolicited_timer.active)
+  {
+    int n = aecp_unsolicited_queue_len;
+
+    if (n > AVB_1722_1_AECP_UNSOLICITED_MAX_PER_INTERVAL) n = AVB_1722_1_AECP_UNSOLICITED_MAX_PER_INTERVAL;
+
+    for (int i=0; i < n; i++)
+    {
+      int cd_len = aecp_unsolicited_render(&aecp_unsolicited_queue[i], i_avb_api, i_1722_1_entity, c_ptp);
+
+      if (cd_len > 0) aecp_unsolicited_send(aecp_unsolicited_queue[i].exclude, cd_len, i_eth);
+    }
+
+    aecp_unsolicited_queue_len -= n;
+    memmove(&aecp_unsolicited_queue[0], &aecp_unsolicited_queue[n], aecp_unsolicited_queue_len * sizeof(aecp_unsolicited_notification_t));
+    start_avb_timer(&aecp_unsolicited_timer, AVB_1722_1_AECP_UNSOLICITED_INTERVAL_CENTISECONDS);
+  }
+
+  if (aecp_unsolicited_queue_len)
+  {
+    if (aecp_unsolicited_timer.active)
+      avb_control_deadline_timer(AVB_CONTROL_AECP, &aecp_unsolicited_timer);
+    else
+      avb_control_deadline_now(AVB_CONTROL_AECP);
+  }
+  avb_control_deadline_timer(AVB_CONTROL_AECP, &aecp_unsolicited_counters_timer);
+#endif
+}
+
 static void process_avb_1722_1_aecp_aem_msg(avb_1722_1_aecp_packet_t *pkt,
                                             unsigned char src_addr[6],
                                             int message_type,
                                             int num_pkt_bytes,
                                             CLIENT_INTERFACE(ethernet_tx_if, i_eth),
                                             CLIENT_INTERFACE(avb_interface, i_avb_api),
-                                            CLIENT_INTERFACE(avb_1722_1_control_callbacks, i_1722_1_entity))
+                                            CLIENT_INTERFACE(avb_1722_1_control_callbacks, i_1722_1_entity),
+                                            chanend c_ptp)
 {
   avb_1722_1_aecp_aem_msg_t *aem_msg = &(pkt->data.aem);
   unsigned short command_type = AEM_MSG_GET_COMMAND_TYPE(aem_msg);
@@ -688,6 +1500,10 @@ static void process_avb_1722_1_aecp_aem_msg(avb_1722_1_aecp_packet_t *pkt,
         desc_read_type = ntoh_16(aem_msg->command.read_descriptor_cmd.descriptor_type);
         desc_read_id = ntoh_16(aem_msg->command.read_descriptor_cmd.descriptor_id);
 
+#if AVB_1722_1_AEM_ENABLED && AVB_1722_1_AEM_DESCRIPTOR_CACHE_ENTRIES
+        num_tx_bytes = create_aem_read_descriptor_response_from_cache(desc_read_type, desc_read_id, src_addr, pkt);
+        if (!num_tx_bytes)
+#endif
         num_tx_bytes = create_aem_read_descriptor_response(desc_read_type, desc_read_id, src_addr, pkt, i_avb_api, i_1722_1_entity);
 
         if (num_tx_bytes < 64) num_tx_bytes = 64;
@@ -770,10 +1586,17 @@ static void process_avb_1722_1_aecp_aem_msg(avb_1722_1_aecp_packet_t *pkt,
       }
       case AECP_AEM_CMD_GET_COUNTERS:
       {
-        process_aem_cmd_get_counters(pkt, &status, i_avb_api);
+        process_aem_cmd_get_counters(pkt, &status, i_avb_api, c_ptp);
         cd_len = sizeof(avb_1722_1_aem_get_counters_t);
         break;
       }
+      case AECP_AEM_CMD_REGISTER_UNSOLICITED_NOTIFICATION:
+      case AECP_AEM_CMD_DEREGISTER_UNSOLICITED_NOTIFICATION:
+      {
+        process_aem_cmd_register_unsolicited(pkt, &status, command_type, src_addr);
+        cd_len = sizeof(avb_1722_1_aem_register_unsolicited_notification_t);
+        break;
+      }
       case AECP_AEM_CMD_START_OPERATION:
       case AECP_AEM_CMD_ABORT_OPERATION:
       {
@@ -794,6 +1617,26 @@ static void process_avb_1722_1_aecp_aem_msg(avb_1722_1_aecp_packet_t *pkt,
       }
     }
 
+    // Rendered descriptors may show the state that a command has just changed
+    if (status == AECP_AEM_STATUS_SUCCESS)
+    {
+      switch (command_type)
+      {
+        case AECP_AEM_CMD_SET_STREAM_INFO:
+        case AECP_AEM_CMD_SET_STREAM_FORMAT:
+        case AECP_AEM_CMD_SET_SAMPLING_RATE:
+        case AECP_AEM_CMD_SET_CLOCK_SOURCE:
+        case AECP_AEM_CMD_SET_CONTROL:
+        case AECP_AEM_CMD_SET_SIGNAL_SELECTOR:
+          avb_1722_1_aem_descriptors_changed();
+          break;
+      }
+#if AVB_1722_1_AECP_UNSOLICITED_MAX_CONTROLLERS
+      // Other registered controllers see the change without polling for it
+      aecp_unsolicited_command_succeeded(pkt, command_type);
+#endif
+    }
+
     // Send a response if required
     if (cd_len > 0)
     {
@@ -861,62 +1704,32 @@ static void process_avb_1722_1_aecp_address_access_cmd(avb_1722_1_aecp_packet_t
 {
   avb_1722_1_aecp_address_access_t *aa_cmd = &(pkt->data.address);
   int tlv_count = ntoh_16(aa_cmd->tlv_count);
-  unsigned int address = ntoh_32(&aa_cmd->address[4]);
   unsigned short status = AECP_AA_STATUS_SUCCESS;
-  int mode = ADDRESS_MSG_GET_MODE(aa_cmd);
-  int length = ADDRESS_MSG_GET_LENGTH(aa_cmd);
+  unsigned char *tlv = aa_cmd->mode_length;
+  unsigned char *tlv_end = tlv + GET_1722_1_DATALENGTH(&pkt->header) - AVB_1722_1_AECP_COMMAND_DATA_OFFSET;
   int cd_len = 0;
 
   if (compare_guid(pkt->target_guid, &my_guid)==0) return;
 
-  if (tlv_count != 1 || mode != AECP_AA_MODE_WRITE) {
+  if (tlv_count == 0 || tlv_end > (unsigned char *)(aa_cmd + 1)) {
     status = AECP_AA_STATUS_TLV_INVALID;
   }
-  else if (aecp_aa_next_write_address != address) {
-    // We currently only process address writes in order and do not allow an
-    // address to be written to twice
-    status = AECP_AA_STATUS_ADDRESS_INVALID;
-  }
-  else {
-    int bytes_available = length + aecp_aa_bytes_copied;
-    unsigned int packet_index = 0;
-
-    do {
-      if (aecp_aa_bytes_copied == 0) {
-        if (packet_index == 0) {
-          avb_write_upgrade_image_page(aecp_aa_flash_write_addr, aa_cmd->data, &status);
-          packet_index += FLASH_PAGE_SIZE;
-          aecp_aa_flash_write_addr += FLASH_PAGE_SIZE;
-          bytes_available -= FLASH_PAGE_SIZE;
-        }
-        else if (packet_index + FLASH_PAGE_SIZE > length) {
-          memcpy(aecp_flash_page_buf, &aa_cmd->data[packet_index], bytes_available);
-          aecp_aa_bytes_copied += bytes_available;
-          bytes_available = 0;
-          packet_index = 0;
-        }
-        else if (packet_index + FLASH_PAGE_SIZE <= length) {
-          avb_write_upgrade_image_page(aecp_aa_flash_write_addr, (unsigned char *)&aa_cmd->data[packet_index], &status);
-          packet_index += FLASH_PAGE_SIZE;
-          aecp_aa_flash_write_addr += FLASH_PAGE_SIZE;
-          bytes_available -= FLASH_PAGE_SIZE;
-        }
-      }
-      else if (aecp_aa_bytes_copied == FLASH_PAGE_SIZE) {
-          avb_write_upgrade_image_page(aecp_aa_flash_write_addr, (unsigned char *)aecp_flash_page_buf, &status);
-          aecp_aa_flash_write_addr += FLASH_PAGE_SIZE;
-          bytes_available -= FLASH_PAGE_SIZE;
-          aecp_aa_bytes_copied = 0;
-      }
-      else {
-        int bytes_to_copy = FLASH_PAGE_SIZE - aecp_aa_bytes_copied;
-        memcpy(&aecp_flash_page_buf[aecp_aa_bytes_copied], &aa_cmd->data[packet_index], bytes_to_copy);
-        aecp_aa_bytes_copied += bytes_to_copy;
-        packet_index += bytes_to_copy;
-      }
-    } while(bytes_available > 0);
 
-    aecp_aa_next_write_address += length;
+  // Each write TLV is staged independently, so several may be outstanding and
+  // they may cover the image in any order
+  for (int i=0; i < tlv_count && status == AECP_AA_STATUS_SUCCESS; i++)
+  {
+    // Every TLV is laid out like the first, less the tlv_count
+    avb_1722_1_aecp_address_access_t *aa = (avb_1722_1_aecp_address_access_t *)(tlv - 2);
+    int length = ADDRESS_MSG_GET_LENGTH(aa);
+
+    if (aa->data + length > tlv_end || ADDRESS_MSG_GET_MODE(aa) != AECP_AA_MODE_WRITE) {
+      status = AECP_AA_STATUS_TLV_INVALID;
+    }
+    else {
+      status = aecp_upgrade_stage(ntoh_32(&aa->address[4]), aa->data, length);
+    }
+    tlv = aa->data + length;
   }
 
   cd_len = GET_1722_1_DATALENGTH(&pkt->header);
@@ -937,7 +1750,8 @@ void process_avb_1722_1_aecp_packet(unsigned char src_addr[6],
                                     int num_pkt_bytes,
                                     CLIENT_INTERFACE(ethernet_tx_if, i_eth),
                                     CLIENT_INTERFACE(avb_interface, i_avb),
-                                    CLIENT_INTERFACE(avb_1722_1_control_callbacks, i_1722_1_entity))
+                                    CLIENT_INTERFACE(avb_1722_1_control_callbacks, i_1722_1_entity),
+                                    chanend c_ptp)
 {
   int message_type = GET_1722_1_MSG_TYPE(((avb_1722_1_packet_header_t*)pkt));
 
@@ -947,7 +1761,7 @@ void process_avb_1722_1_aecp_packet(unsigned char src_addr[6],
     case AECP_CMD_AEM_RESPONSE:
     {
       if (AVB_1722_1_AEM_ENABLED) {
-        process_avb_1722_1_aecp_aem_msg(pkt, src_addr, message_type, num_pkt_bytes, i_eth, i_avb, i_1722_1_entity);
+        process_avb_1722_1_aecp_aem_msg(pkt, src_addr, message_type, num_pkt_bytes, i_eth, i_avb, i_1722_1_entity, c_ptp);
       }
       break;
     }
@@ -1051,4 +1865,14 @@ void avb_1722_1_aecp_aem_periodic(CLIENT_INTERFACE(ethernet_tx_if, i_eth))
     }
   }
 
+#if AVB_1722_1_AEM_ENABLED && AVB_1722_1_AEM_DESCRIPTOR_CACHE_ENTRIES
+  aem_descriptor_cache_expire();
+#endif
+
+  avb_control_deadline_clear(AVB_CONTROL_AECP);
+  avb_control_deadline_timer(AVB_CONTROL_AECP, &aecp_aem_controller_available_timer);
+
+  if (AVB_1722_1_FIRMWARE_UPGRADE_ENABLED) {
+    aecp_upgrade_periodic(i_eth);
+  }
 }
@@ -13,6 +13,22 @@
 
 void avb_1722_1_aecp_aem_init(unsigned int serial_num);
 void avb_1722_1_aem_set_grandmaster_id(REFERENCE_PARAM(unsigned char, as_grandmaster_id));
+
+/** Drop the cached READ_DESCRIPTOR responses. Called when state shown in the
+ *  descriptors changes other than through an AECP command.
+ */
+void avb_1722_1_aem_descriptors_changed(void);
+
+/** Queue an unsolicited response to the given GET command for the controllers
+ *  registered for notifications. Called when the state that the command reads
+ *  changes other than through an AECP command.
+ */
+void avb_1722_1_aem_notify(unsigned short command_type, unsigned short descriptor_type, unsigned short descriptor_id);
+
+/** Drop the unsolicited notification registration of the given controller.
+ *  Called when the controller's entity leaves the ADP entity database.
+ */
+void avb_1722_1_aem_controller_departed(const_guid_ref_t guid);
 #ifdef __XC__
 extern "C" {
 #endif
@@ -21,7 +37,14 @@ void process_avb_1722_1_aecp_packet(unsigned char src_addr[6],
                                     int num_packet_bytes,
                                     CLIENT_INTERFACE(ethernet_tx_if, i_eth),
                                     CLIENT_INTERFACE(avb_interface, i_avb_api),
-                                    CLIENT_INTERFACE(avb_1722_1_control_callbacks, i_1722_1_entity));
+                                    CLIENT_INTERFACE(avb_1722_1_control_callbacks, i_1722_1_entity),
+                                    chanend c_ptp);
+
+/** Sends the queued unsolicited notifications, rate limited */
+void avb_1722_1_aecp_aem_notify_periodic(CLIENT_INTERFACE(ethernet_tx_if, i_eth),
+                                         CLIENT_INTERFACE(avb_interface, i_avb_api),
+                                         CLIENT_INTERFACE(avb_1722_1_control_callbacks, i_1722_1_entity),
+                                         chanend c_ptp);
 #ifdef __XC__
 }
 #endif
@@ -105,6 +105,14 @@
 #define AVB_1722_1_FIRMWARE_UPGRADE_ENABLED 0
 #endif
 
+/* Flash pages of an upgrade image staged ahead of the next page to be
+ * programmed. Address Access writes within this window may be outstanding
+ * at once and arrive in any order.
+ */
+#ifndef AVB_1722_1_FIRMWARE_UPGRADE_WINDOW_PAGES
+#define AVB_1722_1_FIRMWARE_UPGRADE_WINDOW_PAGES 8
+#endif
+
 #ifndef AVB_1722_1_FAST_CONNECT_ENABLED
 #define AVB_1722_1_FAST_CONNECT_ENABLED 0
 #endif
@@ -117,6 +125,17 @@
 #define AVB_1722_1_MAX_ENTITIES 4
 #endif
 
+/* Buckets of the hash on entity GUID used to look up the entity database.
+ * Must be a power of two, ideally of the same order as AVB_1722_1_MAX_ENTITIES.
+ */
+#ifndef AVB_1722_1_ENTITY_HASH_BUCKETS
+#define AVB_1722_1_ENTITY_HASH_BUCKETS 16
+#endif
+
+#if (AVB_1722_1_ENTITY_HASH_BUCKETS & (AVB_1722_1_ENTITY_HASH_BUCKETS - 1)) != 0
+#error "AVB_1722_1_ENTITY_HASH_BUCKETS must be a power of two"
+#endif
+
 #ifndef AVB_1722_1_MAX_LISTENERS
 #define AVB_1722_1_MAX_LISTENERS AVB_NUM_SINKS
 #endif
@@ -133,6 +152,73 @@
 #define AVB_1722_1_MAX_INFLIGHT_COMMANDS (AVB_1722_1_MAX_LISTENERS*2)
 #endif
 
+/* ACMP commands a controller can have outstanding at once. A command is kept
+ * in the slot given by its sequence ID modulo this value.
+ */
+#ifndef AVB_1722_1_ACMP_CONTROLLER_MAX_INFLIGHT
+#define AVB_1722_1_ACMP_CONTROLLER_MAX_INFLIGHT 16
+#endif
+
+/* Controller connects and disconnects waiting for an inflight slot, e.g. while
+ * a scene recall reconnects many streams. A later command to the same
+ * listener sink replaces a queued one.
+ */
+#ifndef AVB_1722_1_ACMP_CONTROLLER_QUEUE_SIZE
+#define AVB_1722_1_ACMP_CONTROLLER_QUEUE_SIZE 32
+#endif
+
+/* Rendered READ_DESCRIPTOR responses kept so that repeated enumeration by
+ * controllers does not rebuild them. 0 disables the cache.
+ */
+#ifndef AVB_1722_1_AEM_DESCRIPTOR_CACHE_ENTRIES
+#define AVB_1722_1_AEM_DESCRIPTOR_CACHE_ENTRIES 16
+#endif
+
+/* Descriptors larger than this (in bytes) are not cached */
+#ifndef AVB_1722_1_AEM_DESCRIPTOR_CACHE_ENTRY_SIZE
+#define AVB_1722_1_AEM_DESCRIPTOR_CACHE_ENTRY_SIZE 256
+#endif
+
+/* How long a cached descriptor with fields read from the AVB manager or the
+ * application (current format, sampling rate, clock source, control values)
+ * is used before it is rendered again. Changes made through AECP invalidate
+ * the cache immediately.
+ */
+#ifndef AVB_1722_1_AEM_DESCRIPTOR_CACHE_LIFETIME_CENTISECONDS
+#define AVB_1722_1_AEM_DESCRIPTOR_CACHE_LIFETIME_CENTISECONDS 100
+#endif
+
+/* Controllers that can register for unsolicited notifications. 0 disables
+ * REGISTER_UNSOLICITED_NOTIFICATION.
+ */
+#ifndef AVB_1722_1_AECP_UNSOLICITED_MAX_CONTROLLERS
+#define AVB_1722_1_AECP_UNSOLICITED_MAX_CONTROLLERS 4
+#endif
+
+/* State changes waiting to be sent as unsolicited responses. Further changes
+ * to state that is already queued coalesce with the queued notification.
+ */
+#ifndef AVB_1722_1_AECP_UNSOLICITED_QUEUE_SIZE
+#define AVB_1722_1_AECP_UNSOLICITED_QUEUE_SIZE 16
+#endif
+
+/* At most AVB_1722_1_AECP_UNSOLICITED_MAX_PER_INTERVAL notifications are sent
+ * to each registered controller every
+ * AVB_1722_1_AECP_UNSOLICITED_INTERVAL_CENTISECONDS
+ */
+#ifndef AVB_1722_1_AECP_UNSOLICITED_INTERVAL_CENTISECONDS
+#define AVB_1722_1_AECP_UNSOLICITED_INTERVAL_CENTISECONDS 2
+#endif
+
+#ifndef AVB_1722_1_AECP_UNSOLICITED_MAX_PER_INTERVAL
+#define AVB_1722_1_AECP_UNSOLICITED_MAX_PER_INTERVAL 4
+#endif
+
+/* How often the counters are checked for changes to notify */
+#ifndef AVB_1722_1_AECP_UNSOLICITED_COUNTERS_INTERVAL_CENTISECONDS
+#define AVB_1722_1_AECP_UNSOLICITED_COUNTERS_INTERVAL_CENTISECONDS 100
+#endif
+
 /* Debug defines */
 
 #ifndef AVB_1722_1_ADP_DEBUG_ENTITY_REMOVAL
@@ -1,5 +1,6 @@
 // Copyright (c) 2011-2017, XMOS Ltd, All rights reserved
 #include <print.h>
+#include <string.h>
 #include <xccompat.h>
 #include <xscope.h>
 #include "audio_output_fifo.h"
@@ -26,8 +27,10 @@ audio_output_fifo_init(buffer_handle_t s0, unsigned index)
   s->wrptr = START_OF_FIFO(s);
   s->media_clock = -1;
   s->pending_init_notification = 0;
+  s->buf_ctl_id = -1;
   s->last_notification_time = 0;
   s->volume = MAX_VOLUME;
+  memset(&s->counters, 0, sizeof(s->counters));
 }
 
 void
@@ -84,7 +87,7 @@ audio_output_fifo_pull_sample(buffer_handle_t s0,
                               unsigned int timestamp);
 
 // 1722 thread
-void
+int
 audio_output_fifo_maintain(buffer_handle_t s0,
                            unsigned index,
                            chanend buf_ctl,
@@ -92,9 +95,11 @@ audio_output_fifo_maintain(buffer_handle_t s0,
 {
   ofifo_t *s = (ofifo_t *)((struct output_finfo *)s0)->p_buffer[index];
   unsigned time_since_last_notification;
+  int report = -1;
 
+  // The server looks the FIFO up by address once and hands back its ID
   if (s->pending_init_notification && !(*notified_buf_ctl)) {
-    notify_buf_ctl_of_new_stream(buf_ctl, (int)s); // TODO: This can pass the index
+    notify_buf_ctl_of_new_stream(buf_ctl, (int)s);
     *notified_buf_ctl = 1;
     s->pending_init_notification = 0;
   }
@@ -130,18 +135,21 @@ audio_output_fifo_maintain(buffer_handle_t s0,
         (signed) s->sample_count - (signed) s->last_notification_time;
       if (s->ptp_ts != 0 &&
           s->local_ts != 0 &&
-          !(*notified_buf_ctl)
+          !(*notified_buf_ctl) &&
+          !s->pending_init_notification &&
+          s->buf_ctl_id != -1
           &&
           (s->last_notification_time == 0 ||
            time_since_last_notification > NOTIFICATION_PERIOD)
           )
         {
-          notify_buf_ctl_of_info(buf_ctl, (int)s); // TODO: FIXME
-          *notified_buf_ctl = 1;
+          report = s->buf_ctl_id;
           s->last_notification_time = s->sample_count;
         }
       break;
     }
+
+  return report;
 }
 
 // 1722 thread
@@ -164,6 +172,7 @@ audio_output_fifo_strided_push(buffer_handle_t s0,
   int volume = (s->state == ZEROING) ? 0 : 1;
 #endif
   int count=0;
+  int overflow=0;
 
   for(i=0;i<n;i+=stride) {
     count++;
@@ -198,9 +207,11 @@ audio_output_fifo_strided_push(buffer_handle_t s0,
     }
     else {
         // Overflow
+        overflow = 1;
     }
   }
 
+  s->counters.overflow += overflow;
   s->wrptr = wrptr;
   s->sample_count+=count;
 }
@@ -214,8 +225,17 @@ audio_output_fifo_handle_buf_ctl(chanend buf_ctl,
                                  timer tmr)
 {
   int cmd;
-  ofifo_t *s = (ofifo_t *)((struct output_finfo *)s0)->p_buffer[index];
+  ofifo_t *s;
   cmd = get_buf_ctl_cmd(buf_ctl);
+
+  // An acknowledgement may be for an ID that doesn't name one of the FIFOs
+  if (cmd == BUF_CTL_ACK) {
+    buf_ctl_ack(buf_ctl);
+    (*buf_ctl_notified)--;
+    return;
+  }
+
+  s = (ofifo_t *)((struct output_finfo *)s0)->p_buffer[index];
   switch (cmd)
     {
     case BUF_CTL_REQUEST_INFO: {
@@ -235,7 +255,8 @@ audio_output_fifo_handle_buf_ctl(chanend buf_ctl,
       send_buf_ctl_new_stream_info(buf_ctl,
                                    s->media_clock);
       buf_ctl_ack(buf_ctl);
-      *buf_ctl_notified = 0;
+      s->buf_ctl_id = index;
+      (*buf_ctl_notified)--;
       break;
     }
     case BUF_CTL_ADJUST_FILL:
@@ -254,14 +275,17 @@ audio_output_fifo_handle_buf_ctl(chanend buf_ctl,
         s->wrptr = new_wrptr;
       }
       s->state = LOCKED;
+      s->counters.locked++;
       s->zero_flag = 0;
       s->ptp_ts = 0;
       s->local_ts = 0;
       s->marker = (unsigned int *) 0;
       buf_ctl_ack(buf_ctl);
-      *buf_ctl_notified = 0;
+      (*buf_ctl_notified)--;
       break;
     case BUF_CTL_RESET:
+      if (s->state == LOCKED)
+        s->counters.unlocked++;
       s->state = ZEROING;
       if (s->wrptr == START_OF_FIFO(s))
         s->zero_marker = END_OF_FIFO(s) - 1;
@@ -270,11 +294,7 @@ audio_output_fifo_handle_buf_ctl(chanend buf_ctl,
       s->zero_flag = 1;
       *s->zero_marker = 1;
       buf_ctl_ack(buf_ctl);
-      *buf_ctl_notified = 0;
-      break;
-    case BUF_CTL_ACK:
-      buf_ctl_ack(buf_ctl);
-      *buf_ctl_notified = 0;
+      (*buf_ctl_notified)--;
       break;
     default:
       break;
@@ -289,3 +309,12 @@ audio_output_fifo_set_volume(buffer_handle_t s0,
 	  ofifo_t *s = (ofifo_t *)((struct output_finfo *)s0)->p_buffer[index];
 	  s->volume = volume;
 }
+
+void
+audio_output_fifo_get_counters(buffer_handle_t s0,
+                               unsigned index,
+                               audio_output_fifo_counters_t *counters)
+{
+  ofifo_t *s = (ofifo_t *)((struct output_finfo *)s0)->p_buffer[index];
+  *counters = s->counters;
+}
@@ -26,6 +26,16 @@ typedef enum ofifo_state_t {
 } ofifo_state_t;
 
 
+/**
+ * \brief Counters of FIFO events, read back by the 1722 listener thread
+ */
+typedef struct audio_output_fifo_counters_t {
+  unsigned int locked;                      //!< Number of times clock recovery locked to the FIFO
+  unsigned int unlocked;                    //!< Number of times clock recovery lost lock
+  unsigned int overflow;                    //!< Number of pushes that found the FIFO full
+  unsigned int underflow;                   //!< Number of samples pulled from an empty locked FIFO
+} audio_output_fifo_counters_t;
+
 struct audio_output_fifo_data_t {
   int zero_flag;							//!< When set, the FIFO will output zero samples instead of its contents
   unsigned int dptr;						//!< The read pointer
@@ -39,7 +49,9 @@ struct audio_output_fifo_data_t {
   int last_notification_time;				//!< Last time that the clock recovery thread was informed of the timestamp info
   int media_clock;							//!<
   int pending_init_notification;			//!<
+  int buf_ctl_id;                           //!< The ID the media clock server gave the FIFO, or -1
   int volume;                               //!< The linear volume multipler in 2.30 signed fixed point format
+  audio_output_fifo_counters_t counters;    //!< Counters of FIFO events
   unsigned int fifo[AUDIO_OUTPUT_FIFO_WORD_SIZE];
 };
 
@@ -56,7 +68,9 @@ typedef struct ofifo_t {
   int last_notification_time;
   int media_clock;
   int pending_init_notification;
+  int buf_ctl_id;
   int volume;
+  audio_output_fifo_counters_t counters;
   unsigned int fifo[AUDIO_OUTPUT_FIFO_WORD_SIZE];
 } ofifo_t;
 
@@ -93,12 +107,17 @@ void enable_audio_output_fifo(buffer_handle_t s,
  *  perform tasks such as informing the clock recovery thread
  *  of some new timing information.
  *
+ *  New timing information is not sent from here. The caller collects
+ *  the IDs returned for all the FIFOs of a stream and reports them to
+ *  the media clock server together with notify_buf_ctl_of_info().
+ *
  *  \param s handle to FIFO buffers
  *  \param index which buffer to operate on
  *  \param buf_ctl a channel end that links the FIFO to the media clock service
- *  \param notified_buf_ctl pointer to a flag which is set when the media clock has been notified of a timing event in the FIFO
+ *  \param notified_buf_ctl pointer to the number of media clock server transactions still outstanding
+ *  \return the media clock server ID of the FIFO if it has new timing information to report, otherwise -1
  */
-void
+int
 audio_output_fifo_maintain(buffer_handle_t s,
                            unsigned index,
                            chanend buf_ctl,
@@ -162,6 +181,8 @@ audio_output_fifo_pull_sample(buffer_handle_t s0,
   {
     // Underflow
     // printstrln("Media output FIFO underflow");
+    if (s->state == LOCKED)
+      s->counters.underflow++;
     return 0;
   }
 
@@ -220,7 +241,7 @@ void audio_output_fifo_set_ptp_timestamp(buffer_handle_t s0,
  *  \param s0 handle to FIFO buffers
  *  \param index which buffer to operate on
  *  \param stream_num  the number of the stream which is being handled
- *  \param buf_ctl_notified pointer to the flag which indicates whether the clock recovery thread has been notified of a timing event
+ *  \param buf_ctl_notified pointer to the number of media clock server transactions still outstanding
  */
 void
 audio_output_fifo_handle_buf_ctl(chanend buf_ctl,
@@ -229,6 +250,18 @@ audio_output_fifo_handle_buf_ctl(chanend buf_ctl,
                                  REFERENCE_PARAM(int, buf_ctl_notified),
                                  timer tmr);
 
+/**
+ *  \brief Read back the event counters of the media FIFO
+ *
+ *  \param s0 handle to FIFO buffers
+ *  \param index which buffer to operate on
+ *  \param counters the counters of the FIFO
+ */
+void
+audio_output_fifo_get_counters(buffer_handle_t s0,
+                               unsigned index,
+                               REFERENCE_PARAM(audio_output_fifo_counters_t, counters));
+
 /**
  *  \brief Set the volume control multiplier for the media FIFO
  *
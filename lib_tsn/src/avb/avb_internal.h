@@ -27,6 +27,7 @@
    \param c_tx    chanend connected to the ethernet mac (TX)
    \param i_avb   client interface of type avb_interface into avb_manager()
    \param i_1722_1_entity client interface of type avb_1722_1_control_callbacks
+   \param c_ptp   chanend connected to the PTP server
    \param i_spi  client interface of type spi_interface into avb_srp_task()
  **/
 void avb_process_1722_control_packet(unsigned int buf[],
@@ -34,7 +35,8 @@ void avb_process_1722_control_packet(unsigned int buf[],
                                     eth_packet_type_t packet_type,
                                     client interface ethernet_tx_if i_eth,
                                     client interface avb_interface i_avb,
-                                    client interface avb_1722_1_control_callbacks i_1722_1_entity);
+                                    client interface avb_1722_1_control_callbacks i_1722_1_entity,
+                                    chanend c_ptp);
 
 /** Process an AVB SRP control packet.
 
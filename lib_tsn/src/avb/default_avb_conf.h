@@ -62,6 +62,14 @@
 #define AVB_MAX_AUDIO_SAMPLE_RATE 48000
 #endif
 
+/** The lowest 1722 packet rate (packets per second) that any stream will be
+ *  configured with. Talker and Listener packet buffers are sized to hold a
+ *  packet at this rate. Defaults to one packet per Class A measurement interval.
+ */
+#ifndef AVB_MIN_1722_PACKET_RATE
+#define AVB_MIN_1722_PACKET_RATE 8000
+#endif
+
 #ifndef AVB_ENABLE_1722_1
 #define AVB_ENABLE_1722_1 0
 #endif
@@ -70,6 +78,15 @@
 #define AVB_ENABLE_1722_MAAP 0
 #endif
 
+/** The number of independent MAAP address ranges. Each range is probed,
+ *  announced and defended on its own, and a partial conflict moves only the
+ *  overlapping addresses to a range of their own. One per Talker stream is
+ *  enough for any split of the ranges requested for the sources.
+ */
+#ifndef AVB_1722_MAAP_MAX_RANGES
+#define AVB_1722_MAAP_MAX_RANGES (AVB_NUM_SOURCES > 0 ? AVB_NUM_SOURCES : 1)
+#endif
+
 #ifndef FLASH_MAX_UPGRADE_IMAGE_SIZE
 #define FLASH_MAX_UPGRADE_IMAGE_SIZE (128 * 1024)
 #endif
@@ -78,4 +95,46 @@
 #define FLASH_PAGE_SIZE (256)
 #endif
 
+/** Enable the warm restart snapshot of SRP reservations and MVRP
+ *  registrations in the flash data partition (see avb_srp_snapshot.h)
+ */
+#ifndef AVB_SRP_SNAPSHOT_ENABLED
+#define AVB_SRP_SNAPSHOT_ENABLED 0
+#endif
+
+/** The flash data sector holding the snapshot. Sector 0 holds the
+ *  1722.1 fast connect state. Each save is written to the next erased part of
+ *  the sector, and the sector is only erased at boot, once half of it is
+ *  used. Once the sector is full, no more saves are made until the next boot
+ *  has erased it.
+ */
+#ifndef AVB_SRP_SNAPSHOT_DATA_SECTOR
+#define AVB_SRP_SNAPSHOT_DATA_SECTOR 1
+#endif
+
+/** How often the snapshot is checked for changes and rewritten */
+#ifndef AVB_SRP_SNAPSHOT_SAVE_INTERVAL_CENTISECONDS
+#define AVB_SRP_SNAPSHOT_SAVE_INTERVAL_CENTISECONDS 1000
+#endif
+
+/** How long restored state is kept without a live declaration confirming it */
+#ifndef AVB_SRP_SNAPSHOT_CONFIRM_TIMEOUT_CENTISECONDS
+#define AVB_SRP_SNAPSHOT_CONFIRM_TIMEOUT_CENTISECONDS 500
+#endif
+
+/** How often sources with restored Listeners are checked for being ready to
+ *  transmit while the restored state is unconfirmed
+ */
+#ifndef AVB_SRP_SNAPSHOT_POLL_INTERVAL_CENTISECONDS
+#define AVB_SRP_SNAPSHOT_POLL_INTERVAL_CENTISECONDS 5
+#endif
+
+/** The longest the control tasks sleep between periodic calls when no
+ *  protocol has an earlier deadline, in reference clock ticks. This bounds
+ *  the latency of state changed from outside the task.
+ */
+#ifndef AVB_CONTROL_MAX_SLEEP_TIME
+#define AVB_CONTROL_MAX_SLEEP_TIME 1000000
+#endif
+
 #endif // __default_avb_conf_h__
@@ -25,7 +25,11 @@
 #define BUF_CTL_NEW_STREAM 17
 #define BUF_CTL_REQUEST_NEW_STREAM_INFO 18
 
-void notify_buf_ctl_of_info(chanend buf_ctl, int stream_num);
+/** Report new timing information in a set of FIFOs to the media clock server.
+ *  Each FIFO is given by the ID the server handed to it at BUF_CTL_NEW_STREAM,
+ *  and the server runs one buffer management transaction for each of them.
+ */
+void notify_buf_ctl_of_info(chanend buf_ctl, int ids[], int num_ids);
 void notify_buf_ctl_of_new_stream(chanend buf_ctl, int stream_num);
 #endif
 
@@ -22,10 +22,10 @@ typedef struct media_clock_t {
   media_clock_info_t info;
   unsigned int wordLength;
   unsigned int baseLengthRemainder;
-  unsigned int wordTime;
-  unsigned int baseLength;
+  unsigned int wordTime;           ///< Port time of the last edge driven
+  unsigned int baseLength;         ///< Reference clock half period in timer ticks
   unsigned int lowBits;
-  int count;
+  unsigned int edgeTime;           ///< Timer time of the last edge driven
   unsigned int next_event;
   unsigned int bit;
 } media_clock_t;
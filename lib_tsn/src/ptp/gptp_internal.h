@@ -11,7 +11,8 @@ enum ptp_cmd_t {
   PTP_GET_TIME_INFO_MOD64,
   PTP_GET_GRANDMASTER,
   PTP_GET_STATE,
-  PTP_GET_PDELAY
+  PTP_GET_PDELAY,
+  PTP_GET_PORT_COUNTERS
 };
 
 typedef enum ptp_port_role_t {
@@ -31,10 +32,19 @@ typedef struct ptp_path_delay_t {
   n80_t rcvd_source_identity;
 } ptp_path_delay_t;
 
+typedef struct ptp_port_counters_t {
+  unsigned int link_up;
+  unsigned int link_down;
+  unsigned int gm_changed;
+  unsigned int receipt_timeouts;      // announce or sync receipt timeouts while slave
+  unsigned int pdelay_lost_responses;
+} ptp_port_counters_t;
+
 typedef struct ptp_port_info_t {
   int asCapable;
   ptp_port_role_t role_state;
   ptp_path_delay_t delay_info;
+  ptp_port_counters_t counters;
 } ptp_port_info_t;
 
 // Synchronous PTP client functions
@@ -57,6 +67,16 @@ void ptp_get_propagation_delay(chanend ptp_server, unsigned *pdelay);
 
 void ptp_get_current_grandmaster(chanend ptp_server, unsigned char grandmaster[8]);
 
+/** Retrieve the event counters of a PTP port
+ *
+ *  \param ptp_server chanend connected to the ptp_server
+ *  \param port_num   the PTP port to read the counters of
+ *  \param counters   structure to be filled with the counters, all zero
+ *                    for a port that does not exist
+ **/
+void ptp_get_port_counters(chanend ptp_server, unsigned port_num,
+                           REFERENCE_PARAM(ptp_port_counters_t, counters));
+
 
 /** Initialize the inline ptp server.
  *
@@ -7,6 +7,7 @@
 #include "avb_mvrp_pdu.h"
 #include "avb_srp_pdu.h"
 #include "misc_timer.h"
+#include "avb_control_deadline.h"
 #include "ethernet.h"
 #include "ethernet_wrappers.h"
 #include <string.h>
@@ -19,13 +20,20 @@
  *  \brief the core of the MRP protocols
  */
 
-#define MAX_MRP_MSG_SIZE (sizeof(mrp_msg_header) + sizeof(srp_talker_first_value) + 1 /* for event vector */ + sizeof(mrp_msg_footer))
+// The most that adding one attribute can grow a PDU by: a new message holding
+// a new vector with the largest first value and one byte of each event vector
+#define MAX_MRP_MSG_SIZE (sizeof(mrp_msg_header) + sizeof(mrp_vector_header) + sizeof(srp_talker_failed_first_value) + 2 /* for event vectors */ + sizeof(mrp_msg_footer))
 
-// The size of the send buffer
+// The size of the send buffer.  By default this is a full standard Ethernet
+// frame (without the CRC) so that as many vectors as possible share a PDU;
+// it can be raised where the network carries jumbo frames.
 #ifndef MRP_SEND_BUFFER_SIZE
-#define MRP_SEND_BUFFER_SIZE (500)
+#define MRP_SEND_BUFFER_SIZE (1514)
 #endif
 
+// The largest count the 13 bit NumberOfValues field of a vector can hold
+#define MRP_MAX_NUMBER_OF_VALUES (0x1fff)
+
 //! Lengths of the first values for each attribute type
 static int first_value_lengths[MRP_NUM_ATTRIBUTE_TYPES] = FIRST_VALUE_LENGTHS;
 
@@ -42,9 +50,16 @@ static char send_buf[MRP_SEND_BUFFER_SIZE];
 //! Array of attribute control structures
 static mrp_attribute_state attrs[MRP_MAX_ATTRS];
 
-//! when sorting the attributes, this points to the head of the list.  attributes
-//! need to be sorted so that they can be merged into vectors in the MRP messages
-static mrp_attribute_state *first_attr = &attrs[0];
+//! Attributes of each type linked in the order they are merged into vectors in
+//! transmitted MRP messages (Talker Failed attributes are kept in the Talker
+//! Advertise list).  Attributes are inserted in order when they are initialised
+//! or begun, so the lists never need sorting when the join timer fires.
+static mrp_attribute_state *tx_list[MRP_NUM_ATTRIBUTE_TYPES];
+
+//! Index of the attributes hashed on (attribute type, port, first value key) so
+//! that received values and stream lookups probe one bucket rather than every
+//! attribute.  The sorted transmit order is kept separately in the lists above.
+static mrp_attribute_state *attr_index[MRP_ATTR_INDEX_BUCKETS];
 
 //! The end of the under-construction MRP packet
 static char *send_ptr= &send_buf[0] + sizeof(mrp_ethernet_hdr) + sizeof(mrp_header);
@@ -63,6 +78,25 @@ static int msrp_leaveall_active[MRP_NUM_PORTS];
 static int mvrp_leaveall_active[MRP_NUM_PORTS];
 //!@}
 
+//! Attributes with indications waiting to be delivered to the application, in
+//! the order that the indications were raised
+static mrp_attribute_state *pending_head = NULL;
+static mrp_attribute_state *pending_tail = NULL;
+
+#ifdef MRP_FULL_PARTICIPANT
+//! Attributes with a running leave timer.  Every leave timer has the same
+//! period, so appending when a timer starts keeps the queue in expiry order and
+//! the periodic tick only has to look at its head.
+static mrp_attribute_state *leave_queue = NULL;
+#endif
+
+extern unsigned int srp_domain_boundary_port[MRP_NUM_PORTS];
+
+//! Set when the Talker attributes of a port may need moving between Talker
+//! Advertise and Talker Failed because of the port's SRP domain boundary
+static int talker_domain_check[MRP_NUM_PORTS];
+static int last_domain_boundary[MRP_NUM_PORTS];
+
 static unsigned i_eth;
 
 void mrp_store_ethernet_interface(CLIENT_INTERFACE(ethernet_tx_if, i)) {
@@ -321,30 +355,59 @@ static int encode_three_packed(int event, int i, int vector)
   return (vector + event);
 }
 
+int mrp_vector_num_values(char *vec)
+{
+  mrp_vector_header *vector_hdr = (mrp_vector_header *) vec;
+  return ((vector_hdr->LeaveAllEventNumberOfValuesHigh & 0x1f)<<8) +
+         vector_hdr->NumberOfValuesLow;
+}
+
+void mrp_vector_set_num_values(char *vec, int num_values)
+{
+  mrp_vector_header *vector_hdr = (mrp_vector_header *) vec;
+  vector_hdr->LeaveAllEventNumberOfValuesHigh =
+    (vector_hdr->LeaveAllEventNumberOfValuesHigh & 0xe0) | ((num_values >> 8) & 0x1f);
+  vector_hdr->NumberOfValuesLow = num_values & 0xff;
+}
+
+static int vector_length(char *vec, mrp_attribute_type attr)
+{
+  int num_values = mrp_vector_num_values(vec);
+  int fourpacked_len = has_fourpacked_events(attr) ? (num_values+3)/4 : 0;
+  return sizeof(mrp_vector_header) + first_value_lengths[attr] + (num_values+2)/3 + fourpacked_len;
+}
+
+// Opens up a gap of len bytes at pos in the message buf, moving the rest of
+// the PDU along and keeping the message end mark in place
+static void insert_msg_bytes(char *buf, char *pos, int len)
+{
+  mrp_msg_header *hdr = (mrp_msg_header *) buf;
+  unsigned attr_list_length = attribute_list_length(hdr);
+  char *endmark;
+
+  if (send_ptr - pos > 0)
+    memmove(pos+len, pos, send_ptr - pos);
+  memset(pos, 0, len);
+  send_ptr += len;
+  attr_list_length += len;
+  hton_16(hdr->AttributeListLength, attr_list_length);
+  endmark = buf + sizeof(mrp_msg_header) + attr_list_length - 2;
+  *endmark = 0;
+  *(endmark+1) = 0;
+}
+
 void mrp_encode_three_packed_event(char *buf,
+                                   char *vec,
                                    int event,
                                    mrp_attribute_type attr)
 {
-  mrp_msg_header *hdr = (mrp_msg_header *) buf;
-  mrp_vector_header *vector_hdr = (mrp_vector_header *) (buf + sizeof(mrp_msg_header));
-  int num_values = vector_hdr->NumberOfValuesLow;
+  int num_values = mrp_vector_num_values(vec);
   int first_value_length =  first_value_lengths[attr];
-  char *vector = buf + sizeof(mrp_msg_header) + sizeof(mrp_vector_header) + first_value_length + num_values/3;
+  char *vector = vec + sizeof(mrp_vector_header) + first_value_length + num_values/3;
   int shift_required = (num_values % 3 == 0);
-  unsigned attr_list_length = attribute_list_length(hdr);
-
 
   if (shift_required) {
-    char *endmark;
-    if (send_ptr - vector > 0)
-      memmove(vector+1, vector, send_ptr - vector);
-    send_ptr++;
-    *vector = 0;
-    attr_list_length++;
-    hton_16(hdr->AttributeListLength, attr_list_length);
-    endmark = buf + sizeof(mrp_msg_header) + attr_list_length - 2;
-    *endmark = 0;
-    *(endmark+1) = 0;
+    insert_msg_bytes(buf, vector, 1);
   }
 
   *vector = encode_three_packed(event, num_values % 3, *vector);
@@ -361,30 +424,17 @@ static int encode_four_packed(int event, int i, int vector)
 }
 
 void mrp_encode_four_packed_event(char *buf,
+                                  char *vec,
                                   int event,
                                   mrp_attribute_type attr)
 {
-  mrp_msg_header *hdr = (mrp_msg_header *) buf;
-  mrp_vector_header *vector_hdr = (mrp_vector_header *) (buf + sizeof(mrp_msg_header));
-  int num_values = vector_hdr->NumberOfValuesLow;
+  int num_values = mrp_vector_num_values(vec);
   int first_value_length =  first_value_lengths[attr];
-  char *vector = buf + sizeof(mrp_msg_header) + sizeof(mrp_vector_header) + first_value_length + (num_values+3)/3 + num_values/4 ;
+  char *vector = vec + sizeof(mrp_vector_header) + first_value_length + (num_values+3)/3 + num_values/4 ;
   int shift_required = (num_values % 4 == 0);
-  unsigned attr_list_length = attribute_list_length(hdr);
-
-
 
   if (shift_required)  {
-    char *endmark;
-    if (send_ptr - vector > 0)
-      memmove(vector+1, vector, send_ptr - vector);
-    *vector = 0;
-    attr_list_length++;
-    send_ptr++;
-    hton_16(hdr->AttributeListLength, attr_list_length);
-    endmark = buf + sizeof(mrp_msg_header) + attr_list_length - 2;
-    *endmark = 0;
-    *(endmark+1) = 0;
+    insert_msg_bytes(buf, vector, 1);
   }
 
   *vector = encode_four_packed(event, num_values % 4, *vector);
@@ -418,51 +468,98 @@ static void create_empty_msg(mrp_attribute_type attr, int leave_all) {
 }
 
 
-static int encode_msg(char *msg, mrp_attribute_state* st, int vector, unsigned int port_num)
+static int encode_msg(char *msg, char *vec, mrp_attribute_state* st, int vector)
 {
+  // A vector holding the most values a vector can describe starts a new run
+  if (mrp_vector_num_values(vec) >= MRP_MAX_NUMBER_OF_VALUES)
+    return 0;
+
   switch (st->attribute_type)
   {
     case MSRP_TALKER_ADVERTISE:
     case MSRP_TALKER_FAILED:
     case MSRP_LISTENER:
     case MSRP_DOMAIN_VECTOR:
-      return avb_srp_encode_message(msg, st, vector);
+      return avb_srp_encode_message(msg, vec, st, vector);
       break;
     case MVRP_VID_VECTOR:
-      return avb_mvrp_merge_message(msg, st, vector);
+      return avb_mvrp_merge_message(msg, vec, st, vector);
       break;
   }
 
   return 0;
 }
 
-static void doTx(mrp_attribute_state *st,
-                 int vector,
-                 unsigned int port_num)
+// Returns the message of the PDU under construction that carries the given
+// attribute type, or NULL if there isn't one yet
+static char *find_msg(mrp_attribute_type attr)
 {
-  int merged = 0;
   char *msg = &send_buf[0]+sizeof(mrp_ethernet_hdr)+sizeof(mrp_header);
   char *end = send_ptr;
+  int atype = encode_attr_type(attr);
 
-  while (!merged &&
-         msg < end &&
+  while (msg < end &&
          (*msg != 0 || *(msg+1) != 0)) {
     mrp_msg_header *hdr = (mrp_msg_header *) &msg[0];
 
-    merged = encode_msg(msg, st, vector, port_num);
+    if (hdr->AttributeType == atype)
+      return msg;
 
     msg = msg + sizeof(mrp_msg_header) + attribute_list_length(hdr);
   }
+  return NULL;
+}
+
+// Returns the last vector of a message, which is the only one that a new value
+// can extend since attributes are transmitted in order
+static char *last_vector(char *msg, mrp_attribute_type attr)
+{
+  mrp_msg_header *hdr = (mrp_msg_header *) msg;
+  char *vec = msg + sizeof(mrp_msg_header);
+  char *end = vec + attribute_list_length(hdr) - sizeof(mrp_msg_footer);
+
+  while (vec + vector_length(vec, attr) < end)
+    vec += vector_length(vec, attr);
+
+  return vec;
+}
+
+// Appends an empty vector to the end of a message
+static char *append_vector(char *msg, mrp_attribute_type attr)
+{
+  mrp_msg_header *hdr = (mrp_msg_header *) msg;
+  char *vec = msg + sizeof(mrp_msg_header) + attribute_list_length(hdr) - sizeof(mrp_msg_footer);
+
+  insert_msg_bytes(msg, vec, sizeof(mrp_vector_header) + first_value_lengths[attr]);
+  return vec;
+}
+
+// Attributes are transmitted in the order of the per-type transmit lists,
+// which keep consecutive first values adjacent.  Each value therefore either
+// extends the run in the last vector of its message or starts a new vector in
+// the same message, so a PDU carries one message per attribute type holding
+// maximal NumberOfValues runs.
+static void doTx(mrp_attribute_state *st,
+                 int vector,
+                 unsigned int port_num)
+{
+  char *msg = find_msg(st->attribute_type);
 
   int port_to_transmit = st->port_num;
 
-  if (!merged) {
-    if (port_num == port_to_transmit)
-    {
-      create_empty_msg(st->attribute_type, 0);
-      (void) encode_msg(msg, st, vector, port_num);
+  if (msg != NULL) {
+    char *vec = last_vector(msg, st->attribute_type);
+
+    if (!encode_msg(msg, vec, st, vector)) {
+      vec = append_vector(msg, st->attribute_type);
+      (void) encode_msg(msg, vec, st, vector);
     }
   }
+  else if (port_num == port_to_transmit) {
+    msg = send_ptr;
+    create_empty_msg(st->attribute_type, 0);
+    (void) encode_msg(msg, msg + sizeof(mrp_msg_header), st, vector);
+  }
 
   if (MRP_DEBUG_ATTR_EGRESS)
   {
@@ -485,6 +582,58 @@ static void doTx(mrp_attribute_state *st,
   }
 }
 
+static void mark_pending(mrp_attribute_state *st, int indication)
+{
+  st->pending_indications |= indication;
+  if (!st->pending_listed) {
+    st->pending_next = NULL;
+    if (pending_tail != NULL)
+      pending_tail->pending_next = st;
+    else
+      pending_head = st;
+    pending_tail = st;
+    st->pending_listed = 1;
+  }
+}
+
+#ifdef MRP_FULL_PARTICIPANT
+static void leave_timer_stop(mrp_attribute_state *st)
+{
+  stop_avb_timer(&st->leaveTimer);
+  if (st->leave_listed) {
+    mrp_attribute_state **link = &leave_queue;
+    while (*link != st) {
+      link = &(*link)->leave_next;
+    }
+    *link = st->leave_next;
+    st->leave_listed = 0;
+  }
+}
+
+static void leave_timer_start(mrp_attribute_state *st)
+{
+  mrp_attribute_state **link = &leave_queue;
+
+  leave_timer_stop(st);
+  start_avb_timer(&st->leaveTimer, MRP_LEAVETIMER_PERIOD_CENTISECONDS);
+
+  while (*link != NULL) {
+    link = &(*link)->leave_next;
+  }
+  st->leave_next = NULL;
+  *link = st;
+  st->leave_listed = 1;
+}
+#endif
+
+static void talker_domain_changed(mrp_attribute_state *st)
+{
+  if (st->attribute_type == MSRP_TALKER_ADVERTISE ||
+      st->attribute_type == MSRP_TALKER_FAILED) {
+    talker_domain_check[st->port_num] = 1;
+  }
+}
+
 static void mrp_update_state(mrp_event e, mrp_attribute_state *st, int four_packed_event, unsigned int port_num)
 {
 #ifdef MRP_FULL_PARTICIPANT
@@ -496,21 +645,21 @@ static void mrp_update_state(mrp_event e, mrp_attribute_state *st, int four_pack
       break;
     case MRP_EVENT_RECEIVE_NEW:
       if (st->registrar_state == MRP_LV) {
-        stop_avb_timer(&st->leaveTimer);
+        leave_timer_stop(st);
       }
       mrp_change_registrar_state(st, e, MRP_IN);
-      st->pending_indications |= PENDING_JOIN_NEW;
+      mark_pending(st, PENDING_JOIN_NEW);
       st->four_vector_parameter = four_packed_event;
       break;
     case MRP_EVENT_RECEIVE_JOININ:
     case MRP_EVENT_RECEIVE_JOINMT:
       if (st->registrar_state == MRP_LV) {
-        stop_avb_timer(&st->leaveTimer);
+        leave_timer_stop(st);
       }
       if (st->registrar_state == MRP_MT ||
           ((st->four_vector_parameter == AVB_SRP_FOUR_PACKED_EVENT_ASKING_FAILED) &&
             (four_packed_event == AVB_SRP_FOUR_PACKED_EVENT_READY))) {
-          st->pending_indications |= PENDING_JOIN;
+          mark_pending(st, PENDING_JOIN);
           st->four_vector_parameter = four_packed_event;
       }
       mrp_change_registrar_state(st, e, MRP_IN);
@@ -529,7 +678,7 @@ static void mrp_update_state(mrp_event e, mrp_attribute_state *st, int four_pack
         }
       }
       if (st->registrar_state == MRP_IN) {
-        start_avb_timer(&st->leaveTimer, MRP_LEAVETIMER_PERIOD_CENTISECONDS);
+        leave_timer_start(st);
         mrp_change_registrar_state(st, e, MRP_LV);
       }
       break;
@@ -537,7 +686,7 @@ static void mrp_update_state(mrp_event e, mrp_attribute_state *st, int four_pack
     case MRP_EVENT_FLUSH:
       if (st->registrar_state == MRP_LV) {
         // Lv
-        st->pending_indications |= PENDING_LEAVE;
+        mark_pending(st, PENDING_LEAVE);
         st->four_vector_parameter = four_packed_event;
       }
       mrp_change_registrar_state(st, e, MRP_MT);
@@ -787,24 +936,199 @@ void mrp_debug_dump_attrs(void)
 #endif
 }
 
+// Talker Advertise and Talker Failed attributes for a stream change between
+// each other's type, so they are indexed (and matched) as a single type
+static int index_type(int attribute_type)
+{
+  return (attribute_type == MSRP_TALKER_FAILED) ? MSRP_TALKER_ADVERTISE : attribute_type;
+}
+
+static unsigned long long stream_id_key(unsigned stream_id[2])
+{
+  return ((unsigned long long) stream_id[0] << 32) + stream_id[1];
+}
+
+// The first value key of an attribute: the Stream ID for MSRP Talker and
+// Listener attributes, the VID for MVRP and zero for everything else
+static unsigned long long attribute_key(mrp_attribute_state *st)
+{
+  if (st->attribute_info == NULL)
+    return 0;
+
+  switch (st->attribute_type)
+  {
+    case MSRP_TALKER_ADVERTISE:
+    case MSRP_TALKER_FAILED:
+    case MSRP_LISTENER:
+      return stream_id_key(((avb_srp_info_t *) st->attribute_info)->stream_id);
+    case MVRP_VID_VECTOR:
+      return *(int *) st->attribute_info;
+    default:
+      return 0;
+  }
+}
+
+static int index_hash(int attribute_type, unsigned int port_num, unsigned long long key)
+{
+  unsigned h = (unsigned) key ^ (unsigned) (key >> 32);
+  h ^= (index_type(attribute_type) << 8) ^ port_num;
+  h *= 0x9e3779b1;
+  return (h ^ (h >> 16)) & (MRP_ATTR_INDEX_BUCKETS - 1);
+}
+
+// Returns the head of the index bucket for a key.  Attributes that have been
+// released since they were indexed are unlinked here rather than at every
+// place that marks an attribute MRP_UNUSED.
+static mrp_attribute_state *index_bucket(int attribute_type, unsigned int port_num, unsigned long long key)
+{
+  int bucket = index_hash(attribute_type, port_num, key);
+  mrp_attribute_state **link = &attr_index[bucket];
+
+  while (*link != NULL) {
+    mrp_attribute_state *st = *link;
+    if (st->applicant_state == MRP_UNUSED) {
+      *link = st->index_next;
+      st->index_bucket = -1;
+    }
+    else
+      link = &st->index_next;
+  }
+
+  return attr_index[bucket];
+}
+
+static void index_remove(mrp_attribute_state *st)
+{
+  if (st->index_bucket < 0)
+    return;
+
+  mrp_attribute_state **link = &attr_index[st->index_bucket];
+  while (*link != NULL) {
+    if (*link == st) {
+      *link = st->index_next;
+      break;
+    }
+    link = &(*link)->index_next;
+  }
+  st->index_bucket = -1;
+}
+
+static void index_insert(mrp_attribute_state *st)
+{
+  int bucket = index_hash(st->attribute_type, st->port_num, attribute_key(st));
+  st->index_next = attr_index[bucket];
+  st->index_bucket = bucket;
+  attr_index[bucket] = st;
+}
+
+// Returns non-zero if attribute a should be transmitted before attribute b
+// of the same type
+static int compare_attr(mrp_attribute_state *a,
+                        mrp_attribute_state *b)
+{
+  switch (index_type(a->attribute_type))
+    {
+    case MSRP_TALKER_ADVERTISE:
+      return avb_srp_compare_talker_attributes(a,b);
+      break;
+    case MSRP_LISTENER:
+      return avb_srp_compare_listener_attributes(a,b);
+      break;
+    case MVRP_VID_VECTOR:
+      return avb_mvrp_compare_vid_vector_attributes(a,b);
+      break;
+    default:
+      break;
+    }
+  return (a<b);
+}
+
+// Returns the first attribute of a type in transmit order, unlinking any
+// attributes that have been released since they were inserted
+static mrp_attribute_state *tx_list_first(int attribute_type)
+{
+  mrp_attribute_state **link = &tx_list[index_type(attribute_type)];
+
+  while (*link != NULL) {
+    mrp_attribute_state *st = *link;
+    if (st->applicant_state == MRP_UNUSED) {
+      *link = st->next;
+      st->tx_listed = 0;
+    }
+    else
+      link = &st->next;
+  }
+
+  return tx_list[index_type(attribute_type)];
+}
+
+static void tx_list_remove(mrp_attribute_state *st)
+{
+  if (!st->tx_listed)
+    return;
+
+  mrp_attribute_state **link = &tx_list[index_type(st->attribute_type)];
+  while (*link != NULL) {
+    if (*link == st) {
+      *link = st->next;
+      break;
+    }
+    link = &(*link)->next;
+  }
+  st->tx_listed = 0;
+}
+
+// Insertion keeps attributes that compare equal in the order they were added
+static void tx_list_insert(mrp_attribute_state *st)
+{
+  mrp_attribute_state **link = &tx_list[index_type(st->attribute_type)];
+
+  while (*link != NULL && !compare_attr(st, *link)) {
+    link = &(*link)->next;
+  }
+  st->next = *link;
+  *link = st;
+  st->tx_listed = 1;
+}
+
+// When several attributes match a lookup the lowest addressed one is returned,
+// which is the attribute a scan of the attrs array would have found first
+static mrp_attribute_state *prefer_attr(mrp_attribute_state *best, mrp_attribute_state *st)
+{
+  return (best == NULL || st < best) ? st : best;
+}
+
 void mrp_attribute_init(mrp_attribute_state *st,
                         mrp_attribute_type t,
                         unsigned int port_num,
                         unsigned int here,
                         void *info)
 {
+  index_remove(st);
+  tx_list_remove(st);
   memset(st, sizeof(mrp_attribute_state), 0);
   st->attribute_type = t;
   st->attribute_info = info;
   st->port_num = port_num;
   st->propagated = 0;
   st->here = here;
+  index_insert(st);
+  tx_list_insert(st);
+  talker_domain_changed(st);
   return;
 }
 
 void mrp_mad_begin(mrp_attribute_state *st)
 {
+  // The attribute value may have been changed since it was initialised
+  // (e.g. the VID of an MVRP attribute being reused) so re-key and re-sort it
+  index_remove(st);
+  index_insert(st);
+  tx_list_remove(st);
+  tx_list_insert(st);
+  talker_domain_changed(st);
 #ifdef MRP_FULL_PARTICIPANT
+  leave_timer_stop(st);
   init_avb_timer(&st->leaveTimer, 1);
 #endif
   mrp_update_state(MRP_EVENT_BEGIN, st, 0, st->port_num);
@@ -830,6 +1154,7 @@ void mrp_mad_join(mrp_attribute_state *st, int new)
 #endif
 
   st->remove_after_next_tx = 0;
+  talker_domain_changed(st);
 
   if (new) {
     mrp_update_state(MRP_EVENT_NEW, st, 0, st->port_num);
@@ -845,6 +1170,14 @@ void mrp_mad_leave(mrp_attribute_state *st)
   mrp_update_state(MRP_EVENT_LV, st, 0, st->port_num);
 }
 
+void mrp_get_bridge_id(unsigned char bridge_id[8])
+{
+  mrp_ethernet_hdr *hdr = (mrp_ethernet_hdr *) &send_buf[0];
+  bridge_id[0] = 0;
+  bridge_id[1] = 0;
+  memcpy(&bridge_id[2], hdr->src_addr, 6);
+}
+
 void mrp_init(char *macaddr)
 {
   for (int i=0;i<6;i++) {
@@ -854,12 +1187,28 @@ void mrp_init(char *macaddr)
 
   for (int i=0;i<MRP_MAX_ATTRS;i++) {
     attrs[i].applicant_state = MRP_UNUSED;
-    if (i != MRP_MAX_ATTRS-1)
-      attrs[i].next = &attrs[i+1];
-    else
-      attrs[i].next = NULL;
+    attrs[i].index_bucket = -1;
+    attrs[i].tx_listed = 0;
+    attrs[i].next = NULL;
+    attrs[i].pending_listed = 0;
+#ifdef MRP_FULL_PARTICIPANT
+    attrs[i].leave_listed = 0;
+#endif
+  }
+
+  pending_head = NULL;
+  pending_tail = NULL;
+#ifdef MRP_FULL_PARTICIPANT
+  leave_queue = NULL;
+#endif
+
+  for (int i=0;i<MRP_NUM_ATTRIBUTE_TYPES;i++) {
+    tx_list[i] = NULL;
+  }
+
+  for (int i=0;i<MRP_ATTR_INDEX_BUCKETS;i++) {
+    attr_index[i] = NULL;
   }
-  first_attr = &attrs[0];
 
   for (int i=0; i < MRP_NUM_PORTS; i++)
   {
@@ -878,52 +1227,12 @@ void mrp_init(char *macaddr)
     msrp_leaveall_active[i] = 0;
     mvrp_leaveall_active[i] = 0;
   #endif
+    talker_domain_check[i] = 1;
+    last_domain_boundary[i] = srp_domain_boundary_port[i];
   }
 
 }
 
-static int compare_attr(mrp_attribute_state *a,
-                        mrp_attribute_state *b)
-{
-  if (a->applicant_state == MRP_UNUSED) {
-    if (b->applicant_state == MRP_UNUSED)
-      return (a < b);
-    else
-      return 0;
-  }
-  else if (b->applicant_state == MRP_UNUSED) {
-    return 1;
-  }
-
-
-  if (a->applicant_state == MRP_DISABLED) {
-    if (b->applicant_state == MRP_DISABLED)
-      return (a < b);
-    else
-      return 0;
-  }
-  else if (b->applicant_state == MRP_DISABLED) {
-    return 1;
-  }
-
-
-  if (a->attribute_type != b->attribute_type)
-    return (a->attribute_type < b->attribute_type);
-
-  switch (a->attribute_type)
-    {
-    case MSRP_TALKER_ADVERTISE:
-      return avb_srp_compare_talker_attributes(a,b);
-      break;
-    case MSRP_LISTENER:
-      return avb_srp_compare_listener_attributes(a,b);
-      break;
-    default:
-      break;
-    }
-  return (a<b);
-}
-
 mrp_attribute_state *mrp_get_attr(void)
 {
   for (int i=0;i<MRP_MAX_ATTRS;i++) {
@@ -935,93 +1244,29 @@ mrp_attribute_state *mrp_get_attr(void)
   return NULL;
 }
 
-static void sort_attrs()
-{
-  mrp_attribute_state *to_insert=NULL;
-  mrp_attribute_state *attr=NULL;
-  mrp_attribute_state *prev=NULL;
-
-  // This sorting algorithm is designed to work best for lists
-  // we already expect to be sorted (which is generally the case here)
-
-  // Get items to insert back in
-  attr = first_attr;
-  while (attr != NULL) {
-    mrp_attribute_state *next = attr->next;
-    if (next != NULL) {
-      if (!compare_attr(attr, next)) {
-        if (prev)
-          prev->next = next;
-        else
-          first_attr = next;
-
-        attr->next = to_insert;
-        to_insert = attr;
-      }
-      else
-        prev = attr;
-    }
-    attr = next;
-  }
+static void attribute_type_event(mrp_attribute_type atype, mrp_event e, unsigned int port_num) {
+  mrp_attribute_state *attr = tx_list_first(atype);
 
-  // Inser them back in
-  attr = to_insert;
   while (attr != NULL) {
+    // The transmit may release the attribute so take the next one first
     mrp_attribute_state *next = attr->next;
-    mrp_attribute_state *ins = first_attr;
+    if (attr->applicant_state != MRP_DISABLED &&
+        attr->applicant_state != MRP_UNUSED &&
+        attr->attribute_type == atype &&
+        attr->port_num == port_num) {
 
-    if (compare_attr(attr, ins)) {
-      attr->next = ins;
-      first_attr = attr;
-    }
-    else {
-      while (ins != NULL) {
-        mrp_attribute_state *ins_next = ins->next;
-        if (ins_next == NULL ||
-            (compare_attr(ins, attr) && compare_attr(attr, ins_next))) {
-          attr->next = ins->next;
-          ins->next = attr;
-          ins_next = NULL;
+          mrp_update_state(e, attr, 0, port_num);
         }
-        ins = ins_next;
-      }
-    }
     attr = next;
   }
-
-
 }
 
 static void global_event(mrp_event e, unsigned int port_num) {
-  mrp_attribute_state *attr = first_attr;
-
-  while (attr != NULL) {
-    if (attr->applicant_state != MRP_DISABLED &&
-        attr->applicant_state != MRP_UNUSED &&
-        attr->port_num == port_num) {
-
-      if (e != MRP_EVENT_PERIODIC || attr->attribute_type == MVRP_VID_VECTOR)
-      {
-        mrp_update_state(e, attr, 0, port_num);
-      }
+  for (int t=0;t<MRP_NUM_ATTRIBUTE_TYPES;t++) {
+    if (e != MRP_EVENT_PERIODIC || t == MVRP_VID_VECTOR)
+    {
+      attribute_type_event(t, e, port_num);
     }
-    attr = attr->next;
-  }
-
-}
-
-static void attribute_type_event(mrp_attribute_type atype, mrp_event e, unsigned int port_num) {
-  mrp_attribute_state *attr = first_attr;
-
-  while (attr != NULL) {
-    if (attr->applicant_state != MRP_DISABLED &&
-        attr->applicant_state != MRP_UNUSED &&
-        attr->attribute_type == atype &&
-        attr->port_num == port_num) {
-
-          mrp_update_state(e, attr, 0, port_num);
-        }
-    attr = attr->next;
   }
 }
 
@@ -1074,8 +1319,47 @@ static void msrp_types_event(mrp_event e, unsigned int port_num) {
   attribute_type_event(MSRP_DOMAIN_VECTOR, e, port_num);
 }
 
-extern unsigned int srp_domain_boundary_port[MRP_NUM_PORTS];
+// Moves the Talker attributes of a port between Talker Advertise and Talker
+// Failed as the port enters or leaves an SRP domain boundary
+static void talker_domain_event(int port_num)
+{
+  for (mrp_attribute_state *st = tx_list_first(MSRP_TALKER_ADVERTISE); st != NULL; st = st->next)
+  {
+    if (st->port_num != port_num) continue;
+
+    avb_srp_info_t *reservation = (avb_srp_info_t *) st->attribute_info;
+
+    if ((st->attribute_type == MSRP_TALKER_ADVERTISE) && reservation &&
+        srp_stream_domain_boundary(reservation, port_num)) {
+      debug_printf("Talker Advertise -> Failed for stream %x%x\n", reservation->stream_id[0], reservation->stream_id[1]);
+      st->attribute_type = MSRP_TALKER_FAILED;
+      if (reservation) {
+        avb_stream_entry *stream_info = st->attribute_info;
+        stream_info->talker_present = 0;
+        reservation->failure_code = AVB_SRP_FAILURE_CODE_EGRESS_PORT_NOT_AVB_CAPABLE;
+        mrp_get_bridge_id(reservation->failure_bridge_id);
+      }
+      if (st->here)
+        mrp_mad_join(st, 1);
+    }
+    else if ((st->attribute_type == MSRP_TALKER_FAILED) &&
+              reservation &&
+              !srp_stream_domain_boundary(reservation, port_num) && reservation->failure_code == AVB_SRP_FAILURE_CODE_EGRESS_PORT_NOT_AVB_CAPABLE
+            ) {
+      st->attribute_type = MSRP_TALKER_ADVERTISE;
+      avb_stream_entry *stream_info = st->attribute_info;
+      stream_info->talker_present = 1;
+      debug_printf("Talker Failed -> Advertise for stream %x%x\n", reservation->stream_id[0], reservation->stream_id[1]);
+      if (st->here)
+        mrp_mad_join(st, 1);
+    }
+  }
+}
 
+// Only the attributes that have work to do are visited each tick: expired
+// leave timers come off the front of the leave timer queue, indications are
+// taken from the pending list and a port's Talkers are only re-checked against
+// its SRP domain boundary when something that affects them has changed.
 void mrp_periodic(CLIENT_INTERFACE(avb_interface, avb))
 {
   for (int i=0; i < MRP_NUM_PORTS; i++)
@@ -1106,7 +1390,6 @@ void mrp_periodic(CLIENT_INTERFACE(avb_interface, avb))
     if (avb_timer_expired(&joinTimer[i]))
     {
       start_avb_timer(&joinTimer[i], MRP_JOINTIMER_PERIOD_CENTISECONDS);
-      sort_attrs();
 
       mrp_event tx_event = mvrp_leaveall_active[i] ? MRP_EVENT_TX_LEAVE_ALL : MRP_EVENT_TX;
       configure_send_buffer(mvrp_dest_mac, AVB_MVRP_ETHERTYPE);
@@ -1132,70 +1415,93 @@ void mrp_periodic(CLIENT_INTERFACE(avb_interface, avb))
       msrp_types_event(tx_event, i);
       force_send(i_eth, i);
     }
+  }
 
-    for (int j=0;j<MRP_MAX_ATTRS;j++)
+#ifdef MRP_FULL_PARTICIPANT
+  while (leave_queue != NULL)
+  {
+    mrp_attribute_state *st = leave_queue;
+    int expired = 0;
+
+    // Released attributes and stopped timers are simply dropped from the queue
+    if (st->applicant_state != MRP_UNUSED && st->leaveTimer.active)
     {
-      if (attrs[j].applicant_state == MRP_UNUSED) continue;
-      if (attrs[j].port_num != i) continue;
+      if (!avb_timer_expired(&st->leaveTimer))
+        break;
+      expired = 1;
+    }
 
-      if (attrs[j].pending_indications != 0)
-      {
-        if ((attrs[j].pending_indications & PENDING_JOIN_NEW) != 0)
-        {
-          send_join_indication(avb, &attrs[j], 1, attrs[j].four_vector_parameter);
-        }
-        if ((attrs[j].pending_indications & PENDING_JOIN) != 0)
-        {
-          send_join_indication(avb, &attrs[j], 0, attrs[j].four_vector_parameter);
-        }
-        if ((attrs[j].pending_indications & PENDING_LEAVE) != 0)
-        {
-          send_leave_indication(avb, &attrs[j], attrs[j].four_vector_parameter);
-        }
-        attrs[j].pending_indications = 0;
-      }
+    leave_queue = st->leave_next;
+    st->leave_listed = 0;
 
-      avb_srp_info_t *reservation = (avb_srp_info_t *) attrs[j].attribute_info;
-
-      if ((attrs[j].attribute_type == MSRP_TALKER_ADVERTISE) && srp_domain_boundary_port[i]) {
-        debug_printf("Talker Advertise -> Failed for stream %x%x\n", reservation->stream_id[0], reservation->stream_id[1]);
-        attrs[j].attribute_type = MSRP_TALKER_FAILED;
-        if (reservation) {
-          avb_stream_entry *stream_info = attrs[j].attribute_info;
-          stream_info->talker_present = 0;
-          reservation->failure_code = 8;
-          for (int i=0; i < 8; i++) {
-            mrp_ethernet_hdr *hdr = (mrp_ethernet_hdr *) &send_buf[0];
-            if (i < 2) {
-              reservation->failure_bridge_id[i] = 0;
-            } else {
-              reservation->failure_bridge_id[i] = hdr->src_addr[i];
-            }
-          }
-        }
-        if (attrs[j].here)
-          mrp_mad_join(&attrs[j], 1);
-      }
-      else if ((attrs[j].attribute_type == MSRP_TALKER_FAILED) &&
-                !srp_domain_boundary_port[i] &&
-                reservation && reservation->failure_code == 8
-              ) {
-        attrs[j].attribute_type = MSRP_TALKER_ADVERTISE;
-        avb_stream_entry *stream_info = attrs[j].attribute_info;
-        stream_info->talker_present = 1;
-        debug_printf("Talker Failed -> Advertise for stream %x%x\n", reservation->stream_id[0], reservation->stream_id[1]);
-        if (attrs[j].here)
-          mrp_mad_join(&attrs[j], 1);
-      }
+    if (expired)
+    {
+      mrp_update_state(MRP_EVENT_LEAVETIMER, st, 0, st->port_num);
+    }
+  }
+#endif
+
+  for (int i=0; i < MRP_NUM_PORTS; i++)
+  {
+    if (srp_domain_boundary_port[i] != last_domain_boundary[i])
+    {
+      last_domain_boundary[i] = srp_domain_boundary_port[i];
+      talker_domain_check[i] = 1;
+    }
+    if (talker_domain_check[i])
+    {
+      talker_domain_check[i] = 0;
+      talker_domain_event(i);
+    }
+  }
 
+  while (pending_head != NULL)
+  {
+    mrp_attribute_state *st = pending_head;
+
+    pending_head = st->pending_next;
+    if (pending_head == NULL)
+      pending_tail = NULL;
+    st->pending_listed = 0;
+
+    if (st->applicant_state == MRP_UNUSED)
+    {
+      st->pending_indications = 0;
+      continue;
+    }
+
+    if ((st->pending_indications & PENDING_JOIN_NEW) != 0)
+    {
+      send_join_indication(avb, st, 1, st->four_vector_parameter);
+    }
+    if ((st->pending_indications & PENDING_JOIN) != 0)
+    {
+      send_join_indication(avb, st, 0, st->four_vector_parameter);
+    }
+    if ((st->pending_indications & PENDING_LEAVE) != 0)
+    {
+      send_leave_indication(avb, st, st->four_vector_parameter);
+    }
+    st->pending_indications = 0;
+  }
+
+  avb_control_deadline_clear(AVB_CONTROL_MRP);
+  for (int i=0; i < MRP_NUM_PORTS; i++)
+  {
+    avb_control_deadline_timer(AVB_CONTROL_MRP, &periodic_timer[i]);
+    avb_control_deadline_timer(AVB_CONTROL_MRP, &joinTimer[i]);
   #ifdef MRP_FULL_PARTICIPANT
-      if (avb_timer_expired(&attrs[j].leaveTimer))
-      {
-        mrp_update_state(MRP_EVENT_LEAVETIMER, &attrs[j], 0, i);
-      }
+    avb_control_deadline_timer(AVB_CONTROL_MRP, &msrp_leaveall_timer[i]);
+    avb_control_deadline_timer(AVB_CONTROL_MRP, &mvrp_leaveall_timer[i]);
   #endif
-    }
   }
+#ifdef MRP_FULL_PARTICIPANT
+  // The leave queue is in expiry order, so only its head can be next
+  if (leave_queue != NULL)
+  {
+    avb_control_deadline_timer(AVB_CONTROL_MRP, &leave_queue->leaveTimer);
+  }
+#endif
   return;
 }
 
@@ -1239,75 +1545,123 @@ int mrp_is_observer(mrp_attribute_state *st)
 }
 
 mrp_attribute_state *mrp_match_type_non_prop_attribute(int attr_type, unsigned stream_id[2], int port_num) {
-  for (int j=0;j<MRP_MAX_ATTRS;j++) {
-    if (attrs[j].applicant_state == MRP_UNUSED || attrs[j].applicant_state == MRP_DISABLED) {
+  mrp_attribute_state *match = NULL;
+  unsigned long long key = stream_id_key(stream_id);
+
+  for (int p=0;p<MRP_NUM_PORTS;p++) {
+    if (port_num != -1 && p != port_num) {
+      continue;
+    }
+    for (mrp_attribute_state *st = index_bucket(attr_type, p, key); st != NULL; st = st->index_next) {
+      if (st->applicant_state == MRP_UNUSED || st->applicant_state == MRP_DISABLED) {
+        continue;
+      }
+      if (attr_type == st->attribute_type &&
+          !st->propagated &&
+          st->port_num == p)
+      {
+        avb_srp_info_t *reservation = (avb_srp_info_t *) st->attribute_info;
+
+        if (reservation == NULL) continue;
+
+        if (reservation->stream_id[0] == stream_id[0] &&
+            reservation->stream_id[1] == stream_id[1])
+        {
+          match = prefer_attr(match, st);
+        }
+      }
+    }
+  }
+  return match;
+}
+
+
+// Matches the Talker Advertise or Talker Failed attribute of a stream on a
+// port, whether it originated here, was registered or was propagated
+mrp_attribute_state *mrp_match_talker_by_stream_id(unsigned stream_id[2], int port_num) {
+  mrp_attribute_state *match = NULL;
+  unsigned long long key = stream_id_key(stream_id);
+
+  for (mrp_attribute_state *st = index_bucket(MSRP_TALKER_ADVERTISE, port_num, key); st != NULL; st = st->index_next) {
+    if (st->applicant_state == MRP_UNUSED || st->applicant_state == MRP_DISABLED) {
       continue;
     }
-    if (attr_type == attrs[j].attribute_type &&
-        !attrs[j].propagated &&
-        (port_num == -1 || attrs[j].port_num == port_num))
+    if (index_type(st->attribute_type) == MSRP_TALKER_ADVERTISE &&
+        st->port_num == port_num)
     {
-      avb_srp_info_t *reservation = (avb_srp_info_t *) attrs[j].attribute_info;
+      avb_srp_info_t *reservation = (avb_srp_info_t *) st->attribute_info;
 
       if (reservation == NULL) continue;
 
       if (reservation->stream_id[0] == stream_id[0] &&
           reservation->stream_id[1] == stream_id[1])
       {
-          return &attrs[j];
+        match = prefer_attr(match, st);
       }
     }
   }
-  return 0;
+  return match;
 }
 
-
 mrp_attribute_state *mrp_match_attr_by_stream_and_type(mrp_attribute_state *attr, int opposite_port, int match_disabled)
 {
-  for (int j=0;j<MRP_MAX_ATTRS;j++) {
-    if (attrs[j].applicant_state == MRP_UNUSED || (!match_disabled && attrs[j].applicant_state == MRP_DISABLED)) {
+  mrp_attribute_state *match = NULL;
+  avb_sink_info_t *sink_info = (avb_sink_info_t *) attr->attribute_info;
+
+  if (sink_info == NULL) return 0;
+
+  unsigned long long key = stream_id_key(sink_info->reservation.stream_id);
+
+  for (int p=0;p<MRP_NUM_PORTS;p++) {
+    if ((opposite_port && (attr->port_num == p)) ||
+        (!opposite_port && (attr->port_num != p))) {
       continue;
     }
-    if ((opposite_port && (attr->port_num != attrs[j].port_num)) ||
-        (!opposite_port && (attr->port_num == attrs[j].port_num)))
-    {
-      if ((attr->attribute_type == attrs[j].attribute_type) ||
-          ((attr->attribute_type == MSRP_TALKER_ADVERTISE) && (attrs[j].attribute_type == MSRP_TALKER_FAILED)) ||
-          ((attr->attribute_type == MSRP_TALKER_FAILED) && (attrs[j].attribute_type == MSRP_TALKER_ADVERTISE)))
+    for (mrp_attribute_state *st = index_bucket(attr->attribute_type, p, key); st != NULL; st = st->index_next) {
+      if (st->applicant_state == MRP_UNUSED || (!match_disabled && st->applicant_state == MRP_DISABLED)) {
+        continue;
+      }
+      // Talker Advertise and Failed share an index type so this also matches one against the other
+      if (st->port_num == p && index_type(attr->attribute_type) == index_type(st->attribute_type))
       {
-        avb_sink_info_t *sink_info = (avb_sink_info_t *) attr->attribute_info;
-        avb_source_info_t *source_info = (avb_source_info_t *) attrs[j].attribute_info;
+        avb_source_info_t *source_info = (avb_source_info_t *) st->attribute_info;
 
-        if (sink_info == NULL || source_info == NULL) continue;
+        if (source_info == NULL) continue;
 
         if (sink_info->reservation.stream_id[0] == source_info->reservation.stream_id[0] &&
             sink_info->reservation.stream_id[1] == source_info->reservation.stream_id[1])
         {
-            return &attrs[j];
+          match = prefer_attr(match, st);
         }
       }
     }
   }
-  return 0;
+  return match;
 }
 
 int mrp_match_multiple_attrs_by_stream_and_type(mrp_attribute_state *attr, int opposite_port)
 {
   int matches = 0;
+  avb_sink_info_t *sink_info = (avb_sink_info_t *) attr->attribute_info;
+
+  if (sink_info == NULL) return 0;
 
-  for (int j=0;j<MRP_MAX_ATTRS;j++) {
-    if (attrs[j].applicant_state == MRP_UNUSED || attrs[j].applicant_state == MRP_DISABLED) {
+  unsigned long long key = stream_id_key(sink_info->reservation.stream_id);
+
+  for (int p=0;p<MRP_NUM_PORTS;p++) {
+    if ((opposite_port && (attr->port_num == p)) ||
+        (!opposite_port && (attr->port_num != p))) {
       continue;
     }
-    if (attr->attribute_type == attrs[j].attribute_type)
-    {
-      avb_sink_info_t *sink_info = (avb_sink_info_t *) attr->attribute_info;
-      avb_source_info_t *source_info = (avb_source_info_t *) attrs[j].attribute_info;
-
-      if ((opposite_port && (attr->port_num != attrs[j].port_num)) ||
-          (!opposite_port && (attr->port_num == attrs[j].port_num))) {
+    for (mrp_attribute_state *st = index_bucket(attr->attribute_type, p, key); st != NULL; st = st->index_next) {
+      if (st->applicant_state == MRP_UNUSED || st->applicant_state == MRP_DISABLED) {
+        continue;
+      }
+      if (st->port_num == p && attr->attribute_type == st->attribute_type)
+      {
+        avb_source_info_t *source_info = (avb_source_info_t *) st->attribute_info;
 
-        if (sink_info == NULL || source_info == NULL) continue;
+        if (source_info == NULL) continue;
 
         if (sink_info->reservation.stream_id[0] == source_info->reservation.stream_id[0] &&
             sink_info->reservation.stream_id[1] == source_info->reservation.stream_id[1])
@@ -1327,39 +1681,52 @@ int mrp_match_multiple_attrs_by_stream_and_type(mrp_attribute_state *attr, int o
 
 mrp_attribute_state *mrp_match_attribute_pair_by_stream_id(mrp_attribute_state *attr, int opposite_port, int match_disabled)
 {
-  for (int j=0;j<MRP_MAX_ATTRS;j++) {
-    if (attrs[j].applicant_state == MRP_UNUSED || (!match_disabled && attrs[j].applicant_state == MRP_DISABLED)) {
+  mrp_attribute_state *match = NULL;
+  avb_sink_info_t *sink_info = (avb_sink_info_t *) attr->attribute_info;
+  int pair_type;
+
+  if (attr->attribute_type == MSRP_TALKER_ADVERTISE || attr->attribute_type == MSRP_TALKER_FAILED)
+    pair_type = MSRP_LISTENER;
+  else if (attr->attribute_type == MSRP_LISTENER)
+    pair_type = MSRP_TALKER_ADVERTISE;
+  else
+    return 0;
+
+  if (sink_info == NULL) return 0;
+
+  unsigned long long key = stream_id_key(sink_info->reservation.stream_id);
+
+  for (int p=0;p<MRP_NUM_PORTS;p++) {
+    if ((opposite_port && (attr->port_num == p)) ||
+        (!opposite_port && (attr->port_num != p))) {
       continue;
     }
-    if ((opposite_port && (attr->port_num != attrs[j].port_num)) ||
-        (!opposite_port && (attr->port_num == attrs[j].port_num)))
-    {
-      if (((attr->attribute_type == MSRP_TALKER_ADVERTISE || attr->attribute_type == MSRP_TALKER_FAILED) &&
-            attrs[j].attribute_type == MSRP_LISTENER) ||
-          (attr->attribute_type == MSRP_LISTENER &&
-          (attrs[j].attribute_type == MSRP_TALKER_ADVERTISE || attrs[j].attribute_type == MSRP_TALKER_FAILED)))
+    for (mrp_attribute_state *st = index_bucket(pair_type, p, key); st != NULL; st = st->index_next) {
+      if (st->applicant_state == MRP_UNUSED || (!match_disabled && st->applicant_state == MRP_DISABLED)) {
+        continue;
+      }
+      if (st->port_num == p && index_type(st->attribute_type) == pair_type)
       {
-        avb_sink_info_t *sink_info = (avb_sink_info_t *) attr->attribute_info;
-        avb_source_info_t *source_info = (avb_source_info_t *) attrs[j].attribute_info;
-
-        if (sink_info == NULL || source_info == NULL) continue;
+        avb_source_info_t *source_info = (avb_source_info_t *) st->attribute_info;
 
+        if (source_info == NULL) continue;
 
         if (sink_info->reservation.stream_id[0] == source_info->reservation.stream_id[0] &&
             sink_info->reservation.stream_id[1] == source_info->reservation.stream_id[1])
         {
-          return &attrs[j];
+          match = prefer_attr(match, st);
         }
       }
     }
   }
-  return 0;
+  return match;
 }
 
 static int match_attribute_of_same_type(mrp_attribute_type attr_type,
               mrp_attribute_state *attr,
               char *msg,
               int i,
+              srp_stream_value *value,
               int three_packed_event,
               int four_packed_event,
               unsigned int port_num,
@@ -1382,11 +1749,11 @@ static int match_attribute_of_same_type(mrp_attribute_type attr_type,
 
   switch (attr_type) {
   case MSRP_TALKER_ADVERTISE:
-    return avb_srp_match_talker_advertise(attr, msg, i, leave_all, 0);
+    return avb_srp_match_talker_advertise(attr, value, msg, leave_all, 0);
   case MSRP_TALKER_FAILED:
-    return avb_srp_match_talker_advertise(attr, msg, i, leave_all, 1);
+    return avb_srp_match_talker_advertise(attr, value, msg, leave_all, 1);
   case MSRP_LISTENER:
-    return avb_srp_match_listener(attr, msg, i, four_packed_event);
+    return avb_srp_match_listener(attr, value, four_packed_event);
   case MSRP_DOMAIN_VECTOR:
     return avb_srp_match_domain(attr, msg, i);
   case MVRP_VID_VECTOR:
@@ -1398,6 +1765,25 @@ static int match_attribute_of_same_type(mrp_attribute_type attr_type,
 }
 
 
+// The key of the i'th value of a received vector, matching attribute_key()
+static unsigned long long first_value_key(int attr_type, char *fv, int i, srp_stream_value *value)
+{
+  switch (attr_type)
+  {
+    case MSRP_TALKER_ADVERTISE:
+    case MSRP_TALKER_FAILED:
+    case MSRP_LISTENER:
+      return value->stream_id;
+    case MVRP_VID_VECTOR:
+    {
+      mvrp_vid_vector_first_value *first_value = (mvrp_vid_vector_first_value *) fv;
+      return (first_value->vlan[0] << 8) + first_value->vlan[1] + i;
+    }
+    default:
+      return 0;
+  }
+}
+
 static int decode_threepacked(int vector, int i)
 {
   for (int j=0;j<(2-i);j++)
@@ -1418,6 +1804,11 @@ void avb_mrp_process_packet(unsigned char *buf, int etype, int len, unsigned int
   char *msg = (char *) &buf[0] + sizeof(mrp_header);
   mrp_header *hdr = (mrp_header *)&buf[0];
   unsigned char protocol_version = hdr->ProtocolVersion;
+  srp_stream_value stream_values[AVB_SRP_DECODE_BATCH_SIZE];
+
+  // Received declarations can change the failure state of this port's Talkers
+  if (etype == AVB_SRP_ETHERTYPE && port_num < MRP_NUM_PORTS)
+    talker_domain_check[port_num] = 1;
 
   while (msg < end && (msg[0]!=0 || msg[1]!=0))
   {
@@ -1469,6 +1860,18 @@ void avb_mrp_process_packet(unsigned char *buf, int etype, int len, unsigned int
       for (int i=0;i<numvalues;i++)
       {
         int matched_attribute = 0;
+        srp_stream_value *value = NULL;
+
+        // Talker and Listener values are unpacked from the FirstValue a batch at a time
+        if (attr_type <= MSRP_LISTENER) {
+          if ((i % AVB_SRP_DECODE_BATCH_SIZE) == 0) {
+            int num = numvalues - i;
+            if (num > AVB_SRP_DECODE_BATCH_SIZE) num = AVB_SRP_DECODE_BATCH_SIZE;
+            avb_srp_decode_stream_values(attr_type, first_value, i, num, stream_values);
+          }
+          value = &stream_values[i % AVB_SRP_DECODE_BATCH_SIZE];
+        }
+
         // Get the three packed data out of the vector
         int vector = *(first_value + first_value_len + i/3);
         if (vector > 0xD7) break; // Unused range of the threepacked vector should be rejected before decoding
@@ -1483,14 +1886,19 @@ void avb_mrp_process_packet(unsigned char *buf, int etype, int len, unsigned int
           debug_printf("IN: %s\n", debug_attribute_type[attr_type]);
         }
 
-        // This allows the application state machines to respond to the message
-        for (int j=0;j<MRP_MAX_ATTRS;j++)
+        // This allows the application state machines to respond to the message.
+        // Only the attributes indexed under this value's key can match it.
+        mrp_attribute_state *next;
+        for (mrp_attribute_state *st = index_bucket(attr_type, port_num, first_value_key(attr_type, first_value, i, value));
+             st != NULL;
+             st = next)
         {
+          next = st->index_next;
           // Attempt to match to this endpoint's attributes
-          if (match_attribute_of_same_type(attr_type, &attrs[j], first_value, i, three_packed_event, four_packed_event, port_num, leave_all))
+          if (match_attribute_of_same_type(attr_type, st, first_value, i, value, three_packed_event, four_packed_event, port_num, leave_all))
           {
             matched_attribute = 1;
-            mrp_in(three_packed_event, four_packed_event, &attrs[j], port_num);
+            mrp_in(three_packed_event, four_packed_event, st, port_num);
           }
         }
 
@@ -1502,7 +1910,7 @@ void avb_mrp_process_packet(unsigned char *buf, int etype, int len, unsigned int
               {
                 if (three_packed_event != MRP_ATTRIBUTE_EVENT_MT)
                 {
-                  mrp_attribute_state *st = avb_srp_process_new_attribute_from_packet(attr_type, first_value, i, port_num);
+                  mrp_attribute_state *st = avb_srp_process_new_attribute_from_packet(attr_type, value, first_value, port_num);
                   if (st) {
                     mrp_mad_begin(st);
 
@@ -29,13 +29,24 @@
 #if MRP_NUM_PORTS == 1
 // There are 3 attributes per stream (talker_advertise, talker_failed
 // and listener). Therefore the number of attributes needed is:
-// (nTalkers * 3) + (nListeners * 3) + (nDomains=1) + AVB_MAX_NUM_VLAN + AVB_MAX_MMRP_GROUPS
-#define MRP_MAX_ATTRS ((3*(AVB_NUM_SOURCES)) + (3*(AVB_NUM_SINKS)) + 1 + (AVB_MAX_NUM_VLAN))
+// (nTalkers * 3) + (nListeners * 3) + (nDomains=2) + AVB_MAX_NUM_VLAN + AVB_MAX_MMRP_GROUPS
+#define MRP_MAX_ATTRS ((3*(AVB_NUM_SOURCES)) + (3*(AVB_NUM_SINKS)) + 2 + (AVB_MAX_NUM_VLAN))
 #else
-#define MRP_MAX_ATTRS (12*4+4)
+#define MRP_MAX_ATTRS (12*4+6)
 #endif
 #endif
 
+// Number of buckets in the attribute index used to match received attributes.
+// Attributes are hashed on (attribute type, port, stream ID or VID) so this
+// should be a power of two of roughly the same order as MRP_MAX_ATTRS.
+#ifndef MRP_ATTR_INDEX_BUCKETS
+#define MRP_ATTR_INDEX_BUCKETS 64
+#endif
+
+#if (MRP_ATTR_INDEX_BUCKETS & (MRP_ATTR_INDEX_BUCKETS - 1)) != 0
+#error "MRP_ATTR_INDEX_BUCKETS must be a power of two"
+#endif
+
 #define MRP_DEBUG_ATTR_EGRESS 0
 #define MRP_DEBUG_ATTR_INGRESS 0
 
@@ -103,6 +114,13 @@ void mrp_debug_dump_attrs(void);
 */
 void mrp_init(char macaddr[]);
 
+/** Function: mrp_get_bridge_id
+
+   Fills in the 8 byte Bridge ID reported as the FailureBridgeId of the
+   Talker Failed attributes declared by this device.
+*/
+void mrp_get_bridge_id(unsigned char bridge_id[8]);
+
 #ifndef __XC__
 
 /** Function: mrp_attribute_init
@@ -160,6 +178,8 @@ void mrp_mad_leave(mrp_attribute_state *st);
 
 mrp_attribute_state *mrp_match_type_non_prop_attribute(int attr_type, unsigned stream_id[2], int port_num);
 
+mrp_attribute_state *mrp_match_talker_by_stream_id(unsigned stream_id[2], int port_num);
+
 mrp_attribute_state *mrp_match_attr_by_stream_and_type(mrp_attribute_state *attr, int opposite_port, int match_disabled);
 int mrp_match_multiple_attrs_by_stream_and_type(mrp_attribute_state *attr, int opposite_port);
 mrp_attribute_state *mrp_match_attribute_pair_by_stream_id(mrp_attribute_state *attr, int opposite_port, int match_disabled);
@@ -167,11 +187,19 @@ mrp_attribute_state *mrp_match_attribute_pair_by_stream_id(mrp_attribute_state *
 int mrp_is_observer(mrp_attribute_state *st);
 
 
+//!@{
+//! \name Access to the 13 bit NumberOfValues field of a vector header
+int mrp_vector_num_values(char *vec);
+void mrp_vector_set_num_values(char *vec, int num_values);
+//!@}
+
 void mrp_encode_three_packed_event(char *buf,
+                                   char *vec,
                                    int event,
                                    mrp_attribute_type attr);
 
 void mrp_encode_four_packed_event(char *buf,
+                                  char *vec,
                                   int event,
                                   mrp_attribute_type attr);
 
@@ -97,9 +97,31 @@ typedef struct mrp_attribute_state {
   //! then the parameter is stored here
   short four_vector_parameter;
 
-  //! While sorting the attributes, this contains a linked list of sorted attributes
+  //! Next attribute of the same type in transmit order
   struct mrp_attribute_state *next;
 
+  //! Set while the attribute is linked into its type's transmit list
+  char tx_listed;
+
+  //! Next attribute in the same bucket of the attribute index
+  struct mrp_attribute_state *index_next;
+
+  //! The attribute index bucket this attribute is linked into, or -1 if not indexed
+  short index_bucket;
+
+  //! Next attribute with indications waiting to be delivered
+  struct mrp_attribute_state *pending_next;
+
+  //! Set while the attribute is linked into the pending indication list
+  char pending_listed;
+#ifdef MRP_FULL_PARTICIPANT
+  //! Next attribute in the leave timer queue
+  struct mrp_attribute_state *leave_next;
+
+  //! Set while the attribute is linked into the leave timer queue
+  char leave_listed;
+#endif
+
   //! Attribute originated on this participant
   char here;
 
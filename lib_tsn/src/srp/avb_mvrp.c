@@ -4,62 +4,111 @@
 #include "avb_mrp.h"
 #include "avb_mrp_pdu.h"
 #include "avb_mvrp_pdu.h"
+#include "avb_srp_snapshot.h"
 #include <xccompat.h>
+#include <string.h>
 #include "debug_print.h"
 
 
 struct mvrp_entry {
   int active;
+  int provisional; // Joined from the snapshot and not yet joined again since
   mrp_attribute_state *attr;
   int vlan;
 };
 
 static struct mvrp_entry entries[AVB_MAX_NUM_VLAN*MRP_NUM_PORTS];
 
+// One bit per VID for each port, set while the VID has an active entry on that port
+static unsigned int vlan_member[MRP_NUM_PORTS][AVB_MVRP_NUM_VIDS/32];
+
+static int vlan_is_member(int vlan, int port_num)
+{
+  return (vlan_member[port_num][vlan >> 5] >> (vlan & 31)) & 1;
+}
+
+static void set_vlan_member(int vlan, int port_num, int member)
+{
+  if (member)
+    vlan_member[port_num][vlan >> 5] |= (1 << (vlan & 31));
+  else
+    vlan_member[port_num][vlan >> 5] &= ~(1 << (vlan & 31));
+}
+
+static struct mvrp_entry *find_active_entry(int vlan, int port_num)
+{
+  for (int i=port_num*AVB_MAX_NUM_VLAN;i<(port_num+1)*AVB_MAX_NUM_VLAN;i++) {
+    if (entries[i].active && (entries[i].vlan == vlan))
+      return &entries[i];
+  }
+  return NULL;
+}
+
 void avb_mvrp_init(void)
 {
   for (int j=0;j<MRP_NUM_PORTS;j++) {
+    for (int i=0;i<AVB_MVRP_NUM_VIDS/32;i++) {
+      vlan_member[j][i] = 0;
+    }
     for (int i=0;i<AVB_MAX_NUM_VLAN;i++) {
       const int idx = j*AVB_MAX_NUM_VLAN+i;
       entries[idx].active = 0;
+      entries[idx].provisional = 0;
       entries[idx].attr = mrp_get_attr();
       mrp_attribute_init(entries[idx].attr, MVRP_VID_VECTOR, j, 1, &entries[idx].vlan);
     }
   }
 }
 
+int avb_mvrp_vlan_is_member(int vlan, int port_num)
+{
+  if (vlan < 0 || vlan >= AVB_MVRP_NUM_VIDS || port_num < 0 || port_num >= MRP_NUM_PORTS)
+    return 0;
+  return vlan_is_member(vlan, port_num);
+}
+
 int avb_join_vlan(int vlan, int port_num)
 {
-  int found = -1;
+  struct mvrp_entry *found = NULL;
 
-  for (int i=0;i<AVB_MAX_NUM_VLAN*MRP_NUM_PORTS;i++) {
-    if (entries[i].active && (entries[i].vlan == vlan) && (entries[i].attr->port_num == port_num))
-      found = i;
+  if (vlan < 0 || vlan >= AVB_MVRP_NUM_VIDS || port_num < 0 || port_num >= MRP_NUM_PORTS)
+    return 0;
+
+  // Joining a VID that is already declared on the port leaves it as it is,
+  // other than confirming a VID restored from the snapshot
+  if (vlan_is_member(vlan, port_num)) {
+    found = find_active_entry(vlan, port_num);
+    if (found) {
+      found->provisional = 0;
+      return 1;
+    }
   }
 
-  if (found == -1) {
-    for (int i=0;i<AVB_MAX_NUM_VLAN*MRP_NUM_PORTS;i++) {
-      if (!entries[i].active && (entries[i].attr->port_num == port_num)) {
-        found = i;
-        break;
-      }
+  // Entries are allocated per port, so only this port's entries are searched
+  for (int i=port_num*AVB_MAX_NUM_VLAN;i<(port_num+1)*AVB_MAX_NUM_VLAN;i++) {
+    if (!entries[i].active) {
+      found = &entries[i];
+      break;
     }
   }
 
-  if (found == -1) {
-    for (int i=0;i<AVB_MAX_NUM_VLAN*MRP_NUM_PORTS;i++) {
-      if (entries[i].active && mrp_is_observer(entries[i].attr) && (entries[i].attr->port_num == port_num)) {
-        found = i;
+  if (!found) {
+    for (int i=port_num*AVB_MAX_NUM_VLAN;i<(port_num+1)*AVB_MAX_NUM_VLAN;i++) {
+      if (mrp_is_observer(entries[i].attr)) {
+        found = &entries[i];
+        set_vlan_member(found->vlan, port_num, 0);
         break;
       }
     }
   }
 
-  if (found != -1) {
-    entries[found].active = 1;
-    entries[found].vlan = vlan;
-    mrp_mad_begin(entries[found].attr);
-    mrp_mad_join(entries[found].attr, 1);
+  if (found) {
+    found->active = 1;
+    found->provisional = 0;
+    found->vlan = vlan;
+    set_vlan_member(vlan, port_num, 1);
+    mrp_mad_begin(found->attr);
+    mrp_mad_join(found->attr, 1);
     debug_printf("MVRP: Joined VID %d\n", vlan);
     return 1;
   }
@@ -69,54 +118,117 @@ int avb_join_vlan(int vlan, int port_num)
 
 void avb_leave_vlan(int vlan)
 {
-  int found = -1;
+  if (vlan < 0 || vlan >= AVB_MVRP_NUM_VIDS)
+    return;
+
+  for (int port_num=0;port_num<MRP_NUM_PORTS;port_num++) {
+    if (!vlan_is_member(vlan, port_num))
+      continue;
+
+    struct mvrp_entry *found = find_active_entry(vlan, port_num);
+    if (found) {
+      mrp_mad_leave(found->attr);
+      debug_printf("MVRP: Left VID %d\n", vlan);
+      found->active = 0;
+      set_vlan_member(vlan, port_num, 0);
+    }
+  }
+}
+
+void avb_mvrp_snapshot_restore_vlan(int vlan, int port_num)
+{
+  if (avb_join_vlan(vlan, port_num)) {
+    struct mvrp_entry *found = find_active_entry(vlan, port_num);
+    if (found)
+      found->provisional = 1;
+  }
+}
+
+int avb_mvrp_snapshot_provisional(void)
+{
   for (int i=0;i<AVB_MAX_NUM_VLAN*MRP_NUM_PORTS;i++) {
-    if (entries[i].active && (entries[i].vlan == vlan))
-      found = i;
+    if (entries[i].active && entries[i].provisional)
+      return 1;
   }
+  return 0;
+}
+
+// Withdraws the restored VIDs that no stream has joined since the restart
+void avb_mvrp_snapshot_age_out(void)
+{
+  for (int i=0;i<AVB_MAX_NUM_VLAN*MRP_NUM_PORTS;i++) {
+    struct mvrp_entry *entry = &entries[i];
 
-  if (found != -1) {
-    mrp_mad_leave(entries[found].attr);
-    debug_printf("MVRP: Left VID %d\n", vlan);
-    entries[found].active = 0;
+    if (!entry->active || !entry->provisional)
+      continue;
+
+    debug_printf("MVRP: Restored VID %d not confirmed\n", entry->vlan);
+    mrp_mad_leave(entry->attr);
+    entry->active = 0;
+    entry->provisional = 0;
+    set_vlan_member(entry->vlan, entry->attr->port_num, 0);
+  }
+}
+
+int avb_mvrp_snapshot_collect(srp_snapshot_record records[], int max_records)
+{
+  int n = 0;
+
+  for (int i=0;i<AVB_MAX_NUM_VLAN*MRP_NUM_PORTS && n < max_records;i++) {
+    if (!entries[i].active)
+      continue;
+    memset(&records[n], 0, sizeof(srp_snapshot_record));
+    records[n].type = SRP_SNAPSHOT_VLAN;
+    records[n].port_num = entries[i].attr->port_num;
+    records[n].vlan_id = entries[i].vlan;
+    n++;
   }
+
+  return n;
 }
 
 int avb_mvrp_merge_message(char *buf,
+                          char *vec,
                           mrp_attribute_state *st,
                           int vector)
 {
-   mrp_msg_header *mrp_hdr = (mrp_msg_header *) buf;
-  mrp_vector_header *hdr =
-    (mrp_vector_header *) (buf + sizeof(mrp_msg_header));
+  mrp_msg_header *mrp_hdr = (mrp_msg_header *) buf;
   int merge = 0;
   int num_values;
+  mvrp_vid_vector_first_value *first_value =
+    (mvrp_vid_vector_first_value *) (vec + sizeof(mrp_vector_header));
+  int *vlan = (int*) st->attribute_info;
+
   if (mrp_hdr->AttributeType != AVB_MVRP_VID_VECTOR_ATTRIBUTE_TYPE)
     return 0;
 
-  num_values = hdr->NumberOfValuesLow;
+  num_values = mrp_vector_num_values(vec);
 
   if (num_values == 0)
     merge = 1;
+  else
+    merge = (((first_value->vlan[0] << 8) + first_value->vlan[1] + num_values) == *vlan);
 
   if (merge) {
-    mvrp_vid_vector_first_value *first_value =
-      (mvrp_vid_vector_first_value *) (buf + sizeof(mrp_msg_header) + sizeof(mrp_vector_header));
-    int *vlan = (int*) st->attribute_info;
-
-    first_value->vlan[0] = (*vlan >> 8) & 0xff;
-    first_value->vlan[1] = (*vlan) & 0xff;
+    if (num_values == 0) {
+      first_value->vlan[0] = (*vlan >> 8) & 0xff;
+      first_value->vlan[1] = (*vlan) & 0xff;
+    }
 
-    mrp_encode_three_packed_event(buf, vector, st->attribute_type);
+    mrp_encode_three_packed_event(buf, vec, vector, st->attribute_type);
 
-    hdr->NumberOfValuesLow = num_values+1;
+    mrp_vector_set_num_values(vec, num_values+1);
 
   }
 
   return merge;
 }
 
-
+int avb_mvrp_compare_vid_vector_attributes(mrp_attribute_state *a,
+                                           mrp_attribute_state *b)
+{
+  return (*(int*)a->attribute_info < *(int*)b->attribute_info);
+}
 
 int avb_mvrp_match_vid_vector(mrp_attribute_state *attr,
                    char *fv,
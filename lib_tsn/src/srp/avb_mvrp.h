@@ -13,6 +13,9 @@
 #define AVB_MAX_NUM_VLAN 2
 #endif
 
+//! The number of VIDs in the 12-bit VLAN identifier space
+#define AVB_MVRP_NUM_VIDS 4096
+
 //! The MVRP Ethertype
 #define AVB_MVRP_ETHERTYPE (0x88f5)
 
@@ -24,22 +27,34 @@
  *  This function "joins" a virtual lan that is dynamic managed by
  *  the MVRP protocol of the 802.1aj/802.1Qat standard.
  *
- *  The application can join up to ``AVB_MAX_NUM_VLAN`` vlans. This
- *  define defaults to 4 and can be changed in ``avb_conf.h``.
+ *  The application can join up to ``AVB_MAX_NUM_VLAN`` vlans per port. This
+ *  define defaults to 2 and can be changed in ``avb_conf.h``.
+ *
+ *  Joining a vlan that is already joined on the port has no effect.
  *
  *  \param vlan_id            the id of the vlan to join
  *  \param port_num           the port to join the vlan
- *  \returns                  non-zero if sucessful, non-zero otherwise.
+ *  \returns                  non-zero if sucessful, zero otherwise.
  *
  **/
 int avb_join_vlan(int vlan_id, int port_num);
 
+/** Check whether a VLAN is joined on a port.
+ *
+ *  \param vlan_id            the id of the vlan
+ *  \param port_num           the port to check
+ *  \returns                  non-zero if the vlan is joined on the port.
+ */
+int avb_mvrp_vlan_is_member(int vlan_id, int port_num);
+
 /** Leave a VLAN
  *
  *  This function "leaves" a virtual lan that is dynamic managed by
  *  the MVRP protocol of the 802.1aj/802.1Qat standard. After this
  *  call the application will no longer receive traffic on this VLAN.
  *
+ *  The vlan is withdrawn from every port it is joined on.
+ *
  *  \param vlan_id           the id of the vlan to leave.
  *
  */
@@ -54,11 +69,16 @@ void avb_mvrp_init(void);
 #ifndef __XC__
 
 
-//! Callback because MRP is merging some attributes into a Tx packet
+//! Callback because MRP is merging some attributes into a vector of a Tx packet
 int avb_mvrp_merge_message(char *buf,
+                          char *vec,
                           mrp_attribute_state *st,
                            int vector);
 
+//! Callback to order VID attributes so that consecutive VIDs share a vector
+int avb_mvrp_compare_vid_vector_attributes(mrp_attribute_state *a,
+                                           mrp_attribute_state *b);
+
 //! Callback when the MRP module is checking whether an atribute matches something that we are looking for
 int avb_mvrp_match_vid_vector(mrp_attribute_state *attr,
                    char *msg,
@@ -15,6 +15,7 @@
 #include "avb_1722_router.h"
 #include "ethernet.h"
 #include "avb_mvrp.h"
+#include "avb_srp_snapshot.h"
 
 /* This needs to be greater than the actual max number of handled streams, because SRP
    cannot remove the attributes as quickly as a connection can be torn down and setup
@@ -31,24 +32,62 @@
 #endif
 
 static avb_stream_entry stream_table[AVB_STREAM_TABLE_ENTRIES];
-static unsigned int port_bandwidth[MRP_NUM_PORTS];
 
-static mrp_attribute_state *domain_attr[MRP_NUM_PORTS];
+// Bandwidth reserved on each port per SR class, in bits per second
+static unsigned int port_bandwidth[MRP_NUM_PORTS][AVB_SRP_NUM_SR_CLASSES];
+static unsigned int port_link_speed_mbps[MRP_NUM_PORTS];
+
+static const unsigned int sr_class_intervals_per_second[AVB_SRP_NUM_SR_CLASSES] = {
+  AVB_SRP_CLASS_A_INTERVALS_PER_SECOND,
+  AVB_SRP_CLASS_B_INTERVALS_PER_SECOND
+};
+
+static const unsigned int sr_class_delta_bandwidth[AVB_SRP_NUM_SR_CLASSES] = {
+  AVB_SRP_DELTA_BANDWIDTH_CLASS_A,
+  AVB_SRP_DELTA_BANDWIDTH_CLASS_B
+};
+
+typedef struct srp_class_domain {
+  int sr_class;
+  unsigned char id;
+  unsigned char priority;
+} srp_class_domain;
+
+// The SRclassID and SRclassPriority declared in the Domain attribute of each SR class
+static srp_class_domain sr_class_domains[AVB_SRP_NUM_SR_CLASSES] = {
+  { AVB_SR_CLASS_A, AVB_SRP_SRCLASS_DEFAULT, AVB_SRP_TSPEC_PRIORITY_DEFAULT },
+  { AVB_SR_CLASS_B, AVB_SRP_SRCLASS_B, AVB_SRP_TSPEC_PRIORITY_CLASS_B }
+};
+
+static mrp_attribute_state *domain_attr[MRP_NUM_PORTS][AVB_SRP_NUM_SR_CLASSES];
+// One bit per SR class, set while the port is an SRP domain boundary for that class
 unsigned int srp_domain_boundary_port[MRP_NUM_PORTS];
 unsigned int current_vlan_id_from_domain;
+// SR classes restored from the snapshot as in the domain and not yet confirmed
+static unsigned int provisional_domain[MRP_NUM_PORTS];
 
 static unsigned i_eth;
+static unsigned i_eth_cfg;
 
 void srp_store_ethernet_interface(CLIENT_INTERFACE(ethernet_if, i)) {
   i_eth = i;
 }
 
+void srp_store_ethernet_cfg_interface(CLIENT_INTERFACE(ethernet_cfg_if, i)) {
+  i_eth_cfg = i;
+}
+
 void srp_domain_init(void) {
   for(int i=0; i < MRP_NUM_PORTS; i++)
   {
-    domain_attr[i] = mrp_get_attr();
-    mrp_attribute_init(domain_attr[i], MSRP_DOMAIN_VECTOR, i, 1, NULL);
-    srp_domain_boundary_port[i] = 1;
+    for (int j=0; j < AVB_SRP_NUM_SR_CLASSES; j++) {
+      domain_attr[i][j] = mrp_get_attr();
+      mrp_attribute_init(domain_attr[i][j], MSRP_DOMAIN_VECTOR, i, 1, &sr_class_domains[j]);
+      port_bandwidth[i][j] = 0;
+    }
+    srp_domain_boundary_port[i] = (1 << AVB_SRP_NUM_SR_CLASSES) - 1;
+    provisional_domain[i] = 0;
+    port_link_speed_mbps[i] = AVB_SRP_DEFAULT_LINK_SPEED_MBPS;
   }
   current_vlan_id_from_domain = AVB_DEFAULT_VLAN;
 }
@@ -57,33 +96,155 @@ void srp_domain_join(void)
 {
   for (int i=0; i < MRP_NUM_PORTS; i++)
   {
-      mrp_mad_begin(domain_attr[i]);
-      mrp_mad_join(domain_attr[i], 1);
+    for (int j=0; j < AVB_SRP_NUM_SR_CLASSES; j++) {
+      mrp_mad_begin(domain_attr[i][j]);
+      mrp_mad_join(domain_attr[i][j], 1);
+    }
+  }
+}
+
+void srp_set_port_link_speed(int port_num, unsigned link_speed_mbps) {
+  if (port_link_speed_mbps[port_num] != link_speed_mbps) {
+    debug_printf("MSRP: Port %d link speed %d Mbps\n", port_num, link_speed_mbps);
+    port_link_speed_mbps[port_num] = link_speed_mbps;
   }
 }
 
-static int srp_calculate_stream_bandwidth(int max_frame_size, int extra_byte) {
+// The SR class a stream belongs to from the priority in its TSpec, or -1 if
+// the priority is not one mapped to an SR class
+static int srp_stream_sr_class(avb_srp_info_t *reservation) {
+  int priority = (reservation->tspec >> 5) & 7;
+
+  if (priority == AVB_SRP_TSPEC_PRIORITY_DEFAULT) return AVB_SR_CLASS_A;
+  if (priority == AVB_SRP_TSPEC_PRIORITY_CLASS_B) return AVB_SR_CLASS_B;
+  return -1;
+}
+
+int srp_stream_domain_boundary(avb_srp_info_t *reservation, int port_num) {
+  int sr_class = srp_stream_sr_class(reservation);
+
+  if (sr_class < 0) return 1;
+  return (srp_domain_boundary_port[port_num] >> sr_class) & 1;
+}
+
+static unsigned int srp_calculate_stream_bandwidth(avb_srp_info_t *reservation, int sr_class, int extra_byte) {
   const int interframe_gap = 12;
   const int preamble_sfd = 8;
   const int eth_header_and_tag = 18;
   const int crc = 4;
-  const int total_frame_size = interframe_gap + preamble_sfd + eth_header_and_tag + max_frame_size + crc + extra_byte;
+  const int total_frame_size = interframe_gap + preamble_sfd + eth_header_and_tag + reservation->tspec_max_frame_size + crc + extra_byte;
+  unsigned int max_interval_frames = (unsigned short) reservation->tspec_max_interval;
+
+  if (max_interval_frames == 0) max_interval_frames = 1;
+
+  return total_frame_size * 8 * max_interval_frames * sr_class_intervals_per_second[sr_class];
+}
+
+static void srp_update_port_shaper(int port) {
+  unsigned int idle_slope_bps = 0;
+
+  for (int i=0; i < AVB_SRP_NUM_SR_CLASSES; i++) {
+    idle_slope_bps += port_bandwidth[port][i];
+  }
+  srp_set_port_shaper_bandwidth(i_eth_cfg, port, idle_slope_bps);
+}
+
+/* Admission control: a stream is only given bandwidth on a port if, with it
+ * added, the bandwidth reserved for its SR class and each higher priority class
+ * stays within their cumulative deltaBandwidth of the link rate.
+ * Returns 0 once the bandwidth is reserved, otherwise the Talker Failed code.
+ */
+static int srp_increase_port_bandwidth(avb_stream_entry *stream, int extra_byte, int port) {
+  int sr_class = srp_stream_sr_class(&stream->reservation);
+  unsigned long long link_bps = (unsigned long long) port_link_speed_mbps[port] * 1000000;
+  unsigned long long reserved_bps = 0;
+  unsigned int delta_bandwidth = 0;
+  unsigned int stream_bandwidth_bps;
+
+  if (stream->bw_reserved[port]) return 0;
+
+  if (sr_class < 0) {
+    debug_printf("MSRP: Stream %x%x priority is not an SR class\n", stream->reservation.stream_id[0], stream->reservation.stream_id[1]);
+    return AVB_SRP_FAILURE_CODE_INSUFFICIENT_BANDWIDTH_FOR_TRAFFIC_CLASS;
+  }
+
+  stream_bandwidth_bps = srp_calculate_stream_bandwidth(&stream->reservation, sr_class, extra_byte);
+
+  for (int i=0; i < AVB_SRP_NUM_SR_CLASSES; i++) {
+    reserved_bps += port_bandwidth[port][i];
+    delta_bandwidth += sr_class_delta_bandwidth[i];
+    if (i >= sr_class && reserved_bps + stream_bandwidth_bps > link_bps * delta_bandwidth / 100) {
+      debug_printf("MSRP: Insufficient bandwidth on port %d for stream %x%x (%d bps)\n", port,
+                   stream->reservation.stream_id[0], stream->reservation.stream_id[1], stream_bandwidth_bps);
+      return AVB_SRP_FAILURE_CODE_INSUFFICIENT_BANDWIDTH;
+    }
+  }
+
+  stream->bw_reserved[port] = 1;
+  stream->bw_reserved_class[port] = sr_class;
+  stream->bw_reserved_bps[port] = stream_bandwidth_bps;
+  port_bandwidth[port][sr_class] += stream_bandwidth_bps;
+  debug_printf("Increasing port %d class %c bandwidth to %d bps\n", port, 'A' + sr_class, port_bandwidth[port][sr_class]);
+  srp_update_port_shaper(port);
+  return 0;
+}
+
+static void srp_retry_failed_talkers(int port);
 
-  return total_frame_size * 8 * AVB1722_PACKET_RATE;
+static void srp_decrease_port_bandwidth(avb_stream_entry *stream, int port) {
+  int sr_class = stream->bw_reserved_class[port];
+
+  if (!stream->bw_reserved[port]) return;
+
+  port_bandwidth[port][sr_class] -= stream->bw_reserved_bps[port];
+  stream->bw_reserved[port] = 0;
+  stream->bw_reserved_bps[port] = 0;
+  debug_printf("Decreasing port %d class %c bandwidth to %d bps\n", port, 'A' + sr_class, port_bandwidth[port][sr_class]);
+  srp_update_port_shaper(port);
+  srp_retry_failed_talkers(port);
 }
 
-static void srp_increase_port_bandwidth(int max_frame_size, int extra_byte, int port) {
-  int stream_bandwidth_bps = srp_calculate_stream_bandwidth(max_frame_size, extra_byte);
-  port_bandwidth[port] += stream_bandwidth_bps;
-  debug_printf("Increasing port %d shaper bandwidth to %d bps\n", port, port_bandwidth[port]);
-  // mac_set_qav_bandwidth(i_eth, port, port_bandwidth[port]);
+// Changes the Talker declared on a port to Talker Failed when the stream cannot
+// be given bandwidth there
+static void srp_talker_failed_on_port(avb_stream_entry *stream, int port, int failure_code) {
+  mrp_attribute_state *talker = mrp_match_talker_by_stream_id(stream->reservation.stream_id, port);
+
+  if (talker == NULL) return;
+
+  stream->bw_failed[port] = 1;
+
+  if (talker->attribute_type == MSRP_TALKER_FAILED &&
+      stream->reservation.failure_code == failure_code) return;
+
+  debug_printf("Talker Advertise -> Failed for stream %x%x on port %d (failure code: %d)\n",
+               stream->reservation.stream_id[0], stream->reservation.stream_id[1], port, failure_code);
+  talker->attribute_type = MSRP_TALKER_FAILED;
+  stream->reservation.failure_code = failure_code;
+  mrp_get_bridge_id(stream->reservation.failure_bridge_id);
+  mrp_mad_join(talker, 1);
 }
 
-static void srp_decrease_port_bandwidth(int max_frame_size, int extra_byte, int port) {
-  int stream_bandwidth_bps = srp_calculate_stream_bandwidth(max_frame_size, extra_byte);
-  port_bandwidth[port] -= stream_bandwidth_bps;
-   debug_printf("Decreasing port %d shaper bandwidth to %d bps\n", port, port_bandwidth[port]);
-  // mac_set_qav_bandwidth(i_eth, port, port_bandwidth[port]);
+// Once bandwidth has been released on a port, Talkers that failed there for
+// the lack of it are advertised again so that their Listeners can re-request it
+static void srp_retry_failed_talkers(int port) {
+  for (int i=0; i < AVB_STREAM_TABLE_ENTRIES; i++) {
+    avb_stream_entry *stream = &stream_table[i];
+    if (!stream->bw_failed[port]) continue;
+
+    stream->bw_failed[port] = 0;
+
+    mrp_attribute_state *talker = mrp_match_talker_by_stream_id(stream->reservation.stream_id, port);
+    if (talker && talker->attribute_type == MSRP_TALKER_FAILED &&
+        (stream->reservation.failure_code == AVB_SRP_FAILURE_CODE_INSUFFICIENT_BANDWIDTH ||
+         stream->reservation.failure_code == AVB_SRP_FAILURE_CODE_INSUFFICIENT_BANDWIDTH_FOR_TRAFFIC_CLASS)) {
+      debug_printf("Talker Failed -> Advertise for stream %x%x on port %d\n",
+                   stream->reservation.stream_id[0], stream->reservation.stream_id[1], port);
+      talker->attribute_type = MSRP_TALKER_ADVERTISE;
+      stream->reservation.failure_code = 0;
+      memset(stream->reservation.failure_bridge_id, 0, 8);
+      mrp_mad_join(talker, 1);
+    }
+  }
 }
 
 int avb_srp_match_listener_to_talker_stream_id(unsigned stream_id[2], avb_srp_info_t **stream, int is_listener)
@@ -147,13 +308,14 @@ avb_stream_entry *srp_add_reservation_entry(avb_srp_info_t *reservation) {
     memcpy(&stream_table[entry].reservation, reservation, reservation_size_minus_failure_info);
     debug_printf("Added stream:\n ID: %x%x\n DA:", reservation->stream_id[0], reservation->stream_id[1]);
     for (int i=0; i < 6; i++) {
-      printhex(stream_table[entry].reservation.dest_mac_addr[i]); printchar(':');
+      debug_printf("%x:", stream_table[entry].reservation.dest_mac_addr[i]);
     }
     debug_printf("\n max size: %d\n interval: %d\n",
                 stream_table[entry].reservation.tspec_max_frame_size,
                 stream_table[entry].reservation.tspec_max_interval
                 );
     stream_table[entry].talker_present = 1;
+    stream_table[entry].provisional_talker = 0;
   } else {
     debug_printf("Assert: Out of stream entries\n");
     return NULL;
@@ -167,6 +329,9 @@ void srp_remove_reservation_entry(avb_srp_info_t *reservation) {
 
   if (entry >= 0) {
     debug_printf("Removed stream:\n ID: %x%x\n", reservation->stream_id[0], reservation->stream_id[1]);
+    for (int i=0; i < MRP_NUM_PORTS; i++) {
+      srp_decrease_port_bandwidth(&stream_table[entry], i);
+    }
     memset(&stream_table[entry], 0x00, sizeof(avb_stream_entry));
   } else {
     debug_printf("Assert: Tried to remove a reservation that isn't stored: %x%d", reservation->stream_id[0], reservation->stream_id[1]);
@@ -199,7 +364,7 @@ int srp_cleanup_reservation_entry(mrp_event event, mrp_attribute_state *st) {
       avb_srp_info_t *attribute_info = st->attribute_info;
       if (attribute_info == NULL) __builtin_trap();
 
-      avb_1722_remove_stream_from_table(i_eth, attribute_info->stream_id);
+      avb_1722_remove_stream_from_table(i_eth_cfg, attribute_info->stream_id);
       srp_remove_reservation_entry(attribute_info);
     }
 
@@ -257,9 +422,13 @@ static void avb_srp_map_join(mrp_attribute_state *attr, int new, int listener)
       if (!matched_talker_listener->here) {
         int entry = srp_match_reservation_entry_by_id(attribute_info->stream_id);
         if (!stream_table[entry].bw_reserved[attr->port_num]) {
-          stream_table[entry].bw_reserved[attr->port_num] = 1;
-          srp_increase_port_bandwidth(attribute_info->tspec_max_frame_size, 1, attr->port_num);
-          avb_1722_enable_stream_forwarding(i_eth, attribute_info->stream_id);
+          int failure_code = srp_increase_port_bandwidth(&stream_table[entry], 1, attr->port_num);
+          if (failure_code) {
+            srp_talker_failed_on_port(&stream_table[entry], attr->port_num, failure_code);
+          }
+          else {
+            avb_1722_enable_stream_forwarding(i_eth_cfg, attribute_info->stream_id);
+          }
         }
       }
       if (matched_stream_id_opposite_port)
@@ -301,9 +470,8 @@ void avb_srp_map_leave(mrp_attribute_state *attr)
     if (matched_stream_id_opposite_port) {
       if (matched_talker_listener && !matched_talker_listener->here) { // We are not the Talker
         if (stream_table[entry].bw_reserved[attr->port_num]) {
-          srp_decrease_port_bandwidth(attribute_info->tspec_max_frame_size, 1, attr->port_num);
-          avb_1722_disable_stream_forwarding(i_eth, attribute_info->stream_id);
-          stream_table[entry].bw_reserved[attr->port_num] = 0;
+          srp_decrease_port_bandwidth(&stream_table[entry], attr->port_num);
+          avb_1722_disable_stream_forwarding(i_eth_cfg, attribute_info->stream_id);
           // Propagate Listener leave only if we are not also Listening to this stream
           if (matched_stream_id_opposite_port->propagated && !matched_stream_id_opposite_port->here)
           {
@@ -322,9 +490,8 @@ void avb_srp_map_leave(mrp_attribute_state *attr)
     int entry = srp_match_reservation_entry_by_id(attribute_info->stream_id);
 
     if (matched_talker_listener && stream_table[entry].bw_reserved[matched_talker_listener->port_num]) {
-      srp_decrease_port_bandwidth(attribute_info->tspec_max_frame_size, 1, matched_talker_listener->port_num);
-      avb_1722_disable_stream_forwarding(i_eth, attribute_info->stream_id);
-      stream_table[entry].bw_reserved[matched_talker_listener->port_num] = 0;
+      srp_decrease_port_bandwidth(&stream_table[entry], matched_talker_listener->port_num);
+      avb_1722_disable_stream_forwarding(i_eth_cfg, attribute_info->stream_id);
     }
 
     if (matched_stream_id_opposite_port) {
@@ -344,35 +511,82 @@ void avb_srp_map_leave(mrp_attribute_state *attr)
   }
 }
 
+static unsigned long long srp_first_value_bytes(unsigned char *bytes, int n)
+{
+  unsigned long long x = 0;
+  for (int i=0;i<n;i++)
+    x = (x << 8) + bytes[i];
+  return x;
+}
+
+void avb_srp_decode_stream_values(int attribute_type,
+                                  char *fv,
+                                  int first,
+                                  int num,
+                                  srp_stream_value values[])
+{
+  srp_talker_first_value *first_value = (srp_talker_first_value *) fv;
+  unsigned long long stream_id = srp_first_value_bytes(first_value->StreamId, 8) + first;
+
+  if (attribute_type == MSRP_LISTENER) {
+    for (int i=0;i<num;i++) {
+      values[i].stream_id = stream_id + i;
+    }
+    return;
+  }
+
+  unsigned long long dest_mac_addr = srp_first_value_bytes(first_value->DestMacAddr, 6) + first;
+  unsigned short vlan_id = ntoh_16(first_value->VlanID);
+  unsigned char tspec = first_value->TSpec;
+
+  for (int i=0;i<num;i++) {
+    values[i].stream_id = stream_id + i;
+    values[i].dest_mac_addr = dest_mac_addr + i;
+    values[i].vlan_id = vlan_id;
+    values[i].tspec = tspec;
+  }
+}
+
+static void srp_reservation_from_value(avb_srp_info_t *reservation,
+                                       srp_stream_value *value,
+                                       srp_talker_first_value *first_value)
+{
+  reservation->stream_id[0] = value->stream_id >> 32;
+  reservation->stream_id[1] = (unsigned) value->stream_id;
+  for (int i=0;i<6;i++)
+    reservation->dest_mac_addr[i] = value->dest_mac_addr >> (8*(5-i));
+  reservation->vlan_id = value->vlan_id;
+  reservation->tspec_max_frame_size = ntoh_16(first_value->TSpecMaxFrameSize);
+  reservation->tspec_max_interval = ntoh_16(first_value->TSpecMaxIntervalFrames);
+  reservation->tspec = value->tspec;
+  reservation->accumulated_latency = ntoh_32(first_value->AccumulatedLatency);
+}
+
+static unsigned long long srp_reservation_stream_id(avb_srp_info_t *reservation)
+{
+  return ((unsigned long long) reservation->stream_id[0] << 32) + reservation->stream_id[1];
+}
+
 int avb_srp_match_talker_advertise(mrp_attribute_state *attr,
+                                   srp_stream_value *value,
                                    char *fv,
-                                   int i,
                                    int leave_all,
                                    int failed)
 {
   avb_source_info_t *source_info = (avb_source_info_t *) attr->attribute_info;
-  unsigned long long stream_id=0, my_stream_id=0;
-  srp_talker_failed_first_value *first_value = (srp_talker_failed_first_value *) fv;
 
   if (source_info == NULL) return 0;
 
-  my_stream_id = source_info->reservation.stream_id[0];
-  my_stream_id = (my_stream_id << 32) + source_info->reservation.stream_id[1];
-
-  for (int i=0;i<8;i++) {
-    stream_id = (stream_id << 8) + first_value->StreamId[i];
-  }
-
-  stream_id += i;
-
-  unsigned char sr_class_priority = (first_value->TSpec >> 5) & 7;
+  int match = (srp_reservation_stream_id(&source_info->reservation) == value->stream_id);
 
 #if MRP_NUM_PORTS == 1
-  if (!leave_all && (my_stream_id == stream_id)) {
-
+  if (!leave_all && match) {
+    srp_talker_failed_first_value *first_value = (srp_talker_failed_first_value *) fv;
     avb_stream_entry *stream_info = attr->attribute_info;
+    unsigned char sr_class_priority = (value->tspec >> 5) & 7;
 
-    if (sr_class_priority != AVB_SRP_TSPEC_PRIORITY_DEFAULT) { // Class A
+    if (sr_class_priority != AVB_SRP_TSPEC_PRIORITY_DEFAULT &&
+        sr_class_priority != AVB_SRP_TSPEC_PRIORITY_CLASS_B) { // Class A or B
       stream_info->reservation_failed = 1;
       return 0;
     }
@@ -390,48 +604,26 @@ int avb_srp_match_talker_advertise(mrp_attribute_state *attr,
       attr->attribute_type = MSRP_TALKER_ADVERTISE;
       if (stream_info->reservation_failed) {
         memset(&source_info->reservation.failure_bridge_id, 0, 8);
-        first_value->FailureCode = 0;
+        source_info->reservation.failure_code = 0;
       }
       stream_info->reservation_failed = 0;
     }
 
-    if (!stream_info->talker_present) {
-      avb_srp_info_t *reservation = &source_info->reservation;
-
-      unsigned long long x;
-      reservation->vlan_id = ntoh_16(first_value->VlanID);
-
-      for(int i=0;i<6;i++)
-        x = (x<<8) + first_value->DestMacAddr[i];
-
-      x += i;
-
-      int tmp = byterev(x);
-      memcpy(&reservation->dest_mac_addr[2], &tmp, 4);
-      tmp = byterev(x>>32)>>16;
-      memcpy(&reservation->dest_mac_addr, &tmp, 2);
-
-      reservation->tspec_max_frame_size = ntoh_16(first_value->TSpecMaxFrameSize);
-      reservation->tspec_max_interval = ntoh_16(first_value->TSpecMaxIntervalFrames);
-      reservation->tspec = first_value->TSpec;
-      reservation->accumulated_latency = ntoh_32(first_value->AccumulatedLatency);
-      srp_add_reservation_entry(reservation);
+    if (!stream_info->talker_present || stream_info->provisional_talker) {
+      srp_reservation_from_value(&source_info->reservation, value, (srp_talker_first_value *) fv);
+      srp_add_reservation_entry(&source_info->reservation);
     }
   }
-
 #endif
 
-  return (my_stream_id == stream_id);
+  return match;
 }
 
 int avb_srp_match_listener(mrp_attribute_state *attr,
-                           char *fv,
-                           int i,
+                           srp_stream_value *value,
                            int four_packed_event)
 {
   avb_sink_info_t *sink_info = (avb_sink_info_t *) attr->attribute_info;
-  unsigned long long stream_id=0, my_stream_id=0;
-  srp_listener_first_value *first_value = (srp_listener_first_value *) fv;
 
   if (sink_info == NULL) {
     return 0;
@@ -441,16 +633,7 @@ int avb_srp_match_listener(mrp_attribute_state *attr,
     return 0;
   }
 
-  my_stream_id = sink_info->reservation.stream_id[0];
-  my_stream_id = (my_stream_id << 32) + sink_info->reservation.stream_id[1];
-
-  for (int i=0;i<8;i++) {
-    stream_id = (stream_id << 8) + first_value->StreamId[i];
-  }
-
-  stream_id += i;
-
-  return (my_stream_id == stream_id);
+  return (srp_reservation_stream_id(&sink_info->reservation) == value->stream_id);
 }
 
 int avb_srp_match_domain(mrp_attribute_state *attr,char *fv,int i)
@@ -460,7 +643,11 @@ int avb_srp_match_domain(mrp_attribute_state *attr,char *fv,int i)
     unsigned char sr_class_priority = first_value->SRclassPriority+i;
     unsigned short sr_class_vid = ntoh_16(first_value->SRclassVID);
 
-    if ((sr_class_id == AVB_SRP_SRCLASS_DEFAULT) && (sr_class_priority == AVB_SRP_TSPEC_PRIORITY_DEFAULT)) {
+    srp_class_domain *domain = attr->attribute_info;
+
+    if (domain == NULL) return 0;
+
+    if ((sr_class_id == domain->id) && (sr_class_priority == domain->priority)) {
       if (current_vlan_id_from_domain != sr_class_vid) {
         current_vlan_id_from_domain = sr_class_vid;
       }
@@ -488,28 +675,33 @@ void avb_srp_listener_join_ind(CLIENT_INTERFACE(avb_interface, avb), mrp_attribu
     int entry = srp_match_reservation_entry_by_id(sink_info->reservation.stream_id);
     int enable_stream = 0;
 
+    stream_table[entry].provisional_listener[attr->port_num] = 0;
+
 #if (MRP_NUM_PORTS == 2)
     if (mrp_match_attr_by_stream_and_type(attr, 1, 0)) { // Listener ready on the other port also, therefore send on both ports
       if (stream_table[entry].bw_reserved[!attr->port_num] == 1 &&
           stream_table[entry].bw_reserved[attr->port_num] != 1) {
-        srp_increase_port_bandwidth(sink_info->reservation.tspec_max_frame_size, 0, attr->port_num);
-        set_avb_source_port(stream, -1);
-        stream_table[entry].bw_reserved[attr->port_num] = 1;
-        enable_stream = 1;
+        int failure_code = srp_increase_port_bandwidth(&stream_table[entry], 0, attr->port_num);
+        if (failure_code) {
+          srp_talker_failed_on_port(&stream_table[entry], attr->port_num, failure_code);
+        }
+        else {
+          set_avb_source_port(stream, -1);
+          enable_stream = 1;
+        }
       }
     }
     else
 #endif
     if (mrp_match_type_non_prop_attribute(MSRP_TALKER_ADVERTISE, sink_info->reservation.stream_id, attr->port_num)){ // Just this port
-      if (stream_table[entry].bw_reserved[attr->port_num] != 1) {
-        srp_increase_port_bandwidth(sink_info->reservation.tspec_max_frame_size, 0, attr->port_num);
-        set_avb_source_port(stream, attr->port_num);
-        stream_table[entry].bw_reserved[attr->port_num] = 1;
+      int failure_code = srp_increase_port_bandwidth(&stream_table[entry], 0, attr->port_num);
+      if (failure_code) {
+        srp_talker_failed_on_port(&stream_table[entry], attr->port_num, failure_code);
       }
       else {
         set_avb_source_port(stream, attr->port_num);
+        enable_stream = 1;
       }
-      enable_stream = 1;
     }
 
 
@@ -537,20 +729,16 @@ void avb_srp_listener_leave_ind(CLIENT_INTERFACE(avb_interface, avb), mrp_attrib
 
   if (stream != -1u) {
     if (stream_table[entry].bw_reserved[attr->port_num] == 1) {
-      srp_decrease_port_bandwidth(sink_info->reservation.tspec_max_frame_size, 0, attr->port_num);
+      srp_decrease_port_bandwidth(&stream_table[entry], attr->port_num);
       if (matched_listener_opposite_port) { // Transmitting on both ports
         set_avb_source_port(stream, !attr->port_num);
       }
-      stream_table[entry].bw_reserved[attr->port_num] = 0;
     }
     avb_get_source_state(avb, stream, &state);
 
     if (state == AVB_SOURCE_STATE_ENABLED && !matched_listener_opposite_port) {
       avb_set_source_state(avb, stream, AVB_SOURCE_STATE_POTENTIAL);
-      if (stream_table[entry].bw_reserved[attr->port_num] == 1) {
-        srp_decrease_port_bandwidth(sink_info->reservation.tspec_max_frame_size, 0, attr->port_num);
-        stream_table[entry].bw_reserved[attr->port_num] = 0;
-      }
+      srp_decrease_port_bandwidth(&stream_table[entry], attr->port_num);
    }
   }
 }
@@ -747,56 +935,26 @@ short avb_srp_join_listener_attrs(unsigned int stream_id[2], short vlan_id) {
 }
 
 
-mrp_attribute_state* avb_srp_process_new_attribute_from_packet(int mrp_attribute_type, char *fv, int num, int port_num)
+mrp_attribute_state* avb_srp_process_new_attribute_from_packet(int mrp_attribute_type, srp_stream_value *value, char *fv, int port_num)
 {
-  srp_talker_first_value *packet = (srp_talker_first_value *) fv;
-  unsigned int pdu_streamId[2];
   avb_stream_entry *stream_ptr = NULL;
 
-  unsigned long long streamId;
-
-  for (int i=0;i<8;i++)
-    streamId = (streamId << 8) + packet->StreamId[i];
-
-  streamId += num;
-
-  pdu_streamId[0] = streamId >> 32;
-  pdu_streamId[1] = (unsigned) streamId;
-
-  avb_srp_info_t reservation;
-
-  reservation.stream_id[0] = pdu_streamId[0];
-  reservation.stream_id[1] = pdu_streamId[1];
-
-
   switch (mrp_attribute_type)
   {
     case MSRP_TALKER_ADVERTISE:
     case MSRP_TALKER_FAILED:
     {
-      unsigned long long x;
-      reservation.vlan_id = ntoh_16(packet->VlanID);
-
-      for(int i=0;i<6;i++)
-        x = (x<<8) + packet->DestMacAddr[i];
-
-      x += num;
-
-      int tmp = byterev(x);
-      memcpy(&reservation.dest_mac_addr[2], &tmp, 4);
-      tmp = byterev(x>>32)>>16;
-      memcpy(&reservation.dest_mac_addr, &tmp, 2);
-
-      reservation.tspec_max_frame_size = ntoh_16(packet->TSpecMaxFrameSize);
-      reservation.tspec_max_interval = ntoh_16(packet->TSpecMaxIntervalFrames);
-      reservation.tspec = packet->TSpec;
-      reservation.accumulated_latency = ntoh_32(packet->AccumulatedLatency);
+      avb_srp_info_t reservation;
+      srp_reservation_from_value(&reservation, value, (srp_talker_first_value *) fv);
       stream_ptr = srp_add_reservation_entry(&reservation);
       break;
     }
     case MSRP_LISTENER:
     {
-      stream_ptr = srp_add_reservation_entry_stream_id_only(pdu_streamId);
+      unsigned int stream_id[2];
+      stream_id[0] = value->stream_id >> 32;
+      stream_id[1] = (unsigned) value->stream_id;
+      stream_ptr = srp_add_reservation_entry_stream_id_only(stream_id);
       break;
     }
     default:
@@ -858,14 +1016,13 @@ void avb_srp_talker_leave_ind(mrp_attribute_state *attr)
   }
 }
 
-static int check_listener_firstvalue_merge(char *buf,
+static int check_listener_firstvalue_merge(char *vec,
                                 avb_sink_info_t *sink_info)
 {
-  mrp_vector_header *hdr = (mrp_vector_header *) (buf + sizeof(mrp_msg_header));
-  int num_values = hdr->NumberOfValuesLow;
+  int num_values = mrp_vector_num_values(vec);
   unsigned long long stream_id=0, my_stream_id=0;
   srp_listener_first_value *first_value =
-    (srp_listener_first_value *) (buf + sizeof(mrp_msg_header) + sizeof(mrp_vector_header));
+    (srp_listener_first_value *) (vec + sizeof(mrp_vector_header));
 
   // check if we can merge
   my_stream_id = sink_info->reservation.stream_id[0];
@@ -887,12 +1044,11 @@ static int check_listener_firstvalue_merge(char *buf,
 
 
 static int encode_listener_message(char *buf,
+                                  char *vec,
                                   mrp_attribute_state *st,
                                   int vector)
 {
   mrp_msg_header *mrp_hdr = (mrp_msg_header *) buf;
-  mrp_vector_header *hdr =
-    (mrp_vector_header *) (buf + sizeof(mrp_msg_header));
   int merge = 0;
   avb_sink_info_t *sink_info = st->attribute_info;
 
@@ -901,17 +1057,17 @@ static int encode_listener_message(char *buf,
   if (mrp_hdr->AttributeType != AVB_SRP_ATTRIBUTE_TYPE_LISTENER)
     return 0;
 
-  num_values = hdr->NumberOfValuesLow;
+  num_values = mrp_vector_num_values(vec);
 
   if (num_values == 0)
     merge = 1;
   else
-    merge = check_listener_firstvalue_merge(buf, sink_info);
+    merge = check_listener_firstvalue_merge(vec, sink_info);
 
 
   if (merge) {
     srp_listener_first_value *first_value =
-      (srp_listener_first_value *) (buf + sizeof(mrp_msg_header) + sizeof(mrp_vector_header));
+      (srp_listener_first_value *) (vec + sizeof(mrp_vector_header));
     unsigned *streamId = sink_info->reservation.stream_id;
     unsigned int streamid;
 
@@ -928,16 +1084,16 @@ static int encode_listener_message(char *buf,
 
     }
 
-    mrp_encode_three_packed_event(buf, vector, st->attribute_type);
+    mrp_encode_three_packed_event(buf, vec, vector, st->attribute_type);
     avb_stream_entry *stream_info = st->attribute_info;
-    if (stream_info->talker_present && !srp_domain_boundary_port[st->port_num] && !stream_info->reservation_failed) {
-      mrp_encode_four_packed_event(buf, AVB_SRP_FOUR_PACKED_EVENT_READY, st->attribute_type);
+    if (stream_info->talker_present && !srp_stream_domain_boundary(&stream_info->reservation, st->port_num) && !stream_info->reservation_failed) {
+      mrp_encode_four_packed_event(buf, vec, AVB_SRP_FOUR_PACKED_EVENT_READY, st->attribute_type);
     }
     else {
-      mrp_encode_four_packed_event(buf, AVB_SRP_FOUR_PACKED_EVENT_ASKING_FAILED, st->attribute_type);
+      mrp_encode_four_packed_event(buf, vec, AVB_SRP_FOUR_PACKED_EVENT_ASKING_FAILED, st->attribute_type);
     }
 
-    hdr->NumberOfValuesLow = num_values+1;
+    mrp_vector_set_num_values(vec, num_values+1);
 
   }
 
@@ -946,8 +1102,10 @@ static int encode_listener_message(char *buf,
 
 void avb_srp_domain_join_ind(CLIENT_INTERFACE(avb_interface, avb), mrp_attribute_state *attr, int new)
 {
-  debug_printf("Joined SRP domain (VID %x, port %d)\n", current_vlan_id_from_domain, attr->port_num);
-  srp_domain_boundary_port[attr->port_num] = 0;
+  srp_class_domain *domain = attr->attribute_info;
+  debug_printf("Joined SRP domain (class %c, VID %x, port %d)\n", 'A' + domain->sr_class, current_vlan_id_from_domain, attr->port_num);
+  srp_domain_boundary_port[attr->port_num] &= ~(1 << domain->sr_class);
+  provisional_domain[attr->port_num] &= ~(1 << domain->sr_class);
 
   for (int i=0; i < AVB_NUM_SOURCES; i++)
   {
@@ -972,22 +1130,224 @@ void avb_srp_domain_join_ind(CLIENT_INTERFACE(avb_interface, avb), mrp_attribute
 
 void avb_srp_domain_leave_ind(CLIENT_INTERFACE(avb_interface, avb), mrp_attribute_state *attr)
 {
-  debug_printf("Left SRP domain (port %d)\n", attr->port_num);
-  srp_domain_boundary_port[attr->port_num] = 1;
+  srp_class_domain *domain = attr->attribute_info;
+  debug_printf("Left SRP domain (class %c, port %d)\n", 'A' + domain->sr_class, attr->port_num);
+  srp_domain_boundary_port[attr->port_num] |= (1 << domain->sr_class);
+}
+
+static void srp_snapshot_reservation(srp_snapshot_record *record, avb_srp_info_t *reservation)
+{
+  record->stream_id[0] = reservation->stream_id[0];
+  record->stream_id[1] = reservation->stream_id[1];
+  memcpy(record->dest_mac_addr, reservation->dest_mac_addr, 6);
+  record->vlan_id = reservation->vlan_id;
+  record->tspec_max_frame_size = reservation->tspec_max_frame_size;
+  record->tspec_max_interval = reservation->tspec_max_interval;
+  record->tspec = reservation->tspec;
+  record->accumulated_latency = reservation->accumulated_latency;
+}
+
+/* Records the Talkers registered for our sinks, the Listener Ready
+ * registrations our sources hold bandwidth for and each port's SRP domain
+ */
+int srp_snapshot_collect(srp_snapshot_record records[], int max_records)
+{
+  int n = 0;
+
+  for (int i=0; i < MRP_NUM_PORTS && n < max_records; i++) {
+    memset(&records[n], 0, sizeof(srp_snapshot_record));
+    records[n].type = SRP_SNAPSHOT_DOMAIN;
+    records[n].port_num = i;
+    records[n].vlan_id = current_vlan_id_from_domain;
+    records[n].sr_classes = ~srp_domain_boundary_port[i] & ((1 << AVB_SRP_NUM_SR_CLASSES) - 1);
+    n++;
+  }
+
+  for (int i=0; i < AVB_STREAM_TABLE_ENTRIES; i++) {
+    avb_stream_entry *stream = &stream_table[i];
+    unsigned *stream_id = stream->reservation.stream_id;
+
+    if (!stream->talker_present) continue;
+
+    if (avb_get_sink_stream_index_from_stream_id(stream_id) != -1u && n < max_records) {
+      mrp_attribute_state *talker = mrp_match_type_non_prop_attribute(MSRP_TALKER_ADVERTISE, stream_id, -1);
+      memset(&records[n], 0, sizeof(srp_snapshot_record));
+      srp_snapshot_reservation(&records[n], &stream->reservation);
+      records[n].type = SRP_SNAPSHOT_TALKER;
+      records[n].port_num = talker ? talker->port_num : 0;
+      n++;
+    }
+    else if (avb_get_source_stream_index_from_stream_id(stream_id) != -1u) {
+      for (int port=0; port < MRP_NUM_PORTS && n < max_records; port++) {
+        if (!stream->bw_reserved[port]) continue;
+        memset(&records[n], 0, sizeof(srp_snapshot_record));
+        records[n].stream_id[0] = stream_id[0];
+        records[n].stream_id[1] = stream_id[1];
+        records[n].type = SRP_SNAPSHOT_LISTENER;
+        records[n].port_num = port;
+        n++;
+      }
+    }
+  }
+
+  return n;
+}
+
+void srp_snapshot_restore_record(srp_snapshot_record *record)
+{
+  int port_num = record->port_num;
+
+  switch (record->type)
+  {
+    case SRP_SNAPSHOT_DOMAIN:
+    {
+      unsigned int sr_classes = record->sr_classes & ((1 << AVB_SRP_NUM_SR_CLASSES) - 1);
+      srp_domain_boundary_port[port_num] &= ~sr_classes;
+      provisional_domain[port_num] |= sr_classes;
+      if (sr_classes) current_vlan_id_from_domain = record->vlan_id;
+      break;
+    }
+    case SRP_SNAPSHOT_TALKER:
+    {
+      avb_srp_info_t reservation;
+      memset(&reservation, 0, sizeof(reservation));
+      reservation.stream_id[0] = record->stream_id[0];
+      reservation.stream_id[1] = record->stream_id[1];
+      memcpy(reservation.dest_mac_addr, record->dest_mac_addr, 6);
+      reservation.vlan_id = record->vlan_id;
+      reservation.tspec_max_frame_size = record->tspec_max_frame_size;
+      reservation.tspec_max_interval = record->tspec_max_interval;
+      reservation.tspec = record->tspec;
+      reservation.accumulated_latency = record->accumulated_latency;
+      avb_stream_entry *stream = srp_add_reservation_entry(&reservation);
+      if (stream) stream->provisional_talker = 1;
+      break;
+    }
+    case SRP_SNAPSHOT_LISTENER:
+    {
+      int entry = srp_match_reservation_entry_by_id(record->stream_id);
+      if (entry >= 0) {
+        stream_table[entry].reservation.stream_id[0] = record->stream_id[0];
+        stream_table[entry].reservation.stream_id[1] = record->stream_id[1];
+        stream_table[entry].provisional_listener[port_num] = 1;
+      }
+      break;
+    }
+    default:
+      break;
+  }
+}
+
+int srp_snapshot_provisional(void)
+{
+  for (int i=0; i < MRP_NUM_PORTS; i++) {
+    if (provisional_domain[i]) return 1;
+  }
+  for (int i=0; i < AVB_STREAM_TABLE_ENTRIES; i++) {
+    if (stream_table[i].provisional_talker) return 1;
+    for (int port=0; port < MRP_NUM_PORTS; port++) {
+      if (stream_table[i].provisional_listener[port]) return 1;
+    }
+  }
+  return 0;
+}
+
+/* A source that had Listeners before the restart starts transmitting as soon
+ * as it is ready, without waiting for the Listener Ready to be re-registered
+ */
+void srp_snapshot_enable_provisional_sources(CLIENT_INTERFACE(avb_interface, avb))
+{
+  for (int i=0; i < AVB_STREAM_TABLE_ENTRIES; i++) {
+    avb_stream_entry *stream = &stream_table[i];
+    int provisional = 0, num_ports = 0, port_num = 0;
+    enum avb_source_state_t state;
+
+    for (int port=0; port < MRP_NUM_PORTS; port++) {
+      provisional |= stream->provisional_listener[port];
+    }
+    if (!provisional || !stream->talker_present) continue;
+
+    unsigned source = avb_get_source_stream_index_from_stream_id(stream->reservation.stream_id);
+    if (source == -1u) continue;
+
+    avb_get_source_state(avb, source, &state);
+    if (state != AVB_SOURCE_STATE_POTENTIAL) continue;
+
+    for (int port=0; port < MRP_NUM_PORTS; port++) {
+      if (stream->provisional_listener[port] && !srp_increase_port_bandwidth(stream, 0, port)) {
+        num_ports++;
+        port_num = port;
+      }
+    }
+
+    if (num_ports) {
+      debug_printf("MSRP: Restarting stream %x%x from snapshot\n", stream->reservation.stream_id[0], stream->reservation.stream_id[1]);
+      set_avb_source_port(source, num_ports == MRP_NUM_PORTS ? -1 : port_num);
+      avb_set_source_state(avb, source, AVB_SOURCE_STATE_ENABLED);
+    }
+  }
+}
+
+void srp_snapshot_age_out(CLIENT_INTERFACE(avb_interface, avb))
+{
+  for (int i=0; i < MRP_NUM_PORTS; i++) {
+    if (provisional_domain[i]) {
+      debug_printf("MSRP: Restored SRP domain on port %d not confirmed\n", i);
+      srp_domain_boundary_port[i] |= provisional_domain[i];
+      provisional_domain[i] = 0;
+    }
+  }
+
+  for (int i=0; i < AVB_STREAM_TABLE_ENTRIES; i++) {
+    avb_stream_entry *stream = &stream_table[i];
+    int provisional = 0, listening = 0;
+
+    if (stream->provisional_talker) {
+      debug_printf("MSRP: Restored Talker %x%x not confirmed\n", stream->reservation.stream_id[0], stream->reservation.stream_id[1]);
+      stream->talker_present = 0;
+      stream->provisional_talker = 0;
+    }
+
+    for (int port=0; port < MRP_NUM_PORTS; port++) {
+      if (stream->provisional_listener[port]) {
+        provisional = 1;
+        stream->provisional_listener[port] = 0;
+        srp_decrease_port_bandwidth(stream, port);
+      }
+      listening |= stream->bw_reserved[port];
+    }
+
+    if (!provisional || listening) continue;
+
+    if (stream->talker_present) {
+      unsigned source = avb_get_source_stream_index_from_stream_id(stream->reservation.stream_id);
+      enum avb_source_state_t state;
+      if (source != -1u) {
+        avb_get_source_state(avb, source, &state);
+        if (state == AVB_SOURCE_STATE_ENABLED) {
+          debug_printf("MSRP: Restored Listener for stream %x%x not confirmed\n", stream->reservation.stream_id[0], stream->reservation.stream_id[1]);
+          avb_set_source_state(avb, source, AVB_SOURCE_STATE_POTENTIAL);
+        }
+      }
+    }
+    else if (!stream->listener_present) {
+      // The entry only held the restored Listener Ready
+      memset(stream, 0, sizeof(avb_stream_entry));
+    }
+  }
 }
 
-static int check_domain_firstvalue_merge(char *buf) {
+static int check_domain_firstvalue_merge(char *vec) {
   // We never both to merge domain attribute together
   return 0;
 }
 
 static int encode_domain_message(char *buf,
+                                char *vec,
                                 mrp_attribute_state *st,
                                 int vector)
 {
   mrp_msg_header *mrp_hdr = (mrp_msg_header *) buf;
-  mrp_vector_header *hdr =
-    (mrp_vector_header *) (buf + sizeof(mrp_msg_header));
   int merge = 0;
   int num_values;
 
@@ -996,42 +1356,44 @@ static int encode_domain_message(char *buf,
     return 0;
 
 
-  num_values = hdr->NumberOfValuesLow;
+  num_values = mrp_vector_num_values(vec);
 
   if (num_values == 0)
     merge = 1;
   else
-    merge = check_domain_firstvalue_merge(buf);
+    merge = check_domain_firstvalue_merge(vec);
 
   if (merge) {
     srp_domain_first_value *first_value =
-      (srp_domain_first_value *) (buf + sizeof(mrp_msg_header) + sizeof(mrp_vector_header));
+      (srp_domain_first_value *) (vec + sizeof(mrp_vector_header));
+
+    srp_class_domain *domain = st->attribute_info;
 
-    first_value->SRclassID = AVB_SRP_SRCLASS_DEFAULT;
-    first_value->SRclassPriority = AVB_SRP_TSPEC_PRIORITY_DEFAULT;
+    first_value->SRclassID = domain->id;
+    first_value->SRclassPriority = domain->priority;
     first_value->SRclassVID[0] = (current_vlan_id_from_domain>>8)&0xff;
     first_value->SRclassVID[1] = (current_vlan_id_from_domain&0xff);
 
-    mrp_encode_three_packed_event(buf, vector, st->attribute_type);
+    mrp_encode_three_packed_event(buf, vec, vector, st->attribute_type);
 
-    hdr->NumberOfValuesLow = num_values+1;
+    mrp_vector_set_num_values(vec, num_values+1);
   }
 
   return merge;
 }
 
 
-static int check_talker_firstvalue_merge(char *buf,
-                              avb_source_info_t *source_info)
+static int check_talker_firstvalue_merge(char *vec,
+                              avb_source_info_t *source_info,
+                              int failed)
 {
-  mrp_vector_header *hdr = (mrp_vector_header *) (buf + sizeof(mrp_msg_header));
-  int num_values = hdr->NumberOfValuesLow;
+  int num_values = mrp_vector_num_values(vec);
   unsigned long long stream_id=0, my_stream_id=0;
   unsigned long long dest_addr=0, my_dest_addr=0;
   int framesize=0, my_framesize=0;
   int vlan, my_vlan;
   srp_talker_first_value *first_value =
-    (srp_talker_first_value *) (buf + sizeof(mrp_msg_header) + sizeof(mrp_vector_header));
+    (srp_talker_first_value *) (vec + sizeof(mrp_vector_header));
 
   // check if we can merge
 
@@ -1071,18 +1433,31 @@ static int check_talker_firstvalue_merge(char *buf,
   if (framesize != my_framesize)
     return 0;
 
+  // Every value in a vector carries the rest of the first value unchanged
+  if (first_value->TSpec != source_info->reservation.tspec ||
+      ntoh_16(first_value->TSpecMaxIntervalFrames) != source_info->reservation.tspec_max_interval ||
+      ntoh_32(first_value->AccumulatedLatency) != source_info->reservation.accumulated_latency)
+    return 0;
+
+  if (failed) {
+    srp_talker_failed_first_value *failed_first_value =
+      (srp_talker_failed_first_value *) first_value;
+
+    if (failed_first_value->FailureCode != source_info->reservation.failure_code ||
+        memcmp(failed_first_value->FailureBridgeId, source_info->reservation.failure_bridge_id, 8))
+      return 0;
+  }
 
   return 1;
 
 }
 
 static int encode_talker_message(char *buf,
+                                char *vec,
                                 mrp_attribute_state *st,
                                 int vector)
 {
   mrp_msg_header *mrp_hdr = (mrp_msg_header *) buf;
-  mrp_vector_header *hdr =
-    (mrp_vector_header *) (buf + sizeof(mrp_msg_header));
   int merge = 0;
   avb_source_info_t *source_info = st->attribute_info;
   avb_srp_info_t *attribute_info;
@@ -1101,18 +1476,18 @@ static int encode_talker_message(char *buf,
   else
     attribute_info = st->attribute_info;
 
-  num_values = hdr->NumberOfValuesLow;
+  num_values = mrp_vector_num_values(vec);
 
   if (num_values == 0)
     merge = 1;
   else
-    merge = check_talker_firstvalue_merge(buf, source_info);
+    merge = check_talker_firstvalue_merge(vec, source_info, st->attribute_type == MSRP_TALKER_FAILED);
 
 
 
   if (merge) {
     srp_talker_first_value *first_value =
-      (srp_talker_first_value *) (buf + sizeof(mrp_msg_header) + sizeof(mrp_vector_header));
+      (srp_talker_first_value *) (vec + sizeof(mrp_vector_header));
 
     // The SRP layer
 
@@ -1147,7 +1522,7 @@ static int encode_talker_message(char *buf,
 
       if (st->attribute_type == MSRP_TALKER_FAILED) {
         srp_talker_failed_first_value *first_value =
-          (srp_talker_failed_first_value *) (buf + sizeof(mrp_msg_header) + sizeof(mrp_vector_header));
+          (srp_talker_failed_first_value *) (vec + sizeof(mrp_vector_header));
 
         first_value->FailureCode = attribute_info->failure_code;
         for (int i=0; i < 8; i++) {
@@ -1158,9 +1533,9 @@ static int encode_talker_message(char *buf,
 
     }
 
-    mrp_encode_three_packed_event(buf, vector, st->attribute_type);
+    mrp_encode_three_packed_event(buf, vec, vector, st->attribute_type);
 
-    hdr->NumberOfValuesLow = num_values+1;
+    mrp_vector_set_num_values(vec, num_values+1);
 
   }
 
@@ -1174,19 +1549,20 @@ static int encode_talker_message(char *buf,
 
 
 int avb_srp_encode_message(char *buf,
+                          char *vec,
                           mrp_attribute_state *st,
                           int vector)
 {
   switch (st->attribute_type) {
   case MSRP_TALKER_ADVERTISE:
   case MSRP_TALKER_FAILED:
-    return encode_talker_message(buf, st, vector);
+    return encode_talker_message(buf, vec, st, vector);
     break;
   case MSRP_LISTENER:
-    return encode_listener_message(buf, st, vector);
+    return encode_listener_message(buf, vec, st, vector);
     break;
   case MSRP_DOMAIN_VECTOR:
-    return encode_domain_message(buf, st, vector);
+    return encode_domain_message(buf, vec, st, vector);
     break;
 
   default:
@@ -1199,9 +1575,18 @@ int avb_srp_encode_message(char *buf,
 int avb_srp_compare_talker_attributes(mrp_attribute_state *a,
                                       mrp_attribute_state *b)
 {
-  avb_stream_info_t *source_info_a = (avb_stream_info_t *) a->attribute_info;
-  avb_stream_info_t *source_info_b = (avb_stream_info_t *) b->attribute_info;
-  return (source_info_a->local_id < source_info_b->local_id);
+  // Ordered by stream ID so that consecutive streams share a vector
+  avb_srp_info_t *source_info_a = (avb_srp_info_t *) a->attribute_info;
+  avb_srp_info_t *source_info_b = (avb_srp_info_t *) b->attribute_info;
+  unsigned int *sA = source_info_a->stream_id;
+  unsigned int *sB = source_info_b->stream_id;
+  for (int i=0;i<2;i++) {
+    if (sA[i] < sB[i])
+      return 1;
+    if (sB[i] < sA[i])
+      return 0;
+  }
+  return 0;
 }
 
 int avb_srp_compare_listener_attributes(mrp_attribute_state *a,
@@ -13,13 +13,42 @@
 
 #define AVB_SRP_MACADDR { 0x01, 0x80, 0xc2, 0x00, 0x00, 0xe }
 
+// SR classes are indexed by enum avb_sr_class_t
+#define AVB_SRP_NUM_SR_CLASSES 2
+
+/** Class measurement intervals per second: 125us for Class A, 250us for Class B */
+#define AVB_SRP_CLASS_A_INTERVALS_PER_SECOND 8000
+#define AVB_SRP_CLASS_B_INTERVALS_PER_SECOND 4000
+
+/** The percentage of a port's link rate that may be reserved for each SR class
+ *  (deltaBandwidth, 802.1Q 34.3.1). A class may also use whatever the higher
+ *  priority classes leave unreserved of their share.
+ */
+#ifndef AVB_SRP_DELTA_BANDWIDTH_CLASS_A
+#define AVB_SRP_DELTA_BANDWIDTH_CLASS_A 75
+#endif
+
+#ifndef AVB_SRP_DELTA_BANDWIDTH_CLASS_B
+#define AVB_SRP_DELTA_BANDWIDTH_CLASS_B 0
+#endif
+
+/** Link rate assumed for a port until the MAC reports the negotiated speed */
+#ifndef AVB_SRP_DEFAULT_LINK_SPEED_MBPS
+#define AVB_SRP_DEFAULT_LINK_SPEED_MBPS 100
+#endif
+
 typedef struct avb_stream_entry
 {
   avb_srp_info_t reservation;
   char listener_present;
   char talker_present;
   char bw_reserved[MRP_NUM_PORTS]; // While the bw_reserved flag is set/not set we do not add/subtract Qav credit
+  char bw_reserved_class[MRP_NUM_PORTS];
+  unsigned int bw_reserved_bps[MRP_NUM_PORTS];
+  char bw_failed[MRP_NUM_PORTS]; // Talker declared failed on the port for lack of bandwidth
   char reservation_failed;
+  char provisional_talker; // talker_present was restored from the snapshot and not yet confirmed
+  char provisional_listener[MRP_NUM_PORTS]; // Listener Ready restored from the snapshot
 } avb_stream_entry;
 
 void avb_match_and_join_leave(mrp_attribute_state *unsafe attr, int join);
@@ -34,6 +63,22 @@ int avb_add_detected_stream(srp_talker_first_value *fv,
                              avb_srp_info_t **stream);
 
 
+/** A Talker or Listener value of a received vector, unpacked once from the
+ *  vector's FirstValue. The TSpec frame size and interval, latency and failure
+ *  information are the same for every value and are read from the FirstValue.
+ */
+typedef struct srp_stream_value {
+  unsigned long long stream_id;
+  unsigned long long dest_mac_addr;
+  unsigned short vlan_id;
+  unsigned char tspec;
+} srp_stream_value;
+
+/** The number of values of a received vector that are unpacked at a time */
+#ifndef AVB_SRP_DECODE_BATCH_SIZE
+#define AVB_SRP_DECODE_BATCH_SIZE 16
+#endif
+
 typedef struct srp_stream_state {
   union {
     mrp_attribute_state talker;
@@ -56,9 +101,15 @@ short avb_srp_join_listener_attrs(unsigned int stream_id[2], short vlan_id);
 int srp_cleanup_reservation_entry(mrp_event event, mrp_attribute_state *st);
 
 /* The following functions are called from avb_mrp.c */
-mrp_attribute_state *unsafe avb_srp_process_new_attribute_from_packet(int attribute_type,
+void avb_srp_decode_stream_values(int attribute_type,
                                   char *fv,
+                                  int first,
                                   int num,
+                                  srp_stream_value values[]);
+
+mrp_attribute_state *unsafe avb_srp_process_new_attribute_from_packet(int attribute_type,
+                                  srp_stream_value *value,
+                                  char *fv,
                                   int port_num);
 
 int avb_srp_compare_talker_attributes(mrp_attribute_state *a,
@@ -68,18 +119,18 @@ int avb_srp_compare_listener_attributes(mrp_attribute_state *a,
                                         mrp_attribute_state *b);
 
 int avb_srp_encode_message(char *buf,
+                          char *vec,
                           mrp_attribute_state *st,
                           int vector);
 
 int avb_srp_match_talker_advertise(mrp_attribute_state *attr,
-                                   char *msg,
-                                   int i,
+                                   srp_stream_value *value,
+                                   char *fv,
                                    int leave_all,
                                    int failed);
 
 int avb_srp_match_listener(mrp_attribute_state *attr,
-                           char *msg,
-                           int i,
+                           srp_stream_value *value,
                            int four_packed_event);
 
 int avb_srp_match_domain(mrp_attribute_state *attr,
@@ -103,7 +154,15 @@ void avb_srp_domain_leave_ind(CLIENT_INTERFACE(avb_interface, avb), mrp_attribut
 void srp_domain_init(void);
 void srp_domain_join(void);
 
+/** Returns non-zero if a port is an SRP domain boundary for the SR class of a stream */
+int srp_stream_domain_boundary(avb_srp_info_t *reservation, int port_num);
+
 void srp_store_ethernet_interface(CLIENT_INTERFACE(ethernet_tx_if, i));
+void srp_store_ethernet_cfg_interface(CLIENT_INTERFACE(ethernet_cfg_if, i));
+
+void srp_set_port_link_speed(int port_num, unsigned link_speed_mbps);
+
+void srp_set_port_shaper_bandwidth(CLIENT_INTERFACE(ethernet_cfg_if, i_eth_cfg), int port_num, unsigned bandwidth_bps);
 
 
 #endif // _avb_srp_h_
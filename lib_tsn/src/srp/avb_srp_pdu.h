@@ -31,6 +31,7 @@ typedef struct srp_talker_failed_first_value {
 #define AVB_SRP_MAX_INTERVAL_FRAMES_DEFAULT 1
 #define AVB_SRP_TSPEC_RANK_DEFAULT 1
 #define AVB_SRP_TSPEC_PRIORITY_DEFAULT 3
+#define AVB_SRP_TSPEC_PRIORITY_CLASS_B 2
 #define AVB_SRP_TSPEC_RESERVED_VALUE 0
 
 // Initial guess at 150us
@@ -51,6 +52,12 @@ typedef struct srp_domain_first_value {
   unsigned char SRclassVID[2];
 } srp_domain_first_value;
 
+// Talker Failed FailureCode values (802.1Q Table 35-6)
+#define AVB_SRP_FAILURE_CODE_INSUFFICIENT_BANDWIDTH 1
+#define AVB_SRP_FAILURE_CODE_INSUFFICIENT_BANDWIDTH_FOR_TRAFFIC_CLASS 3
+#define AVB_SRP_FAILURE_CODE_EGRESS_PORT_NOT_AVB_CAPABLE 8
+
 #define AVB_SRP_ATTRIBUTE_TYPE_DOMAIN 4
 #define AVB_SRP_SRCLASS_DEFAULT 6
+#define AVB_SRP_SRCLASS_B 5
 #endif // _avb_srp_pdu_h_
@@ -0,0 +1,267 @@
+// Copyright (c) 2017, XMOS Ltd, All rights reserved
+#include <string.h>
+#include <quadflashlib.h>
+#include "avb_srp_snapshot.h"
+#include "avb_srp.h"
+#include "avb_mvrp.h"
+#include "misc_timer.h"
+#include "avb_control_deadline.h"
+#include "debug_print.h"
+
+#if AVB_SRP_SNAPSHOT_ENABLED
+
+static unsigned int snapshot_buf[(AVB_SRP_SNAPSHOT_NUM_PAGES * FLASH_PAGE_SIZE) / 4];
+static unsigned int saved_checksum;
+static avb_timer save_timer;
+static avb_timer confirm_timer;
+static avb_timer poll_timer;
+static int provisional = 0;
+
+// The sector is used as a run of slots of AVB_SRP_SNAPSHOT_NUM_PAGES pages.
+// Each save goes to the next erased slot, so the sector is only erased at
+// boot, before the protocols run, once half of its slots are used. A save is
+// spread over several periodic calls with a page write in each.
+#define SNAPSHOT_SAVE_IDLE (-1)
+static int save_step = SNAPSHOT_SAVE_IDLE;
+static int num_slots = 0;
+static int next_slot = 0;
+
+// The first data partition page of the snapshot sector
+static int snapshot_first_page(void)
+{
+  int offset = 0;
+
+  if (AVB_SRP_SNAPSHOT_DATA_SECTOR >= fl_getNumDataSectors())
+    return -1;
+
+  for (int i=0; i < AVB_SRP_SNAPSHOT_DATA_SECTOR; i++)
+    offset += fl_getDataSectorSize(i);
+
+  if (fl_getDataSectorSize(AVB_SRP_SNAPSHOT_DATA_SECTOR) < AVB_SRP_SNAPSHOT_NUM_PAGES * FLASH_PAGE_SIZE)
+    return -1;
+
+  return offset / FLASH_PAGE_SIZE;
+}
+
+static int snapshot_slot_page(int slot)
+{
+  return snapshot_first_page() + slot * AVB_SRP_SNAPSHOT_NUM_PAGES;
+}
+
+static unsigned int snapshot_checksum(srp_snapshot_header *hdr)
+{
+  unsigned char *data = (unsigned char *) (hdr + 1);
+  unsigned int len = hdr->num_records * sizeof(srp_snapshot_record);
+  unsigned int sum = hdr->version + (hdr->num_records << 16);
+
+  for (int i=0; i < len; i++)
+    sum = ((sum << 5) | (sum >> 27)) + data[i];
+
+  return sum;
+}
+
+static srp_snapshot_header *snapshot_build(void)
+{
+  srp_snapshot_header *hdr = (srp_snapshot_header *) snapshot_buf;
+  srp_snapshot_record *records = (srp_snapshot_record *) (hdr + 1);
+  int n;
+
+  memset(snapshot_buf, 0xff, sizeof(snapshot_buf));
+  n = srp_snapshot_collect(records, AVB_SRP_SNAPSHOT_MAX_RECORDS);
+  n += avb_mvrp_snapshot_collect(&records[n], AVB_SRP_SNAPSHOT_MAX_RECORDS - n);
+
+  hdr->magic = AVB_SRP_SNAPSHOT_MAGIC;
+  hdr->version = AVB_SRP_SNAPSHOT_VERSION;
+  hdr->num_records = n;
+  hdr->checksum = snapshot_checksum(hdr);
+  return hdr;
+}
+
+// Builds the snapshot and starts saving it if it has changed and an erased
+// slot is left
+static void snapshot_save_start(void)
+{
+  srp_snapshot_header *hdr;
+
+  if (next_slot >= num_slots)
+    return;
+
+  hdr = snapshot_build();
+  if (hdr->checksum == saved_checksum)
+    return;
+
+  save_step = 0;
+}
+
+static void snapshot_save_continue(void)
+{
+  srp_snapshot_header *hdr = (srp_snapshot_header *) snapshot_buf;
+
+  if (fl_writeDataPage(snapshot_slot_page(next_slot) + save_step,
+                       (unsigned char *) snapshot_buf + save_step * FLASH_PAGE_SIZE) != 0) {
+    // The slot may be partly written, so the next save uses the one after it
+    debug_printf("MRP snapshot: flash write failed\n");
+    save_step = SNAPSHOT_SAVE_IDLE;
+    next_slot++;
+    return;
+  }
+
+  save_step++;
+  if (save_step == AVB_SRP_SNAPSHOT_NUM_PAGES) {
+    saved_checksum = hdr->checksum;
+    save_step = SNAPSHOT_SAVE_IDLE;
+    next_slot++;
+    debug_printf("MRP snapshot: saved %d records\n", hdr->num_records);
+    if (next_slot == num_slots)
+      debug_printf("MRP snapshot: sector full, no more saves until the next boot\n");
+  }
+}
+
+// Reads a slot into snapshot_buf. Returns 1 if it holds a valid snapshot,
+// 0 if not and -1 if it is erased.
+static int snapshot_read_slot(int slot)
+{
+  srp_snapshot_header *hdr = (srp_snapshot_header *) snapshot_buf;
+  unsigned char *data = (unsigned char *) snapshot_buf;
+  int erased = 1;
+
+  for (int i=0; i < AVB_SRP_SNAPSHOT_NUM_PAGES; i++) {
+    if (fl_readDataPage(snapshot_slot_page(slot) + i, data + i * FLASH_PAGE_SIZE) != 0)
+      return 0;
+  }
+
+  for (int i=0; i < FLASH_PAGE_SIZE; i++) {
+    if (data[i] != 0xff) {
+      erased = 0;
+      break;
+    }
+  }
+  if (erased)
+    return -1;
+
+  return hdr->magic == AVB_SRP_SNAPSHOT_MAGIC &&
+         hdr->version == AVB_SRP_SNAPSHOT_VERSION &&
+         hdr->num_records <= AVB_SRP_SNAPSHOT_MAX_RECORDS &&
+         hdr->checksum == snapshot_checksum(hdr);
+}
+
+// Erases the sector and writes the snapshot in snapshot_buf, if any, back to
+// its first slot. Only called at boot, as the erase blocks the task.
+static void snapshot_compact(int keep)
+{
+  next_slot = 0;
+
+  if (fl_eraseDataSector(AVB_SRP_SNAPSHOT_DATA_SECTOR) != 0) {
+    debug_printf("MRP snapshot: flash erase failed\n");
+    num_slots = 0;
+    return;
+  }
+
+  if (!keep)
+    return;
+
+  for (int i=0; i < AVB_SRP_SNAPSHOT_NUM_PAGES; i++) {
+    if (fl_writeDataPage(snapshot_slot_page(0) + i, (unsigned char *) snapshot_buf + i * FLASH_PAGE_SIZE) != 0) {
+      debug_printf("MRP snapshot: flash write failed\n");
+      break;
+    }
+  }
+  next_slot = 1;
+}
+
+void avb_srp_snapshot_restore(void)
+{
+  srp_snapshot_header *hdr = (srp_snapshot_header *) snapshot_buf;
+  srp_snapshot_record *records = (srp_snapshot_record *) (hdr + 1);
+  int latest = -1;
+
+  init_avb_timer(&save_timer, 1);
+  start_avb_timer(&save_timer, AVB_SRP_SNAPSHOT_SAVE_INTERVAL_CENTISECONDS);
+  init_avb_timer(&confirm_timer, 1);
+  init_avb_timer(&poll_timer, 1);
+  saved_checksum = 0;
+  num_slots = 0;
+  next_slot = 0;
+
+  if (snapshot_first_page() < 0) {
+    debug_printf("MRP snapshot: no room in data sector %d\n", AVB_SRP_SNAPSHOT_DATA_SECTOR);
+    return;
+  }
+
+  num_slots = fl_getDataSectorSize(AVB_SRP_SNAPSHOT_DATA_SECTOR) / (AVB_SRP_SNAPSHOT_NUM_PAGES * FLASH_PAGE_SIZE);
+
+  // Slots are written in order, so the used ones come first and the last
+  // valid one holds the latest snapshot
+  for (next_slot = 0; next_slot < num_slots; next_slot++) {
+    int valid = snapshot_read_slot(next_slot);
+    if (valid < 0)
+      break;
+    if (valid)
+      latest = next_slot;
+  }
+
+  if (latest >= 0 && snapshot_read_slot(latest) != 1)
+    latest = -1;
+
+  if (next_slot * 2 >= num_slots)
+    snapshot_compact(latest >= 0);
+
+  if (latest < 0)
+    return;
+
+  saved_checksum = hdr->checksum;
+
+  for (int i=0; i < hdr->num_records; i++) {
+    srp_snapshot_record *record = &records[i];
+
+    if (record->port_num >= MRP_NUM_PORTS)
+      continue;
+
+    if (record->type == SRP_SNAPSHOT_VLAN)
+      avb_mvrp_snapshot_restore_vlan(record->vlan_id, record->port_num);
+    else
+      srp_snapshot_restore_record(record);
+  }
+
+  debug_printf("MRP snapshot: restored %d records\n", hdr->num_records);
+  provisional = 1;
+  start_avb_timer(&confirm_timer, AVB_SRP_SNAPSHOT_CONFIRM_TIMEOUT_CENTISECONDS);
+  start_avb_timer(&poll_timer, AVB_SRP_SNAPSHOT_POLL_INTERVAL_CENTISECONDS);
+}
+
+void avb_srp_snapshot_periodic(CLIENT_INTERFACE(avb_interface, avb))
+{
+  if (provisional) {
+    if (avb_timer_expired(&confirm_timer)) {
+      srp_snapshot_age_out(avb);
+      avb_mvrp_snapshot_age_out();
+      stop_avb_timer(&poll_timer);
+      provisional = 0;
+    }
+    else if (!srp_snapshot_provisional() && !avb_mvrp_snapshot_provisional()) {
+      stop_avb_timer(&confirm_timer);
+      stop_avb_timer(&poll_timer);
+      provisional = 0;
+    }
+    else if (avb_timer_expired(&poll_timer)) {
+      srp_snapshot_enable_provisional_sources(avb);
+      start_avb_timer(&poll_timer, AVB_SRP_SNAPSHOT_POLL_INTERVAL_CENTISECONDS);
+    }
+  }
+
+  // Nothing is saved until the restored state has been confirmed or aged out
+  if (save_step != SNAPSHOT_SAVE_IDLE) {
+    snapshot_save_continue();
+  }
+  else if (avb_timer_expired(&save_timer)) {
+    if (!provisional)
+      snapshot_save_start();
+    start_avb_timer(&save_timer, AVB_SRP_SNAPSHOT_SAVE_INTERVAL_CENTISECONDS);
+  }
+
+  avb_control_deadline_timer(AVB_CONTROL_MRP, &confirm_timer);
+  avb_control_deadline_timer(AVB_CONTROL_MRP, &poll_timer);
+  avb_control_deadline_timer(AVB_CONTROL_MRP, &save_timer);
+}
+
+#endif
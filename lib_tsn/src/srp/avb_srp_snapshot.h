@@ -0,0 +1,89 @@
+// Copyright (c) 2017, XMOS Ltd, All rights reserved
+#ifndef _avb_srp_snapshot_h_
+#define _avb_srp_snapshot_h_
+#include <xccompat.h>
+#include "default_avb_conf.h"
+#include "avb_mrp.h"
+#include "avb_mvrp.h"
+#include "avb.h"
+
+/** \file avb_srp_snapshot.h
+ *
+ *  Warm restart of SRP and MVRP. The registrations that keep this endpoint's
+ *  streams running are periodically written to a flash data sector. At boot
+ *  they are restored as provisional state, so streams can restart before MRP
+ *  has re-registered them. Each restored item is confirmed by the matching
+ *  live declaration, or aged out if none arrives within
+ *  AVB_SRP_SNAPSHOT_CONFIRM_TIMEOUT_CENTISECONDS.
+ */
+
+#define AVB_SRP_SNAPSHOT_MAGIC 0x53505253 // "SRPS"
+
+/** Incremented whenever the layout of the snapshot records changes, so that
+ *  a snapshot written by other firmware is ignored
+ */
+#define AVB_SRP_SNAPSHOT_VERSION 1
+
+typedef enum {
+  SRP_SNAPSHOT_TALKER,   //!< A Talker registered for one of our sinks
+  SRP_SNAPSHOT_LISTENER, //!< A Listener Ready registered for one of our sources
+  SRP_SNAPSHOT_DOMAIN,   //!< The SR classes a port is in the SRP domain of
+  SRP_SNAPSHOT_VLAN      //!< A VID declared by MVRP
+} srp_snapshot_record_type;
+
+typedef struct srp_snapshot_header {
+  unsigned magic;
+  unsigned short version;
+  unsigned short num_records;
+  unsigned checksum;
+} srp_snapshot_header;
+
+typedef struct srp_snapshot_record {
+  unsigned stream_id[2];
+  unsigned accumulated_latency;
+  unsigned short vlan_id;
+  unsigned short tspec_max_frame_size;
+  unsigned short tspec_max_interval;
+  unsigned char dest_mac_addr[6];
+  unsigned char type;
+  unsigned char port_num;
+  unsigned char tspec;
+  unsigned char sr_classes;
+} srp_snapshot_record;
+
+#ifndef AVB_SRP_SNAPSHOT_MAX_RECORDS
+#define AVB_SRP_SNAPSHOT_MAX_RECORDS (AVB_NUM_SINKS + (AVB_NUM_SOURCES * MRP_NUM_PORTS) + \
+                                      MRP_NUM_PORTS + (AVB_MAX_NUM_VLAN * MRP_NUM_PORTS))
+#endif
+
+#define AVB_SRP_SNAPSHOT_SIZE (sizeof(srp_snapshot_header) + \
+                               (AVB_SRP_SNAPSHOT_MAX_RECORDS * sizeof(srp_snapshot_record)))
+
+#define AVB_SRP_SNAPSHOT_NUM_PAGES ((AVB_SRP_SNAPSHOT_SIZE + FLASH_PAGE_SIZE - 1) / FLASH_PAGE_SIZE)
+
+/** Restore the snapshot from flash as provisional SRP and MVRP state.
+ *  Called once MRP, the SRP domains and MVRP have been initialised.
+ */
+void avb_srp_snapshot_restore(void);
+
+/** Confirms or ages out the restored state and saves the snapshot when it
+ *  has changed. Called from the MRP periodic processing.
+ */
+void avb_srp_snapshot_periodic(CLIENT_INTERFACE(avb_interface, avb));
+
+#ifndef __XC__
+//!@{
+//! \name Collection and restore of the records owned by the SRP and MVRP modules
+int srp_snapshot_collect(srp_snapshot_record records[], int max_records);
+void srp_snapshot_restore_record(srp_snapshot_record *record);
+int srp_snapshot_provisional(void);
+void srp_snapshot_enable_provisional_sources(CLIENT_INTERFACE(avb_interface, avb));
+void srp_snapshot_age_out(CLIENT_INTERFACE(avb_interface, avb));
+int avb_mvrp_snapshot_collect(srp_snapshot_record records[], int max_records);
+void avb_mvrp_snapshot_restore_vlan(int vlan, int port_num);
+int avb_mvrp_snapshot_provisional(void);
+void avb_mvrp_snapshot_age_out(void);
+//!@}
+#endif
+
+#endif
@@ -0,0 +1,45 @@
+// Copyright (c) 2017, XMOS Ltd, All rights reserved
+#include "avb_control_deadline.h"
+
+#define timeafter(A, B) ((int)((B) - (A)) < 0)
+
+// Shared by the control tasks on a tile. A task only ever wakes earlier than
+// its own protocols require, which is harmless.
+static unsigned deadline[AVB_CONTROL_NUM_PROTOCOLS];
+static int deadline_valid[AVB_CONTROL_NUM_PROTOCOLS];
+
+static void deadline_at(avb_control_protocol_t protocol, unsigned t)
+{
+  if (!deadline_valid[protocol] || timeafter(deadline[protocol], t)) {
+    deadline[protocol] = t;
+    deadline_valid[protocol] = 1;
+  }
+}
+
+void avb_control_deadline_clear(avb_control_protocol_t protocol)
+{
+  deadline_valid[protocol] = 0;
+}
+
+void avb_control_deadline_now(avb_control_protocol_t protocol)
+{
+  deadline_at(protocol, get_local_time());
+}
+
+void avb_control_deadline_timer(avb_control_protocol_t protocol, avb_timer *tmr)
+{
+  if (tmr->active)
+    deadline_at(protocol, tmr->timeout);
+}
+
+unsigned avb_control_next_deadline(unsigned now, unsigned max_sleep)
+{
+  unsigned next = now + max_sleep;
+
+  for (int i=0; i < AVB_CONTROL_NUM_PROTOCOLS; i++) {
+    if (deadline_valid[i] && timeafter(next, deadline[i]))
+      next = deadline[i];
+  }
+
+  return next;
+}
@@ -0,0 +1,34 @@
+// Copyright (c) 2017, XMOS Ltd, All rights reserved
+#ifndef _avb_control_deadline_h_
+#define _avb_control_deadline_h_
+#include <xccompat.h>
+#include "misc_timer.h"
+
+/*!
+ * The control protocols report when their periodic processing next has work
+ * to do, so that the task running them can sleep until the earliest of these
+ * deadlines instead of polling. Each protocol clears its deadline at the end
+ * of its periodic call and then reports its active timers and any work that
+ * is already due.
+ */
+typedef enum {
+  AVB_CONTROL_ADP,
+  AVB_CONTROL_ACMP,
+  AVB_CONTROL_AECP,
+  AVB_CONTROL_MAAP,
+  AVB_CONTROL_MRP,
+  AVB_CONTROL_NUM_PROTOCOLS
+} avb_control_protocol_t;
+
+void avb_control_deadline_clear(avb_control_protocol_t protocol);
+
+/** The protocol has work to do on the next periodic call */
+void avb_control_deadline_now(avb_control_protocol_t protocol);
+
+/** The protocol needs a periodic call once the timer has timed out */
+void avb_control_deadline_timer(avb_control_protocol_t protocol, REFERENCE_PARAM(avb_timer, tmr));
+
+/** The earliest deadline reported, or now + max_sleep if that is sooner */
+unsigned avb_control_next_deadline(unsigned now, unsigned max_sleep);
+
+#endif
@@ -0,0 +1,423 @@
+// Copyright (c) 2017, XMOS Ltd, All rights reserved
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "mrp_pdu_replay.h"
+#include "avb_mrp.h"
+#include "avb_srp.h"
+#include "avb_mvrp.h"
+#include "avb_mrp_pdu.h"
+#include "avb_srp_pdu.h"
+#include "misc_timer.h"
+
+#define TICKS_PER_MS (XS1_TIMER_KHZ)
+#define POLL_TICKS (100000)
+
+#define TEST_VLAN 2
+
+/* Remote Talkers that local Listeners attach to */
+#define REMOTE_STREAM_HI 0x00229700
+#define REMOTE_STREAM_LO 0x00010000
+#define NUM_REMOTE_STREAMS 128
+
+/* Talkers declared by this endpoint */
+#define LOCAL_STREAM_HI 0x00229701
+#define LOCAL_STREAM_LO 0x00020000
+#define NUM_LOCAL_STREAMS 16
+
+extern unsigned int srp_domain_boundary_port[MRP_NUM_PORTS];
+
+static unsigned i_avb_mgr;
+
+static unsigned char pdu[MRP_REPLAY_MAX_PDU_SIZE];
+static int pdu_len;
+
+static unsigned char captured[MRP_REPLAY_MAX_PDU_SIZE];
+static int captured_len = 0;
+
+void mrp_pdu_replay_capture(char packet[], unsigned n, unsigned ifnum)
+{
+  mrp_ethernet_hdr *hdr = (mrp_ethernet_hdr *) packet;
+  int etype = (hdr->ethertype[0] << 8) + hdr->ethertype[1];
+
+  if (etype == AVB_SRP_ETHERTYPE && ifnum == 0) {
+    memcpy(captured, packet, n);
+    captured_len = n;
+  }
+}
+
+static void fail(const char *test, const char *reason, unsigned stream_lo)
+{
+  printf("%s: %s (stream %x)\n", test, reason, stream_lo);
+  exit(1);
+}
+
+/* Calls mrp_periodic() as the SRP task would for the given amount of time */
+static void run_periodic(int ms)
+{
+  unsigned t = get_local_time();
+  unsigned end = t + ms * TICKS_PER_MS;
+
+  do {
+    mrp_periodic(i_avb_mgr);
+    t += POLL_TICKS;
+    waitfor(t);
+  } while ((int)(end - t) > 0);
+  mrp_periodic(i_avb_mgr);
+}
+
+static void pdu_start(void)
+{
+  pdu[0] = 0; // ProtocolVersion
+  pdu_len = sizeof(mrp_header);
+}
+
+static void pdu_end(void)
+{
+  pdu[pdu_len++] = 0;
+  pdu[pdu_len++] = 0;
+}
+
+/* Appends a message holding one vector of num_values identical events */
+static void pdu_add_vector(int attribute_type, void *first_value, int first_value_length,
+                           int num_values, int three_packed_event, int four_packed_event, int leave_all)
+{
+  static const int three_packed_multiplier[3] = {36, 6, 1};
+  int threepacked_len = (num_values+2)/3;
+  int fourpacked_len = (attribute_type == AVB_SRP_ATTRIBUTE_TYPE_LISTENER) ? (num_values+3)/4 : 0;
+  int attr_list_length = sizeof(mrp_vector_header) + first_value_length +
+                         threepacked_len + fourpacked_len + sizeof(mrp_msg_footer);
+  mrp_msg_header *hdr = (mrp_msg_header *) &pdu[pdu_len];
+  mrp_vector_header *vector_hdr = (mrp_vector_header *) (hdr + 1);
+  unsigned char *events = (unsigned char *) (vector_hdr + 1) + first_value_length;
+
+  hdr->AttributeType = attribute_type;
+  hdr->AttributeLength = first_value_length;
+  hdr->AttributeListLength[0] = attr_list_length >> 8;
+  hdr->AttributeListLength[1] = attr_list_length & 0xff;
+  vector_hdr->LeaveAllEventNumberOfValuesHigh = (leave_all << 5) | ((num_values >> 8) & 0x1f);
+  vector_hdr->NumberOfValuesLow = num_values & 0xff;
+  memcpy(vector_hdr + 1, first_value, first_value_length);
+
+  memset(events, 0, threepacked_len + fourpacked_len + sizeof(mrp_msg_footer));
+  for (int i=0;i<num_values;i++) {
+    events[i/3] += three_packed_event * three_packed_multiplier[i%3];
+    if (fourpacked_len) {
+      events[threepacked_len + i/4] += four_packed_event << (2*(3-(i%4)));
+    }
+  }
+
+  pdu_len += sizeof(mrp_msg_header) + attr_list_length;
+}
+
+static void stream_id_bytes(unsigned char id[8], unsigned hi, unsigned lo)
+{
+  for (int i=0;i<4;i++) {
+    id[i] = hi >> (24-8*i);
+    id[4+i] = lo >> (24-8*i);
+  }
+}
+
+static void add_talker_vector(unsigned first_lo, int num_values, int event, int leave_all)
+{
+  srp_talker_first_value fv;
+  unsigned accumulated_latency = AVB_SRP_ACCUMULATED_LATENCY_DEFAULT;
+
+  stream_id_bytes(fv.StreamId, REMOTE_STREAM_HI, first_lo);
+  fv.DestMacAddr[0] = 0x91;
+  fv.DestMacAddr[1] = 0xe0;
+  fv.DestMacAddr[2] = 0xf0;
+  fv.DestMacAddr[3] = 0x00;
+  fv.DestMacAddr[4] = 0x00;
+  fv.DestMacAddr[5] = first_lo - REMOTE_STREAM_LO;
+  fv.VlanID[0] = 0;
+  fv.VlanID[1] = TEST_VLAN;
+  fv.TSpecMaxFrameSize[0] = 0;
+  fv.TSpecMaxFrameSize[1] = 224;
+  fv.TSpecMaxIntervalFrames[0] = 0;
+  fv.TSpecMaxIntervalFrames[1] = AVB_SRP_MAX_INTERVAL_FRAMES_DEFAULT;
+  fv.TSpec = (AVB_SRP_TSPEC_PRIORITY_DEFAULT << 5) | (AVB_SRP_TSPEC_RANK_DEFAULT << 4);
+  for (int i=0;i<4;i++) {
+    fv.AccumulatedLatency[i] = accumulated_latency >> (24-8*i);
+  }
+
+  pdu_add_vector(AVB_SRP_ATTRIBUTE_TYPE_TALKER_ADVERTISE, &fv, sizeof(fv), num_values, event, 0, leave_all);
+}
+
+static void replay_pdu(void)
+{
+  avb_mrp_process_packet(pdu, AVB_SRP_ETHERTYPE, pdu_len, 0);
+}
+
+static int talker_registrar_state(unsigned hi, unsigned lo)
+{
+  unsigned stream_id[2] = {hi, lo};
+  mrp_attribute_state *st = mrp_match_type_non_prop_attribute(MSRP_TALKER_ADVERTISE, stream_id, 0);
+
+  if (!st) {
+    st = mrp_match_type_non_prop_attribute(MSRP_TALKER_FAILED, stream_id, 0);
+  }
+  return st ? st->registrar_state : -1;
+}
+
+static void check_talkers(const char *test, int first, int num, int registrar_state)
+{
+  for (int i=first;i<first+num;i++) {
+    if (talker_registrar_state(REMOTE_STREAM_HI, REMOTE_STREAM_LO+i) != registrar_state) {
+      fail(test, "unexpected Talker registrar state", REMOTE_STREAM_LO+i);
+    }
+  }
+}
+
+/* Counts the vectors and values of an attribute type in the last transmitted
+ * MSRPDU whose first value belongs to the given 32 bit stream ID prefix
+ */
+static int count_vectors(int attribute_type, unsigned stream_hi, int *num_values)
+{
+  unsigned char *msg = captured + sizeof(mrp_ethernet_hdr) + sizeof(mrp_header);
+  unsigned char *end = captured + captured_len;
+  int num_vectors = 0;
+
+  *num_values = 0;
+  while (msg + 1 < end && (msg[0] != 0 || msg[1] != 0)) {
+    mrp_msg_header *hdr = (mrp_msg_header *) msg;
+    int attr_list_length = (hdr->AttributeListLength[0] << 8) + hdr->AttributeListLength[1];
+
+    if (hdr->AttributeType == attribute_type) {
+      unsigned char *vec = msg + sizeof(mrp_msg_header);
+      unsigned char *vec_end = vec + attr_list_length - sizeof(mrp_msg_footer);
+
+      while (vec < vec_end) {
+        int n = ((vec[0] & 0x1f) << 8) + vec[1];
+        unsigned char *fv = vec + sizeof(mrp_vector_header);
+        unsigned hi = (fv[0] << 24) + (fv[1] << 16) + (fv[2] << 8) + fv[3];
+
+        if (hi == stream_hi) {
+          num_vectors++;
+          *num_values += n;
+        }
+        vec += sizeof(mrp_vector_header) + hdr->AttributeLength + (n+2)/3 +
+               ((attribute_type == AVB_SRP_ATTRIBUTE_TYPE_LISTENER) ? (n+3)/4 : 0);
+      }
+    }
+    msg += sizeof(mrp_msg_header) + attr_list_length;
+  }
+  return num_vectors;
+}
+
+/* A Domain declaration for SR class A takes the port out of the boundary */
+static void test_domain(void)
+{
+  srp_domain_first_value fv;
+
+  fv.SRclassID = AVB_SRP_SRCLASS_DEFAULT;
+  fv.SRclassPriority = AVB_SRP_TSPEC_PRIORITY_DEFAULT;
+  fv.SRclassVID[0] = 0;
+  fv.SRclassVID[1] = TEST_VLAN;
+
+  pdu_start();
+  pdu_add_vector(AVB_SRP_ATTRIBUTE_TYPE_DOMAIN, &fv, sizeof(fv), 1, MRP_ATTRIBUTE_EVENT_JOININ, 0, 0);
+  pdu_end();
+  replay_pdu();
+  run_periodic(1);
+
+  if (srp_domain_boundary_port[0] & (1 << AVB_SR_CLASS_A)) {
+    fail("domain", "port still at SRP domain boundary", 0);
+  }
+  if (!(srp_domain_boundary_port[0] & (1 << AVB_SR_CLASS_B))) {
+    fail("domain", "port left Class B boundary without a Class B declaration", 0);
+  }
+  printf("PASS\n");
+}
+
+/* One vector of Talker Advertise values registers every stream it covers */
+static void test_talker_vector(void)
+{
+  for (int i=0;i<NUM_REMOTE_STREAMS;i++) {
+    unsigned stream_id[2] = {REMOTE_STREAM_HI, REMOTE_STREAM_LO+i};
+    avb_srp_join_listener_attrs(stream_id, TEST_VLAN);
+  }
+
+  check_talkers("talker_vector", 0, NUM_REMOTE_STREAMS, MRP_MT);
+
+  pdu_start();
+  add_talker_vector(REMOTE_STREAM_LO, NUM_REMOTE_STREAMS, MRP_ATTRIBUTE_EVENT_NEW, 0);
+  pdu_end();
+  replay_pdu();
+  run_periodic(1);
+
+  check_talkers("talker_vector", 0, NUM_REMOTE_STREAMS, MRP_IN);
+  printf("PASS\n");
+}
+
+/* The Listener declarations for consecutive streams go out as a single vector */
+static void test_listener_packing(void)
+{
+  int num_values;
+  int num_vectors;
+
+  run_periodic(MRP_JOINTIMER_PERIOD_CENTISECONDS * 10 + 50);
+
+  num_vectors = count_vectors(AVB_SRP_ATTRIBUTE_TYPE_LISTENER, REMOTE_STREAM_HI, &num_values);
+  if (num_vectors != 1 || num_values != NUM_REMOTE_STREAMS) {
+    printf("listener_packing: %d vectors, %d values\n", num_vectors, num_values);
+    exit(1);
+  }
+  printf("PASS\n");
+}
+
+/* A LeaveAll removes the registrations that are not redeclared before the
+ * leave timer expires
+ */
+static void test_leave_all(void)
+{
+  const int num_redeclared = NUM_REMOTE_STREAMS/2;
+
+  pdu_start();
+  add_talker_vector(REMOTE_STREAM_LO, 0, 0, 1);
+  pdu_end();
+  replay_pdu();
+
+  check_talkers("leave_all", 0, NUM_REMOTE_STREAMS, MRP_LV);
+
+  pdu_start();
+  add_talker_vector(REMOTE_STREAM_LO, num_redeclared, MRP_ATTRIBUTE_EVENT_JOININ, 0);
+  pdu_end();
+  replay_pdu();
+
+  run_periodic(MRP_LEAVETIMER_PERIOD_CENTISECONDS * 10 + 100);
+
+  check_talkers("leave_all", 0, num_redeclared, MRP_IN);
+  check_talkers("leave_all", num_redeclared, NUM_REMOTE_STREAMS - num_redeclared, MRP_MT);
+  printf("PASS\n");
+}
+
+/* Malformed vectors are rejected without registering anything */
+static void test_malformed(void)
+{
+  const int first = NUM_REMOTE_STREAMS/2;
+  const int num = NUM_REMOTE_STREAMS - first;
+  int full_len;
+
+  // Vector that claims more values than the PDU holds
+  pdu_start();
+  add_talker_vector(REMOTE_STREAM_LO+first, num, MRP_ATTRIBUTE_EVENT_JOININ, 0);
+  pdu_end();
+  full_len = pdu_len;
+  pdu_len = full_len - 8;
+  replay_pdu();
+
+  // AttributeLength that doesn't match the attribute type
+  pdu_len = full_len;
+  pdu[sizeof(mrp_header) + 1] -= 1;
+  replay_pdu();
+  pdu[sizeof(mrp_header) + 1] += 1;
+
+  // NumberOfValues that overruns the AttributeListLength
+  pdu[sizeof(mrp_header) + sizeof(mrp_msg_header) + 1] += 3;
+  replay_pdu();
+  pdu[sizeof(mrp_header) + sizeof(mrp_msg_header) + 1] -= 3;
+
+  // ThreePackedEvents from the unused range
+  pdu[sizeof(mrp_header) + sizeof(mrp_msg_header) + sizeof(mrp_vector_header) + sizeof(srp_talker_first_value)] = 0xff;
+  replay_pdu();
+
+  run_periodic(1);
+
+  check_talkers("malformed", 0, first, MRP_IN);
+  check_talkers("malformed", first, num, MRP_MT);
+  printf("PASS\n");
+}
+
+/* Locally declared Talkers for consecutive streams go out as a single vector */
+static void test_talker_packing(void)
+{
+  int num_values;
+  int num_vectors;
+
+  for (int i=0;i<NUM_LOCAL_STREAMS;i++) {
+    avb_srp_info_t reservation;
+
+    memset(&reservation, 0, sizeof(reservation));
+    reservation.stream_id[0] = LOCAL_STREAM_HI;
+    reservation.stream_id[1] = LOCAL_STREAM_LO+i;
+    reservation.dest_mac_addr[0] = 0x91;
+    reservation.dest_mac_addr[1] = 0xe0;
+    reservation.dest_mac_addr[2] = 0xf0;
+    reservation.dest_mac_addr[3] = 0x00;
+    reservation.dest_mac_addr[4] = 0x01;
+    reservation.dest_mac_addr[5] = i;
+    reservation.vlan_id = TEST_VLAN;
+    reservation.tspec_max_frame_size = 224;
+    reservation.tspec_max_interval = AVB_SRP_MAX_INTERVAL_FRAMES_DEFAULT;
+    reservation.tspec = (AVB_SRP_TSPEC_PRIORITY_DEFAULT << 5) | (AVB_SRP_TSPEC_RANK_DEFAULT << 4);
+    reservation.accumulated_latency = AVB_SRP_ACCUMULATED_LATENCY_DEFAULT;
+    avb_srp_create_and_join_talker_advertise_attrs(&reservation);
+  }
+
+  run_periodic(MRP_JOINTIMER_PERIOD_CENTISECONDS * 10 + 50);
+
+  num_vectors = count_vectors(AVB_SRP_ATTRIBUTE_TYPE_TALKER_ADVERTISE, LOCAL_STREAM_HI, &num_values);
+  if (num_vectors != 1 || num_values != NUM_LOCAL_STREAMS) {
+    printf("talker_packing: %d vectors, %d values\n", num_vectors, num_values);
+    exit(1);
+  }
+  printf("PASS\n");
+}
+
+#ifdef MRP_BENCHMARK
+/* Reports the time taken to process a redeclaration of the first n remote
+ * Talkers for growing n, and the cost of an idle periodic tick
+ */
+static void benchmark(void)
+{
+  static const int num_values[] = {1, 16, 64, NUM_REMOTE_STREAMS};
+  const int num_ticks = 100;
+  unsigned t0, t1;
+
+  for (int i=0;i<sizeof(num_values)/sizeof(num_values[0]);i++) {
+    pdu_start();
+    add_talker_vector(REMOTE_STREAM_LO, num_values[i], MRP_ATTRIBUTE_EVENT_JOININ, 0);
+    pdu_end();
+    t0 = get_local_time();
+    replay_pdu();
+    t1 = get_local_time();
+    printf("MRP_BENCHMARK: %d values, %d bytes, %u ticks\n", num_values[i], pdu_len, t1 - t0);
+  }
+
+  t0 = get_local_time();
+  for (int i=0;i<num_ticks;i++) {
+    mrp_periodic(i_avb_mgr);
+  }
+  t1 = get_local_time();
+  printf("MRP_BENCHMARK: %d attributes, %u ticks per periodic call\n", MRP_MAX_ATTRS, (t1 - t0) / num_ticks);
+}
+#endif
+
+void mrp_pdu_replay_tests(CLIENT_INTERFACE(ethernet_tx_if, i_eth),
+                          CLIENT_INTERFACE(avb_interface, i_avb))
+{
+  char mac_addr[6] = {0x00, 0x22, 0x97, 0x00, 0x00, 0x01};
+
+  i_avb_mgr = i_avb;
+
+  srp_store_ethernet_interface(i_eth);
+  mrp_store_ethernet_interface(i_eth);
+  mrp_init(mac_addr);
+  srp_domain_init();
+  avb_mvrp_init();
+  srp_domain_join();
+
+  test_domain();
+  test_talker_vector();
+  test_listener_packing();
+  test_leave_all();
+  test_malformed();
+  test_talker_packing();
+
+#ifdef MRP_BENCHMARK
+  benchmark();
+#endif
+
+  exit(0);
+}
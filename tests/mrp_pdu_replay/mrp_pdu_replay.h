@@ -0,0 +1,21 @@
+// Copyright (c) 2017, XMOS Ltd, All rights reserved
+#ifndef __mrp_pdu_replay_h__
+#define __mrp_pdu_replay_h__
+
+#include <xccompat.h>
+#include "ethernet.h"
+#include "avb.h"
+
+#define MRP_REPLAY_MAX_PDU_SIZE (1518)
+
+/** Records a PDU transmitted by the MRP code so that the tests can check how
+ *  the declarations were packed.
+ */
+void mrp_pdu_replay_capture(char packet[], unsigned n, unsigned ifnum);
+
+/** Replays the MSRPDUs and checks the resulting declarations. Exits when done.
+ */
+void mrp_pdu_replay_tests(CLIENT_INTERFACE(ethernet_tx_if, i_eth),
+                          CLIENT_INTERFACE(avb_interface, i_avb));
+
+#endif
@@ -0,0 +1,15 @@
+#!/usr/bin/env python
+import xmostest
+
+def runtest():
+    testlevel = 'smoke'
+    resources = xmostest.request_resource('xsim')
+
+    binary = 'mrp_pdu_replay/bin/mrp_pdu_replay.xe'.format()
+    tester = xmostest.ComparisonTester(open('mrp_pdu_replay.expect'),
+                                       'lib_tsn',
+                                       'lib_tsn_tests',
+                                       'mrp_pdu_replay',
+                                       {})
+    tester.set_min_testlevel(testlevel)
+    xmostest.run_on_simulator(resources['xsim'], binary, simargs=[], tester=tester)